@@ -0,0 +1,101 @@
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "file_system.h"
+#include "buffer_pool.h"
+
+namespace CrashSender {
+
+BufferPool& BufferPool::GetInstance() noexcept {
+    static BufferPool instance;
+    return instance;
+}
+
+BufferPool::~BufferPool() {
+    for (const Buffer& buffer : idle_) {
+        Unmap(buffer.data, buffer.size);
+    }
+}
+
+size_t BufferPool::RoundUp(size_t size) noexcept {
+    constexpr size_t alignment = FileSystem::kUnbufferedAlignment;
+    return std::max<size_t>((size + alignment - 1) / alignment, 1) * alignment;
+}
+
+char* BufferPool::Acquire(size_t size) noexcept {
+    size = RoundUp(size);
+    {
+        std::lock_guard lock(mutex_);
+        const auto it = std::find_if(idle_.begin(), idle_.end(), [size](const Buffer& buffer) { return buffer.size == size; });
+        if (it != idle_.end()) {
+            char* data = it->data;
+            idle_bytes_ -= it->size;
+            idle_.erase(it);
+            return data;
+        }
+    }
+    return Map(size);
+}
+
+void BufferPool::Release(char* buffer, size_t size) noexcept {
+    if (!buffer) {
+        return;
+    }
+
+    size = RoundUp(size);
+    try {
+        std::lock_guard lock(mutex_);
+        if (idle_bytes_ + size <= kMaxIdleBytes) {
+            idle_.push_back({ buffer, size });
+            idle_bytes_ += size;
+            return;
+        }
+    }
+    catch (...) {
+        // Falls through to unmapping
+    }
+    Unmap(buffer, size);
+}
+
+#ifdef _WIN32
+
+char* BufferPool::Map(size_t size) noexcept {
+    void* memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!memory) {
+        return nullptr;
+    }
+    // Pinning is best effort, the working set quota may be too small
+    VirtualLock(memory, size);
+    return static_cast<char*>(memory);
+}
+
+void BufferPool::Unmap(char* buffer, size_t size) noexcept {
+    VirtualUnlock(buffer, size);
+    VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+#else
+
+char* BufferPool::Map(size_t size) noexcept {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    // Pinning is best effort, RLIMIT_MEMLOCK may be too small
+    mlock(memory, size);
+    return static_cast<char*>(memory);
+}
+
+void BufferPool::Unmap(char* buffer, size_t size) noexcept {
+    munlock(buffer, size);
+    munmap(buffer, size);
+}
+
+#endif
+
+} // namespace CrashSender
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace CrashSender {
+
+/**
+ * @brief Process-wide pool of page-aligned, pinned I/O buffers
+ *
+ * Buffers start on a page boundary and their sizes are rounded up to
+ * FileSystem::kUnbufferedAlignment, so they qualify for Unbuffered reads.
+ * Released buffers stay mapped and pinned up to kMaxIdleBytes, parallel part
+ * uploads and consecutive requests reuse them instead of mapping and locking
+ * fresh memory for every read-ahead pipeline.
+ */
+class BufferPool {
+public:
+    static constexpr size_t kMaxIdleBytes = 16 * 1024 * 1024; ///< Released buffers beyond this are unmapped
+
+    static BufferPool& GetInstance() noexcept;
+
+    // Non-copyable, non-movable
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    BufferPool(BufferPool&&) = delete;
+    BufferPool& operator=(BufferPool&&) = delete;
+
+    /**
+     * @brief Buffer of at least `size` bytes, see RoundUp()
+     * @return nullptr if the memory could not be mapped
+     */
+    [[nodiscard]]
+    char* Acquire(size_t size) noexcept;
+
+    /**
+     * @brief Hand a buffer back to the pool
+     * @param size Size passed to Acquire()
+     */
+    void Release(char* buffer, size_t size) noexcept;
+
+    /**
+     * @brief Size a request for `size` bytes actually gets
+     */
+    [[nodiscard]]
+    static size_t RoundUp(size_t size) noexcept;
+
+private:
+    BufferPool() noexcept = default;
+    ~BufferPool();
+
+    struct Buffer {
+        char* data = nullptr;
+        size_t size = 0;
+    };
+
+    static char* Map(size_t size) noexcept;
+    static void Unmap(char* buffer, size_t size) noexcept;
+
+    std::mutex mutex_;
+    std::vector<Buffer> idle_;
+    size_t idle_bytes_ = 0;
+};
+
+} // namespace CrashSender
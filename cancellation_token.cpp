@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "cancellation_token.h"
+
+namespace CrashSender {
+
+void CancellationToken::SetTimeout(std::chrono::milliseconds timeout) noexcept {
+    const auto deadline = Clock::now() + timeout;
+    deadline_ = deadline.time_since_epoch().count();
+}
+
+void CancellationToken::Cancel() noexcept {
+    cancelled_ = true;
+}
+
+bool CancellationToken::IsCancelled() const noexcept {
+    return cancelled_ || Clock::now().time_since_epoch().count() >= deadline_;
+}
+
+std::chrono::milliseconds CancellationToken::Remaining() const noexcept {
+    if (cancelled_) {
+        return std::chrono::milliseconds::zero();
+    }
+
+    const Clock::time_point deadline{ Clock::duration{ deadline_.load() } };
+    if (deadline == Clock::time_point::max()) {
+        return std::chrono::milliseconds::max();
+    }
+
+    const auto now = Clock::now();
+    if (now >= deadline) {
+        return std::chrono::milliseconds::zero();
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+}
+
+std::chrono::milliseconds CancellationToken::Clamp(std::chrono::milliseconds timeout) const noexcept {
+    return std::min(timeout, Remaining());
+}
+
+} // namespace CrashSender
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace CrashSender {
+
+/**
+ * @brief Cooperative cancellation shared by all blocking loops of a report
+ *
+ * The token fires either when Cancel() is called (e.g. from a console control
+ * handler) or once the overall deadline has passed.
+ */
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CancellationToken() noexcept = default;
+
+    // Non-copyable, non-movable
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+    CancellationToken(CancellationToken&&) = delete;
+    CancellationToken& operator=(CancellationToken&&) = delete;
+
+    /**
+     * @brief Set the overall deadline relative to now
+     * @param timeout Time left until the token fires
+     */
+    void SetTimeout(std::chrono::milliseconds timeout) noexcept;
+
+    void Cancel() noexcept;
+
+    [[nodiscard]]
+    bool IsCancelled() const noexcept;
+
+    /**
+     * @brief Time left until the deadline, zero once the token fired
+     */
+    [[nodiscard]]
+    std::chrono::milliseconds Remaining() const noexcept;
+
+    /**
+     * @brief Clamp a phase timeout to the time left until the deadline
+     */
+    [[nodiscard]]
+    std::chrono::milliseconds Clamp(std::chrono::milliseconds timeout) const noexcept;
+
+private:
+    std::atomic<bool> cancelled_{ false };
+    std::atomic<Clock::rep> deadline_{ Clock::time_point::max().time_since_epoch().count() };
+};
+
+} // namespace CrashSender
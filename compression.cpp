@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "logger.h"
+#include "compression.h"
+
+namespace CrashSender {
+
+namespace {
+
+    /**
+     * @brief Bytes per second as "12.3 MB/s"
+     */
+    std::string FormatRate(double bytes_per_second) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f MB/s", bytes_per_second / (1024.0 * 1024.0));
+        return text;
+    }
+
+} // anonymous namespace
+
+std::string CompressionSetting::Name() const {
+    if (codec == Codec::Identity) {
+        return "identity";
+    }
+    return "deflate-" + std::to_string(level);
+}
+
+std::string_view CompressionSetting::EncodingHeader() const noexcept {
+    return codec == Codec::Deflate ? "Content-Encoding: deflate\r\n" : "";
+}
+
+bool Compressor::IsAvailable() noexcept {
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Compressor::Compress(const CompressionSetting& setting, const char* data, size_t size, std::vector<char>& output,
+                          std::string& error_message) noexcept {
+    try {
+        if (setting.codec == CompressionSetting::Codec::Identity) {
+            output.assign(data, data + size);
+            return true;
+        }
+
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+        // zlib counts in uLong, which is 32 bits on Windows
+        if (size > UINT32_MAX / 2) {
+            error_message = "Block too large to compress";
+            return false;
+        }
+
+        uLongf compressed_size = compressBound(static_cast<uLong>(size));
+        output.resize(compressed_size);
+        const int result = compress2(reinterpret_cast<Bytef*>(output.data()), &compressed_size,
+                                     reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size), setting.level);
+        if (result != Z_OK) {
+            error_message = "Compression failed with zlib error " + std::to_string(result);
+            output.clear();
+            return false;
+        }
+        output.resize(compressed_size);
+        return true;
+#else
+        error_message = "Compression is not available in this build";
+        return false;
+#endif
+    }
+    catch (const std::exception& e) {
+        error_message = "Failed to compress block: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while compressing block";
+        return false;
+    }
+}
+
+CompressionPlanner::CompressionPlanner() {
+    estimates_.push_back(Estimate{ CompressionSetting{}, 0.0, 1.0 });
+    if (Compressor::IsAvailable()) {
+        for (const int level : { 1, 6, 9 }) {
+            estimates_.push_back(Estimate{ CompressionSetting{ CompressionSetting::Codec::Deflate, level }, 0.0, 1.0 });
+        }
+    }
+}
+
+void CompressionPlanner::Sample(const char* data, size_t size) noexcept {
+    size = std::min(size, kSampleSize);
+    if (size == 0) {
+        return;
+    }
+
+    std::vector<char> output;
+    for (auto& estimate : estimates_) {
+        if (estimate.setting.codec == CompressionSetting::Codec::Identity) {
+            continue;
+        }
+
+        // Nothing else touches the estimates before the upload threads start
+        std::string error_message;
+        const auto started = std::chrono::steady_clock::now();
+        if (!Compressor::Compress(estimate.setting, data, size, output, error_message)) {
+            Logger::LogError(error_message);
+            continue;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        estimate.bytes_per_second = static_cast<double>(size) / std::max(seconds, 1e-6);
+        estimate.ratio = static_cast<double>(output.size()) / static_cast<double>(size);
+    }
+}
+
+void CompressionPlanner::RecordCompression(const CompressionSetting& setting, uint64_t raw_bytes, uint64_t compressed_bytes,
+                                           double seconds) noexcept {
+    if (raw_bytes == 0 || setting.codec == CompressionSetting::Codec::Identity) {
+        return;
+    }
+
+    std::lock_guard lock(mutex_);
+    for (auto& estimate : estimates_) {
+        if (estimate.setting == setting) {
+            const double bytes_per_second = static_cast<double>(raw_bytes) / std::max(seconds, 1e-6);
+            const double ratio = static_cast<double>(compressed_bytes) / static_cast<double>(raw_bytes);
+            estimate.bytes_per_second = estimate.bytes_per_second > 0.0
+                ? estimate.bytes_per_second + kSmoothing * (bytes_per_second - estimate.bytes_per_second)
+                : bytes_per_second;
+            estimate.ratio += kSmoothing * (ratio - estimate.ratio);
+        }
+    }
+}
+
+void CompressionPlanner::RecordSend(uint64_t bytes, double seconds) noexcept {
+    if (bytes == 0) {
+        return;
+    }
+
+    std::lock_guard lock(mutex_);
+    const double bytes_per_second = static_cast<double>(bytes) / std::max(seconds, 1e-6);
+    uplink_ = uplink_ > 0.0 ? uplink_ + kSmoothing * (bytes_per_second - uplink_) : bytes_per_second;
+}
+
+CompressionSetting CompressionPlanner::Choose(uint64_t remaining_bytes) noexcept {
+    std::lock_guard lock(mutex_);
+
+    // Every upload thread compresses and then sends its part, so the cheapest setting per byte wins
+    const Estimate* best = &estimates_.front();
+    for (const auto& estimate : estimates_) {
+        if (SecondsPerByte(estimate) < SecondsPerByte(*best)) {
+            best = &estimate;
+        }
+    }
+
+    if (!chosen_ || best->setting != current_) {
+        try {
+            char estimate_text[32];
+            std::snprintf(estimate_text, sizeof(estimate_text), "%.1f s", SecondsPerByte(*best) * static_cast<double>(remaining_bytes));
+            Logger::LogInfo("Compressing parts with " + best->setting.Name() +
+                            (chosen_ ? " instead of " + current_.Name() : std::string()) +
+                            ", estimated " + estimate_text + " per connection for the remaining " +
+                            std::to_string(remaining_bytes / 1024) + " KB (uplink " +
+                            (uplink_ > 0.0 ? FormatRate(uplink_) : "not measured yet") + ")");
+        }
+        catch (...) {
+            // Logging is best effort
+        }
+        current_ = best->setting;
+        chosen_ = true;
+    }
+    return current_;
+}
+
+std::string CompressionPlanner::Describe() const {
+    std::lock_guard lock(mutex_);
+
+    std::string description;
+    for (const auto& estimate : estimates_) {
+        if (estimate.setting.codec == CompressionSetting::Codec::Identity) {
+            continue;
+        }
+        char ratio[16];
+        std::snprintf(ratio, sizeof(ratio), "%.2f", estimate.ratio);
+        description += estimate.setting.Name() + " " + FormatRate(estimate.bytes_per_second) + " ratio " + ratio + ", ";
+    }
+    return description + "uplink " + (uplink_ > 0.0 ? FormatRate(uplink_) : "not measured yet");
+}
+
+double CompressionPlanner::SecondsPerByte(const Estimate& estimate) const noexcept {
+    if (estimate.setting.codec == CompressionSetting::Codec::Identity) {
+        return 1.0 / (uplink_ > 0.0 ? uplink_ : kAssumedUplink);
+    }
+    if (estimate.bytes_per_second <= 0.0) {
+        // Never measured, e.g. the sample failed
+        return std::numeric_limits<double>::max();
+    }
+    return 1.0 / estimate.bytes_per_second + estimate.ratio / (uplink_ > 0.0 ? uplink_ : kAssumedUplink);
+}
+
+} // namespace CrashSender
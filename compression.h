@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CrashSender {
+
+/**
+ * @brief Codec and level a part is compressed with
+ */
+struct CompressionSetting {
+    enum class Codec : int {
+        Identity = 0, ///< Sent as is
+        Deflate = 1   ///< zlib stream, HTTP "Content-Encoding: deflate"
+    };
+
+    Codec codec{Codec::Identity};
+    int level{0};
+
+    bool operator==(const CompressionSetting&) const = default;
+
+    /**
+     * @brief Short name for logs, e.g. "deflate-6"
+     */
+    [[nodiscard]]
+    std::string Name() const;
+
+    /**
+     * @brief Content-Encoding header line of a part, empty for identity
+     */
+    [[nodiscard]]
+    std::string_view EncodingHeader() const noexcept;
+};
+
+/**
+ * @brief One-shot compression of a block held in memory
+ */
+struct Compressor {
+    /**
+     * @brief Whether the build has a codec besides identity (zlib was found)
+     */
+    [[nodiscard]]
+    static bool IsAvailable() noexcept;
+
+    /**
+     * @brief Compress a block
+     * @param output Replaced by the compressed bytes
+     * @param error_message Placeholder for error if it will occurs
+     */
+    [[nodiscard]]
+    static bool Compress(const CompressionSetting& setting, const char* data, size_t size, std::vector<char>& output,
+                         std::string& error_message) noexcept;
+};
+
+/**
+ * @brief Picks the setting with the shortest estimated time to deliver the rest of an upload
+ *
+ * Every candidate is first measured on a sample block of the dump. A part
+ * costs size / compression speed + size * ratio / uplink throughput, the
+ * uplink being measured on the parts sent so far. Speed and ratio of the
+ * setting in use and the uplink are updated after every part, so the choice
+ * follows the dump content and the network. Safe to share between upload
+ * threads.
+ */
+class CompressionPlanner {
+public:
+    static constexpr size_t kSampleSize = 1024 * 1024;       ///< Bytes of the dump every candidate is measured on
+    static constexpr double kAssumedUplink = 1.25e6;         ///< Bytes per second (10 Mbit/s) until a part was sent
+
+    CompressionPlanner();
+
+    // Non-copyable, non-movable
+    CompressionPlanner(const CompressionPlanner&) = delete;
+    CompressionPlanner& operator=(const CompressionPlanner&) = delete;
+    CompressionPlanner(CompressionPlanner&&) = delete;
+    CompressionPlanner& operator=(CompressionPlanner&&) = delete;
+
+    /**
+     * @brief Measure every candidate on the first block of the dump
+     * @param size Anything above kSampleSize is ignored
+     */
+    void Sample(const char* data, size_t size) noexcept;
+
+    /**
+     * @brief Feed the outcome of compressing a part
+     */
+    void RecordCompression(const CompressionSetting& setting, uint64_t raw_bytes, uint64_t compressed_bytes,
+                           double seconds) noexcept;
+
+    /**
+     * @brief Feed the time a part request took
+     * @param bytes Body bytes on the wire
+     */
+    void RecordSend(uint64_t bytes, double seconds) noexcept;
+
+    /**
+     * @brief Setting for the next part, a change is logged with the estimates behind it
+     * @param remaining_bytes Uncompressed bytes not yet sent, used for the logged estimate
+     */
+    [[nodiscard]]
+    CompressionSetting Choose(uint64_t remaining_bytes) noexcept;
+
+    /**
+     * @brief Speed and ratio of every candidate and the uplink, for logs
+     */
+    [[nodiscard]]
+    std::string Describe() const;
+
+private:
+    static constexpr double kSmoothing = 0.3; ///< Weight of a new measurement
+
+    struct Estimate {
+        CompressionSetting setting{};
+        double bytes_per_second = 0.0; ///< Compression speed, 0 for identity which costs nothing
+        double ratio = 1.0;            ///< Compressed size / raw size
+    };
+
+    [[nodiscard]]
+    double SecondsPerByte(const Estimate& estimate) const noexcept;
+
+    mutable std::mutex mutex_;
+    std::vector<Estimate> estimates_;
+    double uplink_ = 0.0; ///< Bytes per second of one connection, 0 until measured
+    CompressionSetting current_{};
+    bool chosen_ = false;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,71 @@
+#include "connection_pool.h"
+
+namespace CrashSender {
+
+ConnectionLease::~ConnectionLease() {
+    if (pool_ && connection_) {
+        pool_->Release(endpoint_, std::move(connection_));
+    }
+}
+
+ConnectionLease ConnectionPool::Acquire(const Endpoint& endpoint, const TransportTimeouts& timeouts, std::string& error_message) noexcept {
+    try {
+        const std::wstring key = endpoint.ToString();
+        HttpTransport* transport = nullptr;
+        {
+            std::lock_guard lock(mutex_);
+
+            auto it = idle_.find(key);
+            if (it != idle_.end()) {
+                auto& connections = it->second;
+                const auto now = std::chrono::steady_clock::now();
+                while (!connections.empty()) {
+                    IdleConnection idle = std::move(connections.back());
+                    connections.pop_back();
+                    if (now - idle.since < kIdleTimeout) {
+                        return ConnectionLease(this, endpoint, std::move(idle.connection));
+                    }
+                }
+            }
+
+            if (!transport_) {
+                transport_ = HttpTransport::Create(error_message);
+                if (!transport_) {
+                    return ConnectionLease{};
+                }
+            }
+            transport = transport_.get();
+        }
+
+        // Connecting takes a round trip, other threads may use the pool meanwhile
+        auto connection = transport->Connect(endpoint, timeouts, error_message);
+        if (!connection) {
+            return ConnectionLease{};
+        }
+        return ConnectionLease(this, endpoint, std::move(connection));
+    }
+    catch (...) {
+        error_message = "Unknown exception while acquiring connection";
+        return ConnectionLease{};
+    }
+}
+
+void ConnectionPool::Release(const Endpoint& endpoint, std::unique_ptr<HttpConnection> connection) noexcept {
+    try {
+        std::lock_guard lock(mutex_);
+        auto& connections = idle_[endpoint.ToString()];
+        if (connections.size() < kMaxIdlePerEndpoint) {
+            connections.push_back(IdleConnection{ std::move(connection), std::chrono::steady_clock::now() });
+        }
+    }
+    catch (...) {
+        // The connection is closed instead of kept
+    }
+}
+
+void ConnectionPool::Clear() noexcept {
+    std::lock_guard lock(mutex_);
+    idle_.clear();
+}
+
+} // namespace CrashSender
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "transport.h"
+
+namespace CrashSender {
+
+class ConnectionPool;
+
+/**
+ * @brief Connection borrowed from a pool, handed back when the lease ends
+ */
+class ConnectionLease {
+public:
+    ConnectionLease() noexcept = default;
+    ConnectionLease(ConnectionPool* pool, const Endpoint& endpoint, std::unique_ptr<HttpConnection> connection) noexcept
+        : pool_(pool), endpoint_(endpoint), connection_(std::move(connection)) {}
+    ~ConnectionLease();
+
+    // Non-copyable, movable
+    ConnectionLease(const ConnectionLease&) = delete;
+    ConnectionLease& operator=(const ConnectionLease&) = delete;
+    ConnectionLease(ConnectionLease&&) noexcept = default;
+    ConnectionLease& operator=(ConnectionLease&&) noexcept = default;
+
+    [[nodiscard]]
+    explicit operator bool() const noexcept {
+        return connection_ != nullptr;
+    }
+
+    HttpConnection& operator*() const noexcept {
+        return *connection_;
+    }
+
+    HttpConnection* operator->() const noexcept {
+        return connection_.get();
+    }
+
+private:
+    ConnectionPool* pool_ = nullptr;
+    Endpoint endpoint_{};
+    std::unique_ptr<HttpConnection> connection_;
+};
+
+/**
+ * @brief Keeps idle keep-alive connections per endpoint for the next request, thread-safe
+ */
+class ConnectionPool {
+public:
+    static constexpr size_t kMaxIdlePerEndpoint = 8;
+    static constexpr std::chrono::seconds kIdleTimeout{ 30 }; ///< Servers commonly drop idle connections after a minute
+
+    ConnectionPool() noexcept = default;
+
+    // Non-copyable, non-movable
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+    ConnectionPool(ConnectionPool&&) = delete;
+    ConnectionPool& operator=(ConnectionPool&&) = delete;
+
+    /**
+     * @brief Reuse an idle connection to the endpoint or open a new one
+     * @return Lease, empty on failure
+     */
+    [[nodiscard]]
+    ConnectionLease Acquire(const Endpoint& endpoint, const TransportTimeouts& timeouts, std::string& error_message) noexcept;
+
+    /**
+     * @brief Return a connection for reuse
+     */
+    void Release(const Endpoint& endpoint, std::unique_ptr<HttpConnection> connection) noexcept;
+
+    /**
+     * @brief Close every idle connection
+     */
+    void Clear() noexcept;
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<HttpConnection> connection;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    std::mutex mutex_;
+    std::unique_ptr<HttpTransport> transport_;
+    std::map<std::wstring, std::vector<IdleConnection>> idle_;
+};
+
+} // namespace CrashSender
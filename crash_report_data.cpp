@@ -4,16 +4,41 @@ namespace CrashSender {
 
 void CrashReportData::Clear() noexcept {
     url.clear();
+    urls.clear();
     version.clear(); 
     error.clear();
     dump_path.clear();
     temp_path.clear();
     full_url.clear();
     server_path.clear();
+    game_log_path.clear();
+    network_log_path.clear();
+    endpoints.clear();
+    signature.clear();
+    archive_path.clear();
+    parallel_uploads = 1;
+    part_size = 64ull << 20;
+    rate_limit = 0;
+    adaptive_rate = false;
+    background_mode = false;
+    zero_copy = true;
+    unbuffered_threshold = 64ull << 20;
+    compress = false;
+    use_daemon = true;
+    profile_startup = false;
+    daemon_mode = false;
+    daemon_concurrency = 2;
+    max_uploads = 2;
+    collapse_window_ms = 300'000;
+    timeout_ms = 600'000;
+    connect_timeout_ms = 15'000;
+    send_timeout_ms = 60'000;
+    receive_timeout_ms = 60'000;
 }
 
 bool CrashReportData::IsValid() const noexcept {
-    return !url.empty() &&  !version.empty() && !dump_path.empty() && !temp_path.empty();
+    return !url.empty() &&  !version.empty() &&
+           (!archive_path.empty() || (!dump_path.empty() && !temp_path.empty()));
 }
 
 } // namespace CrashSender
@@ -1,22 +1,54 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "endpoint.h"
 
 namespace CrashSender {
 
 /**
  * @brief Data structure containing crash report information
+ *
+ * Text that only goes to the server and the logs is held as UTF-8, converted
+ * once when the report is parsed. Paths stay wide, that is what the Windows
+ * file APIs take.
  */
 struct CrashReportData {
     std::wstring url{};              ///< Server URL
-    std::wstring version{};          ///< Application version
-    std::wstring error{};            ///< Error description  
+    std::vector<std::wstring> urls{}; ///< All server URLs, the first one is preferred
+    std::string version{};           ///< Application version, UTF-8
+    std::string error{};             ///< Error description, UTF-8
     std::wstring dump_path{};        ///< Path to dump file
     std::wstring temp_path{};        ///< Temporary file path
     std::wstring full_url{};         ///< Complete URL with path
     std::wstring server_path{};      ///< Server path component
     std::wstring game_log_path{};    ///< Game log path
     std::wstring network_log_path{}; ///< Network log path
+    std::vector<Endpoint> endpoints{}; ///< Parsed server endpoints
+    std::string signature{};         ///< Signature shared by reports of the same crash, sent when set
+    std::wstring archive_path{};     ///< Packed report (see report_archive.h), its files replace the dump and log paths
+
+    size_t parallel_uploads{1};      ///< Concurrent part uploads, 1 sends a single request
+    uint64_t part_size{64ull << 20}; ///< Maximum size of one uploaded part in bytes
+    uint64_t rate_limit{0};          ///< Upload cap in bytes per second, 0 is unlimited
+    bool adaptive_rate{false};       ///< Back off the upload rate when latency rises
+    bool background_mode{false};     ///< Run at background CPU and I/O priority
+    bool zero_copy{true};            ///< Send files straight from the page cache where the transport allows it
+    uint64_t unbuffered_threshold{64ull << 20}; ///< Files of this size and larger are read around the system cache, 0 reads all through it
+    bool compress{false};            ///< Compress parts with the codec and level that deliver fastest, implies a parted upload
+    bool use_daemon{true};           ///< Hand the report to a running sender daemon if there is one
+    bool profile_startup{false};     ///< Print the startup profile (see startup_profile.h) once the report is sent
+    bool daemon_mode{false};         ///< Run as the resident sender daemon
+    size_t daemon_concurrency{2};    ///< Reports the daemon uploads at the same time
+    size_t max_uploads{2};           ///< Uploads running at once across all sender processes, 0 is unlimited
+    uint32_t collapse_window_ms{300'000}; ///< Identical reports within this window are only counted, 0 uploads all
+
+    uint32_t timeout_ms{600'000};        ///< Overall deadline of the report
+    uint32_t connect_timeout_ms{15'000}; ///< Timeout of connection setup
+    uint32_t send_timeout_ms{60'000};    ///< Timeout of a single send
+    uint32_t receive_timeout_ms{60'000}; ///< Timeout of a single receive
 
     /**
      * @brief Clear all data fields
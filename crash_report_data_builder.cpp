@@ -1,11 +1,11 @@
+#include <algorithm>
 #include <fstream>
 #include <string_view>
 #include <vector>
 
-#include <windows.h>
-
 #include "logger.h"
 #include "utils.h"
+#include "file_system.h"
 #include "crash_report_data_builder.h"
 
 namespace CrashSender {
@@ -13,23 +13,57 @@ namespace CrashSender {
 std::optional<CrashReportData> CrashReportDataBuilder::ParseCommandLine(int argc, wchar_t* argv[], 
                                                         std::string& error_message) noexcept {
     try {
+        CrashReportData data;
+        std::wstring value;
+
+        // A daemon takes reports over IPC, only the transport options apply
+        if (ParseParameter(argc, argv, L"-daemon", value)) {
+            data.daemon_mode = true;
+            if (ParseParameter(argc, argv, L"-concurrency=", value)) {
+                const unsigned long concurrency = std::stoul(value);
+                if (concurrency == 0) {
+                    error_message = "Invalid -concurrency parameter";
+                    return std::nullopt;
+                }
+                data.daemon_concurrency = concurrency;
+            }
+            if (!ParseOptions(argc, argv, data, error_message)) {
+                return std::nullopt;
+            }
+            return data;
+        }
+
         if (argc < 5) {
             error_message = "Insufficient command line arguments (minimum 4 required)";
             return std::nullopt;
         }
 
-        CrashReportData data;
-
         // Parse required parameters
-        if (!ParseParameter(argc, argv, L"-url=", data.url) || data.url.empty()) {
+        // Several -url= parameters or a comma separated list give failover endpoints
+        std::vector<std::wstring> url_lists;
+        ParseParameters(argc, argv, L"-url=", url_lists);
+        for (const auto& list : url_lists) {
+            size_t start = 0;
+            while (start <= list.size()) {
+                const auto comma_pos = std::min(list.find(L',', start), list.size());
+                if (comma_pos > start) {
+                    data.urls.push_back(list.substr(start, comma_pos - start));
+                }
+                start = comma_pos + 1;
+            }
+        }
+
+        if (data.urls.empty()) {
             error_message = "Missing or empty -url parameter";
             return std::nullopt;
         }
+        data.url = data.urls.front();
 
-        if (!ParseParameter(argc, argv, L"-version=", data.version) || data.version.empty()) {
+        if (!ParseParameter(argc, argv, L"-version=", value) || value.empty()) {
             error_message = "Missing or empty -version parameter";
             return std::nullopt;
         }
+        data.version = TextUtils::WideToUtf8(value);
 
         if (!ParseParameter(argc, argv, L"-error=", data.temp_path) || data.temp_path.empty()) {
             error_message = "Missing or empty -error parameter";
@@ -41,6 +75,12 @@ std::optional<CrashReportData> CrashReportDataBuilder::ParseCommandLine(int argc
             return std::nullopt;
         }
 
+        if (!ParseOptions(argc, argv, data, error_message)) {
+            return std::nullopt;
+        }
+        data.use_daemon = !ParseParameter(argc, argv, L"-standalone", value);
+        data.profile_startup = ParseParameter(argc, argv, L"-profile-startup", value);
+
         if (!data.IsValid()) {
             error_message = "Parsed data is invalid";
             return std::nullopt;
@@ -58,6 +98,58 @@ std::optional<CrashReportData> CrashReportDataBuilder::ParseCommandLine(int argc
     }
 }
 
+bool CrashReportDataBuilder::ParseOptions(int argc, wchar_t* const argv[], CrashReportData& data,
+                                          std::string& error_message) {
+    std::wstring value;
+    if (ParseParameter(argc, argv, L"-parallel=", value)) {
+        const unsigned long parallel = std::stoul(value);
+        if (parallel == 0) {
+            error_message = "Invalid -parallel parameter";
+            return false;
+        }
+        data.parallel_uploads = parallel;
+    }
+
+    if (ParseParameter(argc, argv, L"-partsize=", value)) {
+        const unsigned long long part_size_mb = std::stoull(value);
+        if (part_size_mb == 0) {
+            error_message = "Invalid -partsize parameter";
+            return false;
+        }
+        data.part_size = part_size_mb << 20;
+    }
+
+    if (ParseParameter(argc, argv, L"-directio=", value)) {
+        data.unbuffered_threshold = std::stoull(value) << 20;
+    }
+
+    if (ParseParameter(argc, argv, L"-maxuploads=", value)) {
+        data.max_uploads = std::stoul(value);
+    }
+
+    if (ParseParameter(argc, argv, L"-ratelimit=", value)) {
+        data.rate_limit = std::stoull(value) << 10;
+    }
+
+    const auto parse_seconds = [&](std::wstring_view parameter, uint32_t& output_ms) {
+        if (ParseParameter(argc, argv, parameter, value)) {
+            output_ms = static_cast<uint32_t>(std::min<unsigned long>(std::stoul(value), UINT32_MAX / 1000) * 1000);
+        }
+    };
+
+    parse_seconds(L"-timeout=", data.timeout_ms);
+    parse_seconds(L"-connecttimeout=", data.connect_timeout_ms);
+    parse_seconds(L"-sendtimeout=", data.send_timeout_ms);
+    parse_seconds(L"-receivetimeout=", data.receive_timeout_ms);
+    parse_seconds(L"-collapse=", data.collapse_window_ms);
+
+    data.adaptive_rate = ParseParameter(argc, argv, L"-adaptive", value);
+    data.background_mode = ParseParameter(argc, argv, L"-background", value);
+    data.zero_copy = !ParseParameter(argc, argv, L"-buffered", value);
+    data.compress = ParseParameter(argc, argv, L"-compress", value);
+    return true;
+}
+
 bool CrashReportDataBuilder::ParseParameter(int argc, wchar_t* const argv[], 
                                       std::wstring_view parameter, 
                                       std::wstring& output) noexcept {
@@ -80,24 +172,45 @@ bool CrashReportDataBuilder::ParseParameter(int argc, wchar_t* const argv[],
     }
 }
 
-void CrashReportDataBuilder::ProcessServerUrl(CrashReportData& data) noexcept {
+bool CrashReportDataBuilder::ParseParameters(int argc, wchar_t* const argv[],
+                                       std::wstring_view parameter,
+                                       std::vector<std::wstring>& outputs) noexcept {
     try {
-        constexpr std::wstring_view http_prefix = L"http://";
+        for (int i = 0; i < argc; ++i) {
+            if (!argv[i]) {
+                continue;
+            }
 
-        size_t start_pos = 0;
+            const std::wstring_view arg(argv[i]);
+            if (arg.starts_with(parameter)) {
+                outputs.emplace_back(arg.substr(parameter.length()));
+            }
+        }
+        return !outputs.empty();
+    }
+    catch (...) {
+        return false;
+    }
+}
 
-        if (const auto http_pos = data.url.find(http_prefix); http_pos != std::wstring::npos) {
-            start_pos = http_pos + http_prefix.length();
+void CrashReportDataBuilder::ProcessServerUrl(CrashReportData& data) noexcept {
+    try {
+        if (data.urls.empty() && !data.url.empty()) {
+            data.urls.push_back(data.url);
         }
 
-        const std::wstring url_part = data.url.substr(start_pos);
-        if (const auto slash_pos = url_part.find(L'/'); slash_pos != std::wstring::npos) {
-            data.full_url = url_part.substr(0, slash_pos);
-            data.server_path = url_part.substr(slash_pos);
+        data.endpoints.clear();
+        for (const auto& url : data.urls) {
+            if (auto endpoint = Endpoint::Parse(url)) {
+                data.endpoints.push_back(std::move(*endpoint));
+            } else {
+                Logger::LogError(L"Ignoring malformed server URL: " + url);
+            }
         }
-        else {
-            data.full_url = url_part;
-            data.server_path = L"/";
+
+        if (!data.endpoints.empty()) {
+            data.full_url = data.endpoints.front().host;
+            data.server_path = data.endpoints.front().path;
         }
     }
     catch (...) {
@@ -112,13 +225,11 @@ void CrashReportDataBuilder::ProcessLogFiles(CrashReportData& data) noexcept {
         constexpr std::wstring_view game_log_path = L"L2.log";
         constexpr std::wstring_view network_log_path = L"Network.log";
 
-        DWORD attributes = GetFileAttributesW(game_log_path.data());
-        if (attributes != INVALID_FILE_ATTRIBUTES) {
+        if (FileSystem::Exists(game_log_path)) {
             data.game_log_path = game_log_path;
         }
 
-        attributes = GetFileAttributesW(network_log_path.data());
-        if (attributes != INVALID_FILE_ATTRIBUTES) {
+        if (FileSystem::Exists(network_log_path)) {
             data.network_log_path = network_log_path;
         }
     }
@@ -129,56 +240,52 @@ void CrashReportDataBuilder::ProcessLogFiles(CrashReportData& data) noexcept {
 
 bool CrashReportDataBuilder::ProcessErrorContent(CrashReportData& data) noexcept {
     try {
-        // Check if file exists using Windows API
-        const DWORD attributes = GetFileAttributesW(data.temp_path.c_str());
-        if (attributes == INVALID_FILE_ATTRIBUTES) {
+        // Packed reports carry the error text itself
+        if (!data.archive_path.empty()) {
+            return true;
+        }
+
+        if (!FileSystem::Exists(data.temp_path)) {
             Logger::LogError("Error file does not exist: " + TextUtils::WideToUtf8(data.temp_path));
             return false;
         }
 
         // Read file content
         std::vector<char> buffer;
-        const HANDLE file_handle = CreateFileW(data.temp_path.c_str(), GENERIC_READ, 
-                                             FILE_SHARE_READ, nullptr, OPEN_EXISTING, 
-                                             FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (file_handle == INVALID_HANDLE_VALUE) {
+        FileHandle file;
+        if (FileSystem::OpenRead(data.temp_path, FileSystem::Access::Normal, file) != FileSystem::OpenResult::Ok) {
             Logger::LogError("Failed to open error file: " + TextUtils::WideToUtf8(data.temp_path));
-            data.error = L"Failed to read error content";
+            data.error = "Failed to read error content";
             return true;
         }
 
-        FileGuard guard{ file_handle };
-
-        LARGE_INTEGER file_size;
-        if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart > SIZE_MAX) {
+        const int64_t file_size = FileSystem::Size(file);
+        if (file_size < 0 || static_cast<uint64_t>(file_size) > SIZE_MAX) {
             Logger::LogError("Failed to get error file size");
-            data.error = L"Failed to read error content";
+            data.error = "Failed to read error content";
             return true;
         }
 
-        buffer.resize(static_cast<size_t>(file_size.QuadPart));
-        DWORD bytes_read = 0;
-        if (!ReadFile(file_handle, buffer.data(), static_cast<DWORD>(buffer.size()), &bytes_read, nullptr) ||
-            bytes_read != buffer.size()) {
+        buffer.resize(static_cast<size_t>(file_size));
+        if (FileSystem::ReadAt(file, 0, buffer.data(), buffer.size()) != file_size) {
             Logger::LogError("Failed to read error file content");
-            data.error = L"Failed to read error content";
+            data.error = "Failed to read error content";
             return true;
         }
 
         if (buffer.size() % 2 != 0) {
             Logger::LogError("Error file has invalid size for wide characters");
-            data.error = L"Invalid error file format";
+            data.error = "Invalid error file format";
             return true;
         }
 
-        // Convert buffer to wide string (assuming UTF-16)
-        const size_t char_count = buffer.size() / 2;
-        data.error = std::wstring(reinterpret_cast<const wchar_t*>(buffer.data()), char_count);
+        // The game writes the error as UTF-16, it is kept as UTF-8
+        data.error = TextUtils::Utf16LeToUtf8(std::string_view(buffer.data(), buffer.size()));
         
         return true;
     }
     catch (...) {
-        data.error = L"Exception occurred while processing error content";
+        data.error = "Exception occurred while processing error content";
         return true; // Non-critical failure
     }
 }
@@ -2,6 +2,7 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "crash_report_data.h"
 
@@ -26,7 +27,13 @@ public:
     static void ProcessLogFiles(CrashReportData& data) noexcept;
     static bool ProcessErrorContent(CrashReportData& data) noexcept;
 private:
+    /**
+     * @brief Parse the transport options shared by reports and the daemon, throws on malformed numbers
+     */
+    static bool ParseOptions(int argc, wchar_t* const argv[], CrashReportData& data, std::string& error_message);
+
     static bool ParseParameter(int argc, wchar_t* const argv[], std::wstring_view parameter, std::wstring& output) noexcept;
+    static bool ParseParameters(int argc, wchar_t* const argv[], std::wstring_view parameter, std::vector<std::wstring>& outputs) noexcept;
 };
 
 } // namespace CrashSender
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "crash_report_data.h"
+#include "crash_report_data_builder.h"
+#include "http_client.h"
+#include "crash_sender.h"
+
+namespace CrashSender {
+
+namespace {
+
+    /**
+     * @brief Translate a spec into the report data the HTTP client works on
+     */
+    bool BuildReportData(const ReportSpec& spec, CrashReportData& data, std::string& error_message) {
+        if (spec.urls.empty() || spec.urls.front().empty()) {
+            error_message = "No server URL given";
+            return false;
+        }
+        if (spec.version.empty()) {
+            error_message = "No application version given";
+            return false;
+        }
+
+        data.urls = spec.urls;
+        data.url = spec.urls.front();
+        data.version = TextUtils::WideToUtf8(spec.version);
+        data.error = TextUtils::WideToUtf8(spec.error);
+        data.game_log_path = spec.game_log_path;
+        data.network_log_path = spec.network_log_path;
+        data.signature = TextUtils::WideToUtf8(spec.signature);
+        data.archive_path = spec.archive_path;
+
+        // A handle is reopened by path, the caller keeps ownership of it
+        if (spec.dump_handle) {
+            if (!FileSystem::PathFromHandle(*spec.dump_handle, data.dump_path)) {
+                error_message = "Failed to resolve dump file handle";
+                return false;
+            }
+        } else {
+            data.dump_path = spec.dump_path;
+        }
+
+        if (data.dump_path.empty() && data.archive_path.empty()) {
+            error_message = "No dump file given";
+            return false;
+        }
+
+        data.parallel_uploads = std::max<size_t>(spec.parallel_uploads, 1);
+        data.part_size = spec.part_size;
+        data.rate_limit = spec.rate_limit;
+        data.adaptive_rate = spec.adaptive_rate;
+        data.zero_copy = spec.zero_copy;
+        data.unbuffered_threshold = spec.unbuffered_threshold;
+        data.compress = spec.compress;
+        data.timeout_ms = spec.timeout_ms;
+        data.connect_timeout_ms = spec.connect_timeout_ms;
+        data.send_timeout_ms = spec.send_timeout_ms;
+        data.receive_timeout_ms = spec.receive_timeout_ms;
+        return true;
+    }
+
+    /**
+     * @brief Split a comma separated list, empty items are dropped
+     */
+    std::vector<std::wstring> SplitList(const wchar_t* list) {
+        std::vector<std::wstring> items;
+        if (!list) {
+            return items;
+        }
+
+        const std::wstring_view view(list);
+        size_t start = 0;
+        while (start <= view.size()) {
+            const size_t end = std::min(view.find(L',', start), view.size());
+            if (end > start) {
+                items.emplace_back(view.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return items;
+    }
+
+} // anonymous namespace
+
+bool SubmitCrashReport(const ReportSpec& spec, std::string& error_message) noexcept {
+    CancellationToken token;
+    token.SetTimeout(std::chrono::milliseconds(spec.timeout_ms));
+    bool retryable = true;
+    return SubmitCrashReport(spec, token, retryable, error_message);
+}
+
+bool SubmitCrashReport(const ReportSpec& spec, const CancellationToken& token, bool& retryable,
+                       std::string& error_message) noexcept {
+    retryable = true;
+    try {
+        CrashReportData data;
+        if (!BuildReportData(spec, data, error_message)) {
+            retryable = false;
+            return false;
+        }
+        return SubmitCrashReport(data, token, retryable, error_message);
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while submitting crash report: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while submitting crash report";
+        return false;
+    }
+}
+
+bool SubmitCrashReport(const CrashReportData& report, const CancellationToken& token, bool& retryable,
+                       std::string& error_message) noexcept {
+    retryable = true;
+    try {
+        CrashReportData data = report;
+        CrashReportDataBuilder::ProcessServerUrl(data);
+        if (data.endpoints.empty()) {
+            error_message = "No valid server endpoint";
+            retryable = false;
+            return false;
+        }
+
+        Logger::LogInfo(L"Sending crash report to " + data.url);
+        return HttpClient::SendCrashReport(data, token, retryable, error_message);
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while submitting crash report: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while submitting crash report";
+        return false;
+    }
+}
+
+} // namespace CrashSender
+
+extern "C" int L2CrashSender_SubmitReport(const L2CrashSenderReport* report, char* error_buffer, size_t error_buffer_size) {
+    using namespace CrashSender;
+
+    std::string error_message;
+    bool sent = false;
+    try {
+        if (!report) {
+            error_message = "No report given";
+        } else {
+            const auto text = [](const wchar_t* value) { return value ? std::wstring(value) : std::wstring{}; };
+
+            ReportSpec spec;
+            spec.urls = SplitList(report->urls);
+            spec.version = text(report->version);
+            spec.error = text(report->error);
+            spec.dump_path = text(report->dump_path);
+            spec.game_log_path = text(report->game_log_path);
+            spec.network_log_path = text(report->network_log_path);
+            if (report->timeout_ms != 0) {
+                spec.timeout_ms = report->timeout_ms;
+            }
+            sent = SubmitCrashReport(spec, error_message);
+        }
+    }
+    catch (...) {
+        error_message = "Unknown exception while submitting crash report";
+    }
+
+    if (!sent && error_buffer && error_buffer_size > 0) {
+        const size_t length = std::min(error_message.size(), error_buffer_size - 1);
+        std::memcpy(error_buffer, error_message.data(), length);
+        error_buffer[length] = '\0';
+    }
+    return sent ? 0 : 1;
+}
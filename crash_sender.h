@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "file_system.h"
+
+namespace CrashSender {
+
+class CancellationToken;
+struct CrashReportData;
+
+/**
+ * @brief Everything needed to submit a crash report from inside another process
+ */
+struct ReportSpec {
+    std::vector<std::wstring> urls{};    ///< Server URLs, the first one is preferred
+    std::wstring version{};              ///< Application version
+    std::wstring error{};                ///< Error description, sent as is
+    std::wstring dump_path{};            ///< Path to dump file, ignored when dump_handle is set
+    std::optional<NativeFileHandle> dump_handle{}; ///< Open dump file, stays owned by the caller
+    std::wstring game_log_path{};        ///< Game log, empty to skip
+    std::wstring network_log_path{};     ///< Network log, empty to skip
+    std::wstring signature{};            ///< Signature of identical reports, empty to skip
+    std::wstring archive_path{};         ///< Packed report archive, sent instead of the dump and log paths
+
+    size_t parallel_uploads{1};      ///< Concurrent part uploads, 1 sends a single request
+    uint64_t part_size{64ull << 20}; ///< Maximum size of one uploaded part in bytes
+    uint64_t rate_limit{0};          ///< Upload cap in bytes per second, 0 is unlimited
+    bool adaptive_rate{false};       ///< Back off the upload rate when latency rises
+    bool zero_copy{true};            ///< Send files straight from the page cache where the transport allows it
+    uint64_t unbuffered_threshold{64ull << 20}; ///< Files of this size and larger are read around the system cache, 0 reads all through it
+    bool compress{false};            ///< Compress parts with the codec and level that deliver fastest, implies a parted upload
+
+    uint32_t timeout_ms{600'000};        ///< Overall deadline of the report
+    uint32_t connect_timeout_ms{15'000}; ///< Timeout of connection setup
+    uint32_t send_timeout_ms{60'000};    ///< Timeout of a single send
+    uint32_t receive_timeout_ms{60'000}; ///< Timeout of a single receive
+};
+
+/**
+ * @brief Upload a crash report in the calling process
+ * @param spec Report to send, no file is modified or deleted
+ * @param error_message Placeholder for error if it will occurs
+ * @return true if a server accepted the report
+ */
+[[nodiscard]]
+bool SubmitCrashReport(const ReportSpec& spec, std::string& error_message) noexcept;
+
+/**
+ * @brief Upload a crash report under a caller-owned deadline and cancellation
+ * @param spec Report to send, timeout_ms is ignored in favour of the token
+ * @param token Cancellation and overall deadline
+ * @param retryable Set to false if sending the report again cannot succeed, see HttpClient::SendCrashReport
+ * @param error_message Placeholder for error if it will occurs
+ * @return true if a server accepted the report
+ */
+[[nodiscard]]
+bool SubmitCrashReport(const ReportSpec& spec, const CancellationToken& token, bool& retryable,
+                       std::string& error_message) noexcept;
+
+/**
+ * @brief Upload a report already held as UTF-8 report data, no text is converted again
+ * @param report Report to send, its endpoints are parsed from the URLs
+ * @param token Cancellation and overall deadline
+ * @param retryable Set to false if sending the report again cannot succeed, see HttpClient::SendCrashReport
+ * @param error_message Placeholder for error if it will occurs
+ * @return true if a server accepted the report
+ */
+[[nodiscard]]
+bool SubmitCrashReport(const CrashReportData& report, const CancellationToken& token, bool& retryable,
+                       std::string& error_message) noexcept;
+
+} // namespace CrashSender
+
+extern "C" {
+#endif
+
+/**
+ * @brief C view of a report, strings are NUL-terminated and may be null when optional
+ */
+typedef struct L2CrashSenderReport {
+    const wchar_t* urls;             /* Comma separated server URLs */
+    const wchar_t* version;          /* Application version */
+    const wchar_t* error;            /* Error description */
+    const wchar_t* dump_path;        /* Path to dump file */
+    const wchar_t* game_log_path;    /* Optional game log */
+    const wchar_t* network_log_path; /* Optional network log */
+    uint32_t timeout_ms;             /* Overall deadline, 0 keeps the default */
+} L2CrashSenderReport;
+
+/**
+ * @brief C entry point of SubmitCrashReport
+ * @param report Report to send
+ * @param error_buffer Receives a NUL-terminated UTF-8 error message on failure, may be null
+ * @param error_buffer_size Size of error_buffer in bytes
+ * @return 0 if the report was accepted, 1 otherwise
+ */
+int L2CrashSender_SubmitReport(const L2CrashSenderReport* report, char* error_buffer, size_t error_buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
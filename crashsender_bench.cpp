@@ -0,0 +1,1159 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "utils.h"
+#include "logger.h"
+#include "crc32c.h"
+#include "cancellation_token.h"
+#include "crash_report_data.h"
+#include "crash_report_data_builder.h"
+#include "file_system.h"
+#include "http_client.h"
+#include "multipart_body.h"
+#include "multipart_parser.h"
+#include "read_ahead_pipeline.h"
+#include "report_archive.h"
+#include "startup_profile.h"
+#include "upload_coordinator.h"
+
+/**
+ * Benchmark suite of the sender hot paths.
+ *
+ * Every measurement is printed as one JSON object per line:
+ *   {"case":"body_stream","input_bytes":16777216,"iterations":12,"seconds":0.51,
+ *    "bytes_per_second":...,"allocations_per_iteration":...,"allocated_bytes_per_iteration":...,
+ *    "peak_rss_kb":...,"ok":true}
+ *
+ * The startup case spawns the sender itself and prints percentiles of the
+ * time from process creation to the first request byte at the server instead:
+ *   {"case":"startup","input_bytes":65536,"runs":50,"p50_us":...,"p99_us":...,"max_us":...,
+ *    "stages_p50_us":{"entry":...,"arguments":...,...},"ok":true}
+ *
+ * The cache_residency case uploads while another thread reads a "game" file
+ * and adds the read rate of that file and how much of both files is left in
+ * the system cache (-1 where the system cannot tell):
+ *   {"case":"cache_residency","mode":"unbuffered","input_bytes":268435456,"iterations":3,"seconds":0.62,
+ *    "bytes_per_second":...,"game_bytes_per_second":...,"dump_resident_percent":...,
+ *    "game_resident_percent":...,"ok":true}
+ *
+ * Usage: crashsender_bench [--sizes=1M,16M,256M] [--dir=.] [--min-time=0.5] [--max-buffer=1G]
+ *                          [--cases=body_build,body_stream,...] [--keep]
+ *                          [--sender=path/to/L2CrashSender] [--runs=50]
+ */
+
+namespace {
+
+    std::atomic<uint64_t> allocation_count{ 0 };
+    std::atomic<uint64_t> allocated_bytes{ 0 };
+
+    /// Keeps the compiler from dropping reads whose result is unused
+    volatile uint64_t checksum_sink = 0;
+
+} // anonymous namespace
+
+// Every allocation of the process goes through here, the library included
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// GCC inlines these into delete expressions and then flags the free() of a pointer from operator new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr uint64_t KB = 1024;
+    constexpr uint64_t MB = 1024 * KB;
+    constexpr uint64_t GB = 1024 * MB;
+
+    struct BenchOptions {
+        std::vector<uint64_t> sizes{ 1 * MB, 16 * MB, 256 * MB };
+        std::wstring directory{ L"." };
+        double min_seconds = 0.5;
+        uint64_t max_buffer = 1 * GB;   ///< Larger inputs are not read into memory
+        std::vector<std::string> cases{};
+        bool keep_files = false;
+        std::string sender{};          ///< Sender executable of the startup case, next to the benchmark by default
+        size_t runs = 50;              ///< Sender processes the startup case spawns
+    };
+
+    bool ParseSize(std::string_view text, uint64_t& size) {
+        if (text.empty()) {
+            return false;
+        }
+        uint64_t unit = 1;
+        switch (text.back()) {
+        case 'K': case 'k': unit = KB; break;
+        case 'M': case 'm': unit = MB; break;
+        case 'G': case 'g': unit = GB; break;
+        default: break;
+        }
+        if (unit != 1) {
+            text.remove_suffix(1);
+        }
+        try {
+            size = std::stoull(std::string(text)) * unit;
+            return size > 0;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> SplitList(std::string_view list) {
+        std::vector<std::string> items;
+        size_t start = 0;
+        while (start <= list.size()) {
+            const size_t end = std::min(list.find(',', start), list.size());
+            if (end > start) {
+                items.emplace_back(list.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return items;
+    }
+
+    bool ParseOptions(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            const auto value = [&](std::string_view name) { return arg.substr(name.size()); };
+
+            if (arg.starts_with("--sizes=")) {
+                options.sizes.clear();
+                for (const auto& item : SplitList(value("--sizes="))) {
+                    uint64_t size = 0;
+                    if (!ParseSize(item, size)) {
+                        std::fprintf(stderr, "Invalid size: %s\n", item.c_str());
+                        return false;
+                    }
+                    options.sizes.push_back(size);
+                }
+            } else if (arg.starts_with("--dir=")) {
+                options.directory = TextUtils::Utf8ToWide(value("--dir="));
+            } else if (arg.starts_with("--min-time=")) {
+                options.min_seconds = std::atof(std::string(value("--min-time=")).c_str());
+            } else if (arg.starts_with("--max-buffer=")) {
+                if (!ParseSize(value("--max-buffer="), options.max_buffer)) {
+                    std::fprintf(stderr, "Invalid buffer size\n");
+                    return false;
+                }
+            } else if (arg.starts_with("--cases=")) {
+                options.cases = SplitList(value("--cases="));
+            } else if (arg == "--keep") {
+                options.keep_files = true;
+            } else if (arg.starts_with("--sender=")) {
+                options.sender = value("--sender=");
+            } else if (arg.starts_with("--runs=")) {
+                options.runs = std::strtoull(std::string(value("--runs=")).c_str(), nullptr, 10);
+                if (options.runs == 0) {
+                    std::fprintf(stderr, "Invalid run count\n");
+                    return false;
+                }
+            } else {
+                std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief High water mark of the resident set, reset per case where the system allows it
+     */
+    uint64_t PeakRssKb() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.PeakWorkingSetSize / KB;
+        }
+        return 0;
+#else
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.starts_with("VmHWM:")) {
+                return std::strtoull(line.c_str() + 6, nullptr, 10);
+            }
+        }
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+    }
+
+    void ResetPeakRss() {
+#ifdef __linux__
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+#endif
+    }
+
+    /**
+     * @brief Run a case repeatedly for the minimum time and print the result
+     * @param bytes_per_iteration Bytes one iteration processes, the throughput base
+     * @param iteration Runs one iteration, false marks the case as failed
+     */
+    void Measure(const BenchOptions& options, std::string_view name, uint64_t input_bytes,
+                 uint64_t bytes_per_iteration, const std::function<bool()>& iteration) {
+        ResetPeakRss();
+        const uint64_t allocations_before = allocation_count.load();
+        const uint64_t allocated_before = allocated_bytes.load();
+
+        uint64_t iterations = 0;
+        bool ok = true;
+        const auto started = std::chrono::steady_clock::now();
+        double seconds = 0;
+        do {
+            ok = iteration();
+            ++iterations;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        } while (ok && seconds < options.min_seconds);
+
+        const double allocations = static_cast<double>(allocation_count.load() - allocations_before) / iterations;
+        const double allocated = static_cast<double>(allocated_bytes.load() - allocated_before) / iterations;
+        const double throughput = seconds > 0 ? bytes_per_iteration * static_cast<double>(iterations) / seconds : 0;
+
+        std::printf("{\"case\":\"%.*s\",\"input_bytes\":%llu,\"iterations\":%llu,\"seconds\":%.6f,"
+                    "\"bytes_per_second\":%.0f,\"allocations_per_iteration\":%.1f,"
+                    "\"allocated_bytes_per_iteration\":%.0f,\"peak_rss_kb\":%llu,\"ok\":%s}\n",
+                    static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(input_bytes),
+                    static_cast<unsigned long long>(iterations), seconds, throughput, allocations, allocated,
+                    static_cast<unsigned long long>(PeakRssKb()), ok ? "true" : "false");
+        std::fflush(stdout);
+    }
+
+    /**
+     * @brief Write a dump of pseudo-random bytes, an existing file of the right size is reused
+     */
+    bool CreateSyntheticDump(const std::wstring& path, uint64_t size) {
+        FileHandle existing;
+        if (FileSystem::OpenRead(path, FileSystem::Access::Normal, existing) == FileSystem::OpenResult::Ok &&
+            FileSystem::Size(existing) == static_cast<int64_t>(size)) {
+            return true;
+        }
+        existing.Close();
+
+        FileHandle file;
+        if (!FileSystem::CreateWrite(path, file)) {
+            return false;
+        }
+
+        // Incompressible like a real minidump with its memory sections
+        std::vector<uint64_t> chunk(4 * MB / sizeof(uint64_t));
+        uint64_t state = 0x9E3779B97F4A7C15ull ^ size;
+        for (uint64_t written = 0; written < size;) {
+            for (auto& word : chunk) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                word = state;
+            }
+            const size_t bytes = static_cast<size_t>(std::min<uint64_t>(size - written, chunk.size() * sizeof(uint64_t)));
+            if (!FileSystem::Write(file, reinterpret_cast<const char*>(chunk.data()), bytes)) {
+                return false;
+            }
+            written += bytes;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Write an error description file the way the game does, UTF-16LE of ASCII text
+     */
+    bool WriteErrorFile(const std::wstring& path, std::string_view text) {
+        FileHandle file;
+        if (!FileSystem::CreateWrite(path, file)) {
+            return false;
+        }
+
+        std::string utf16;
+        for (const char c : text) {
+            utf16 += c;
+            utf16 += '\0';
+        }
+        return FileSystem::Write(file, utf16.data(), utf16.size());
+    }
+
+    /**
+     * @brief Run a program to completion with stderr redirected to a file
+     * @param spawned Set right before the process is created
+     */
+    bool RunProcess(const std::string& program, const std::vector<std::string>& arguments, const std::wstring& stderr_path,
+                    std::chrono::steady_clock::time_point& spawned, int& exit_code) {
+#ifdef _WIN32
+        std::wstring command_line = L"\"" + TextUtils::Utf8ToWide(program) + L"\"";
+        for (const auto& argument : arguments) {
+            command_line += L" \"" + TextUtils::Utf8ToWide(argument) + L"\"";
+        }
+
+        SECURITY_ATTRIBUTES inherit{ sizeof(inherit), nullptr, TRUE };
+        const HANDLE error_output = CreateFileW(stderr_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inherit,
+                                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (error_output == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        STARTUPINFOW startup{};
+        startup.cb = sizeof(startup);
+        startup.dwFlags = STARTF_USESTDHANDLES;
+        startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        startup.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        startup.hStdError = error_output;
+
+        PROCESS_INFORMATION process{};
+        spawned = std::chrono::steady_clock::now();
+        const BOOL created = CreateProcessW(nullptr, command_line.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr,
+                                            &startup, &process);
+        CloseHandle(error_output);
+        if (!created) {
+            return false;
+        }
+
+        WaitForSingleObject(process.hProcess, INFINITE);
+        DWORD code = 1;
+        GetExitCodeProcess(process.hProcess, &code);
+        CloseHandle(process.hThread);
+        CloseHandle(process.hProcess);
+        exit_code = static_cast<int>(code);
+        return true;
+#else
+        std::vector<std::string> storage{ program };
+        storage.insert(storage.end(), arguments.begin(), arguments.end());
+        std::vector<char*> argv;
+        for (auto& argument : storage) {
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        const std::string error_output = TextUtils::WideToUtf8(stderr_path);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, error_output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        pid_t pid = 0;
+        spawned = std::chrono::steady_clock::now();
+        const int spawn_error = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (spawn_error != 0) {
+            return false;
+        }
+
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        return true;
+#endif
+    }
+
+    /**
+     * @brief Value at a fraction of the sorted samples, 0.5 is the median
+     */
+    double Percentile(std::vector<double> samples, double fraction) {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        const auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+        return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+#ifdef _WIN32
+    using SocketType = SOCKET;
+    const SocketType kNoSocket = INVALID_SOCKET;
+    void CloseSocket(SocketType socket_handle) { closesocket(socket_handle); }
+#else
+    using SocketType = int;
+    const SocketType kNoSocket = -1;
+    void CloseSocket(SocketType socket_handle) { close(socket_handle); }
+#endif
+
+    /**
+     * @brief Minimal keep-alive HTTP server on 127.0.0.1 that drains request bodies and answers 200
+     */
+    class LoopbackSink {
+    public:
+        ~LoopbackSink() {
+            Stop();
+        }
+
+        bool Start() {
+#ifdef _WIN32
+            WSADATA wsa_data;
+            if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+                return false;
+            }
+#endif
+            listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (listener_ == kNoSocket) {
+                return false;
+            }
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(listener_, 16) != 0 ||
+                getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+                return false;
+            }
+            port_ = ntohs(address.sin_port);
+
+            acceptor_ = std::thread([this]() { AcceptLoop(); });
+            return true;
+        }
+
+        void Stop() {
+            if (!acceptor_.joinable()) {
+                return;
+            }
+
+            // Wake the blocking accept with a connection of our own
+            stopping_ = true;
+            SocketType wake = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port_);
+            (void)connect(wake, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            acceptor_.join();
+            CloseSocket(wake);
+            CloseSocket(listener_);
+
+            for (auto& connection : connections_) {
+                connection.join();
+            }
+            connections_.clear();
+#ifdef _WIN32
+            WSACleanup();
+#endif
+        }
+
+        [[nodiscard]]
+        uint16_t port() const noexcept { return port_; }
+
+        /**
+         * @brief Forget the first byte seen so far, the next connection sets it again
+         */
+        void ResetFirstByte() noexcept { first_byte_ = 0; }
+
+        /**
+         * @brief When the first request byte since ResetFirstByte() was received
+         * @return false if nothing arrived yet
+         */
+        bool FirstByte(std::chrono::steady_clock::time_point& received) const noexcept {
+            const int64_t nanoseconds = first_byte_.load();
+            received = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nanoseconds));
+            return nanoseconds != 0;
+        }
+
+    private:
+        void AcceptLoop() {
+            for (;;) {
+                const SocketType client = accept(listener_, nullptr, nullptr);
+                if (stopping_ || client == kNoSocket) {
+                    if (client != kNoSocket) {
+                        CloseSocket(client);
+                    }
+                    return;
+                }
+                connections_.emplace_back([this, client]() { Serve(client, first_byte_); });
+            }
+        }
+
+        static void Serve(SocketType client, std::atomic<int64_t>& first_byte) {
+            std::vector<char> buffer(1 * MB);
+            std::string head;
+            bool first_receive = true;
+            for (;;) {
+                // Headers
+                size_t header_end = std::string::npos;
+                while ((header_end = head.find("\r\n\r\n")) == std::string::npos) {
+                    const int received = recv(client, buffer.data(), static_cast<int>(buffer.size()), 0);
+                    if (received <= 0) {
+                        CloseSocket(client);
+                        return;
+                    }
+                    if (first_receive) {
+                        int64_t unset = 0;
+                        first_byte.compare_exchange_strong(unset, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count());
+                        first_receive = false;
+                    }
+                    head.append(buffer.data(), static_cast<size_t>(received));
+                }
+
+                uint64_t content_length = 0;
+                const size_t field = head.find("Content-Length: ");
+                if (field != std::string::npos && field < header_end) {
+                    content_length = std::strtoull(head.c_str() + field + 16, nullptr, 10);
+                }
+
+                // Body, whatever arrived with the headers counts first
+                const uint64_t buffered = head.size() - header_end - 4;
+                uint64_t remaining = content_length - std::min(content_length, buffered);
+                head.erase(0, header_end + 4 + static_cast<size_t>(std::min(content_length, buffered)));
+                while (remaining > 0) {
+                    const int received = recv(client, buffer.data(),
+                                              static_cast<int>(std::min<uint64_t>(remaining, buffer.size())), 0);
+                    if (received <= 0) {
+                        CloseSocket(client);
+                        return;
+                    }
+                    remaining -= static_cast<uint64_t>(received);
+                }
+
+                constexpr std::string_view response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+                if (send(client, response.data(), static_cast<int>(response.size()), 0) <= 0) {
+                    CloseSocket(client);
+                    return;
+                }
+            }
+        }
+
+        SocketType listener_ = kNoSocket;
+        uint16_t port_ = 0;
+        std::atomic<bool> stopping_{ false };
+        std::atomic<int64_t> first_byte_{ 0 }; ///< Steady clock nanoseconds, 0 until a request arrives
+        std::thread acceptor_;
+        std::vector<std::thread> connections_;
+    };
+
+    /**
+     * @brief Report data of a synthetic dump, as the command line would produce it
+     */
+    CrashReportData MakeReport(const std::wstring& dump_path, uint16_t port) {
+        CrashReportData data;
+        data.url = L"http://127.0.0.1:" + std::to_wstring(port) + L"/";
+        data.urls = { data.url };
+        data.version = "1.0.0";
+        data.error = "Access violation at 0x00401000 in L2.exe";
+        data.dump_path = dump_path;
+        data.temp_path = L"error.txt";
+        CrashReportDataBuilder::ProcessServerUrl(data);
+        return data;
+    }
+
+    /**
+     * @brief Parser handler that checks what came back out of a body
+     */
+    class PartCounter : public MultipartHandler {
+    public:
+        bool OnPartBegin(const MultipartPart& part) noexcept override {
+            in_file_ = part.IsFile();
+            if (!in_file_) {
+                fields.emplace_back();
+            }
+            return true;
+        }
+
+        bool OnPartData(std::string_view data) noexcept override {
+            if (in_file_) {
+                file_bytes += data.size();
+                return true;
+            }
+            try {
+                fields.back().append(data);
+                return true;
+            }
+            catch (...) {
+                return false;
+            }
+        }
+
+        bool OnPartEnd() noexcept override {
+            return true;
+        }
+
+        uint64_t file_bytes = 0;
+        std::vector<std::string> fields;
+
+    private:
+        bool in_file_ = false;
+    };
+
+    bool Enabled(const BenchOptions& options, std::string_view name) {
+        return options.cases.empty() ||
+               std::find(options.cases.begin(), options.cases.end(), name) != options.cases.end();
+    }
+
+    void RunTextCases(const BenchOptions& options) {
+        if (Enabled(options, "wide_to_utf8")) {
+            // Mixed Latin and Cyrillic like the game logs and error descriptions
+            std::wstring text;
+            text.reserve(4 * MB);
+            while (text.size() < 4 * MB) {
+                text += L"Ошибка доступа at L2.exe+0x1F00 ";
+            }
+            const uint64_t bytes = text.size() * sizeof(wchar_t);
+            Measure(options, "wide_to_utf8", bytes, bytes, [&]() {
+                return !TextUtils::WideToUtf8(text).empty();
+            });
+        }
+
+        if (Enabled(options, "logger")) {
+            constexpr size_t messages = 10000;
+            const std::string message = "Body sent in 12 ms (2861 MB/s, zero-copy) for endpoint http://127.0.0.1/";
+            Measure(options, "logger", 0, messages * message.size(), [&]() {
+                for (size_t i = 0; i < messages; ++i) {
+                    Logger::LogDebug(message);
+                }
+                return true;
+            });
+        }
+    }
+
+    /**
+     * @brief Share of a file's pages in the system cache in percent, -1 where the system cannot tell
+     */
+    double ResidentPercent(const std::wstring& path) {
+#ifdef _WIN32
+        // The cache manager does not report residency of a file
+        (void)path;
+        return -1;
+#else
+        MappedFile mapping;
+        std::string error_message;
+        if (!mapping.Open(path, error_message) || mapping.size() == 0) {
+            return -1;
+        }
+
+        const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        std::vector<unsigned char> pages(static_cast<size_t>((mapping.size() + page_size - 1) / page_size));
+        if (mincore(const_cast<char*>(mapping.data()), static_cast<size_t>(mapping.size()), pages.data()) != 0) {
+            return -1;
+        }
+        const auto resident = std::count_if(pages.begin(), pages.end(), [](unsigned char page) { return (page & 1) != 0; });
+        return 100.0 * static_cast<double>(resident) / static_cast<double>(pages.size());
+#endif
+    }
+
+    /**
+     * @brief Write back and drop the cached pages of a file, best effort
+     */
+    void EvictFromCache(const std::wstring& path) {
+#ifndef _WIN32
+        // Dirty pages cannot be dropped
+        sync();
+#endif
+        FileHandle file;
+        if (FileSystem::OpenRead(path, FileSystem::Access::Normal, file) == FileSystem::OpenResult::Ok) {
+            FileSystem::DropCache(file, 0, static_cast<uint64_t>(std::max<int64_t>(FileSystem::Size(file), 0)));
+        }
+    }
+
+    /**
+     * @brief Read a file from start to end in 1 MB steps, again and again until stopped
+     * @return Bytes read
+     */
+    uint64_t ReadRepeatedly(const std::wstring& path, const std::atomic<bool>& stop) {
+        FileHandle file;
+        if (FileSystem::OpenRead(path, FileSystem::Access::Sequential, file) != FileSystem::OpenResult::Ok) {
+            return 0;
+        }
+
+        std::vector<char> buffer(1 * MB);
+        uint64_t total = 0;
+        uint64_t offset = 0;
+        do {
+            const int64_t bytes_read = FileSystem::ReadAt(file, offset, buffer.data(), buffer.size());
+            if (bytes_read < 0) {
+                break;
+            }
+            offset = bytes_read == 0 ? 0 : offset + static_cast<uint64_t>(bytes_read);
+            total += static_cast<uint64_t>(bytes_read);
+        } while (!stop.load(std::memory_order_relaxed));
+        return total;
+    }
+
+    /**
+     * @brief Upload a dump through the cache and around it while a "game" reads its data file
+     *
+     * The dump is evicted before each mode, whatever of it is cached afterwards
+     * came in with the upload. The game file is read once up front so it is hot
+     * like the assets of a running game. Without memory pressure it keeps its
+     * pages in both modes, then its read rate shows the contention between the
+     * two readers.
+     */
+    void RunCacheResidencyCase(const BenchOptions& options, const CrashReportData& data, const std::wstring& path, uint64_t size) {
+        constexpr uint64_t game_size = 64 * MB;
+        const std::wstring game_path = options.directory + L"/crashsender_bench_game.bin";
+        if (!CreateSyntheticDump(game_path, game_size)) {
+            std::fprintf(stderr, "Failed to create the game file, cache_residency case is skipped\n");
+            return;
+        }
+
+        for (const bool unbuffered : { false, true }) {
+            // The cached mode is the default path of the platform, zero-copy where the transport has it
+            CrashReportData upload = data;
+            upload.unbuffered_threshold = unbuffered ? 1 : 0;
+
+            EvictFromCache(path);
+            std::vector<char> warm;
+            std::string warm_error;
+            (void)FileUtils::AppendToBuffer(game_path, warm, warm_error);
+
+            std::atomic<bool> stop{ false };
+            uint64_t game_bytes = 0;
+            std::thread game([&]() { game_bytes = ReadRepeatedly(game_path, stop); });
+
+            uint64_t iterations = 0;
+            bool ok = true;
+            const auto started = std::chrono::steady_clock::now();
+            double seconds = 0;
+            do {
+                const CancellationToken token;
+                bool retryable = true;
+                std::string error_message;
+                ok = HttpClient::SendCrashReport(upload, token, retryable, error_message);
+                if (!ok) {
+                    std::fprintf(stderr, "Upload failed: %s\n", error_message.c_str());
+                }
+                ++iterations;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            } while (ok && seconds < options.min_seconds);
+
+            stop = true;
+            game.join();
+
+            std::printf("{\"case\":\"cache_residency\",\"mode\":\"%s\",\"input_bytes\":%llu,\"iterations\":%llu,"
+                        "\"seconds\":%.6f,\"bytes_per_second\":%.0f,\"game_bytes_per_second\":%.0f,"
+                        "\"dump_resident_percent\":%.1f,\"game_resident_percent\":%.1f,\"ok\":%s}\n",
+                        unbuffered ? "unbuffered" : "cached", static_cast<unsigned long long>(size),
+                        static_cast<unsigned long long>(iterations), seconds,
+                        seconds > 0 ? static_cast<double>(size) * static_cast<double>(iterations) / seconds : 0,
+                        seconds > 0 ? static_cast<double>(game_bytes) / seconds : 0,
+                        ResidentPercent(path), ResidentPercent(game_path), ok ? "true" : "false");
+            std::fflush(stdout);
+        }
+
+        if (!options.keep_files) {
+            std::string error_message;
+            (void)FileSystem::Remove(game_path, error_message);
+        }
+    }
+
+    void RunFileCases(const BenchOptions& options, const std::wstring& path, uint64_t size, uint16_t port) {
+        const CrashReportData data = MakeReport(path, port);
+
+        if (Enabled(options, "body_build")) {
+            Measure(options, "body_build", size, size, [&]() {
+                MultipartBody body;
+                std::string error_message;
+                return HttpClient::CreateMultipartFormData(data, body, error_message);
+            });
+        }
+
+        if (Enabled(options, "report_build")) {
+            // Everything between the command line of the game and a body ready to send
+            const std::wstring error_path = path + L".error.txt";
+            if (WriteErrorFile(error_path, data.error)) {
+                std::vector<std::wstring> arguments{ L"L2CrashSender", L"-url=" + data.url, L"-version=1.0.0",
+                                                     L"-error=" + error_path, L"-dump=" + path, L"-standalone" };
+                std::vector<wchar_t*> argv;
+                for (auto& argument : arguments) {
+                    argv.push_back(argument.data());
+                }
+                argv.push_back(nullptr);
+
+                Measure(options, "report_build", size, size, [&]() {
+                    std::string error_message;
+                    auto report = CrashReportDataBuilder::ParseCommandLine(static_cast<int>(arguments.size()), argv.data(), error_message);
+                    if (!report) {
+                        return false;
+                    }
+                    CrashReportDataBuilder::ProcessServerUrl(*report);
+
+                    MultipartBody body;
+                    return CrashReportDataBuilder::ProcessErrorContent(*report) && report->error == data.error &&
+                           HttpClient::CreateMultipartFormData(*report, body, error_message);
+                });
+            }
+            std::string error_message;
+            (void)FileSystem::Remove(error_path, error_message);
+        }
+
+        if (Enabled(options, "body_stream")) {
+            MultipartBody body;
+            std::string error_message;
+            if (HttpClient::CreateMultipartFormData(data, body, error_message)) {
+                Measure(options, "body_stream", size, body.TotalSize(), [&]() {
+                    ReadAheadPipeline pipeline;
+                    uint64_t streamed = 0;
+                    const auto sink = [&](const char*, size_t chunk_size, std::string&) {
+                        streamed += chunk_size;
+                        return true;
+                    };
+                    for (const auto& segment : body.Segments()) {
+                        if (segment.kind != BodySegment::Kind::File) {
+                            streamed += segment.size;
+                        } else if (!pipeline.Stream(segment.path, segment.offset, segment.size, sink, error_message)) {
+                            return false;
+                        }
+                    }
+                    return streamed == body.TotalSize();
+                });
+            }
+        }
+
+        if (Enabled(options, "multipart_parse")) {
+            MultipartBody body;
+            std::string error_message;
+            if (HttpClient::CreateMultipartFormData(data, body, error_message)) {
+                // Round trip of the sender's own body through the ingest parser
+                const std::string& error = data.error;
+                Measure(options, "multipart_parse", size, body.TotalSize(), [&]() {
+                    PartCounter counter;
+                    MultipartParser parser("MULTIPART-DATA-BOUNDARY", counter);
+                    ReadAheadPipeline pipeline;
+                    uint32_t checksum = 0;
+                    const auto feed = [&](const char* chunk, size_t chunk_size, std::string& feed_error) {
+                        checksum = Crc32c::Update(checksum, chunk, chunk_size);
+                        return parser.Feed(chunk, chunk_size, feed_error);
+                    };
+                    for (const auto& segment : body.Segments()) {
+                        bool fed = false;
+                        if (segment.kind == BodySegment::Kind::Memory) {
+                            fed = parser.Feed(segment.bytes.data(), segment.bytes.size(), error_message);
+                        } else if (segment.kind == BodySegment::Kind::Checksum) {
+                            const std::string hex = Crc32c::ToHex(checksum);
+                            fed = parser.Feed(hex.data(), hex.size(), error_message);
+                        } else {
+                            fed = pipeline.Stream(segment.path, segment.offset, segment.size, feed, error_message);
+                        }
+                        if (!fed) {
+                            std::fprintf(stderr, "Parse failed: %s\n", error_message.c_str());
+                            return false;
+                        }
+                    }
+                    return parser.IsComplete() && counter.file_bytes == size &&
+                           std::find(counter.fields.begin(), counter.fields.end(), error) != counter.fields.end();
+                });
+            }
+        }
+
+        if (Enabled(options, "archive_pack")) {
+            const std::wstring archive_path = path + std::wstring(ReportArchive::kExtension);
+            Measure(options, "archive_pack", size, size, [&]() {
+                std::string error_message;
+                ReportArchive archive;
+                return ReportArchive::Pack(data, archive_path, error_message) &&
+                       archive.Open(archive_path, error_message) && archive.Find("dumpfile") &&
+                       archive.Find("dumpfile")->size == size;
+            });
+            std::string error_message;
+            (void)FileSystem::Remove(archive_path, error_message);
+        }
+
+        if (Enabled(options, "crc32c")) {
+            MappedFile mapping;
+            std::string error_message;
+            if (mapping.Open(path, error_message)) {
+                Measure(options, "crc32c", size, size, [&]() {
+                    checksum_sink = Crc32c::Update(0, mapping.data(), static_cast<size_t>(mapping.size()));
+                    return true;
+                });
+            }
+        }
+
+        if (Enabled(options, "append_to_buffer") && size <= options.max_buffer) {
+            Measure(options, "append_to_buffer", size, size, [&]() {
+                std::vector<char> buffer;
+                std::string error_message;
+                return FileUtils::AppendToBuffer(path, buffer, error_message) && buffer.size() == size;
+            });
+        }
+
+        if (Enabled(options, "mapped_read")) {
+            Measure(options, "mapped_read", size, size, [&]() {
+                MappedFile mapping;
+                std::string error_message;
+                if (!mapping.Open(path, error_message)) {
+                    return false;
+                }
+
+                // Touch every byte so the whole file is faulted in
+                uint64_t checksum = 0;
+                const char* data_end = mapping.data() + mapping.size();
+                for (const char* cursor = mapping.data(); cursor + sizeof(uint64_t) <= data_end; cursor += sizeof(uint64_t)) {
+                    uint64_t word;
+                    std::memcpy(&word, cursor, sizeof(word));
+                    checksum ^= word;
+                }
+                checksum_sink = checksum;
+                return true;
+            });
+        }
+
+        const struct {
+            std::string_view name;
+            bool zero_copy;
+            uint64_t unbuffered_threshold;
+        } uploads[] = {
+            { "upload_zero_copy", true, 0 },
+            { "upload_buffered", false, 0 },
+            { "upload_unbuffered", false, 1 },
+        };
+        for (const auto& [name, zero_copy, unbuffered_threshold] : uploads) {
+            if (!Enabled(options, name) || port == 0) {
+                continue;
+            }
+
+            CrashReportData upload = data;
+            upload.zero_copy = zero_copy;
+            upload.unbuffered_threshold = unbuffered_threshold;
+            Measure(options, name, size, size, [&]() {
+                const CancellationToken token;
+                bool retryable = true;
+                std::string error_message;
+                if (!HttpClient::SendCrashReport(upload, token, retryable, error_message)) {
+                    std::fprintf(stderr, "Upload failed: %s\n", error_message.c_str());
+                    return false;
+                }
+                return true;
+            });
+        }
+
+        if (Enabled(options, "cache_residency") && port != 0) {
+            RunCacheResidencyCase(options, data, path, size);
+        }
+    }
+
+    /**
+     * @brief Spawn the sender against the loopback server, time process creation to the first request byte
+     *
+     * Every run is the first crash of the machine: the signature registry the
+     * sender keeps in the working directory is removed before it starts, and
+     * the error text differs from earlier runs. The dump is small, the startup
+     * path only probes its size.
+     */
+    void RunStartupCase(const BenchOptions& options, LoopbackSink& sink) {
+        FileHandle executable;
+        if (FileSystem::OpenRead(TextUtils::Utf8ToWide(options.sender), FileSystem::Access::Normal, executable) !=
+            FileSystem::OpenResult::Ok) {
+            std::fprintf(stderr, "Sender not found at %s, startup case is skipped (see --sender)\n", options.sender.c_str());
+            return;
+        }
+        executable.Close();
+
+        constexpr uint64_t dump_size = 64 * KB;
+        const std::wstring dump_path = options.directory + L"/crashsender_startup.dmp";
+        const std::wstring error_path = options.directory + L"/crashsender_startup.txt";
+        const std::wstring profile_path = options.directory + L"/crashsender_startup.profile";
+        constexpr size_t stage_count = static_cast<size_t>(StartupProfile::Stage::Count);
+
+        const std::string nonce = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+        std::vector<double> totals;
+        std::vector<std::vector<double>> stages(stage_count);
+        bool ok = true;
+        for (size_t run = 0; run < options.runs && ok; ++run) {
+            // A successful sender removes both files
+            const std::string error = "Access violation at 0x00401000 in L2.exe, startup run " + nonce + "." + std::to_string(run);
+            std::string remove_error;
+            (void)FileSystem::Remove(UploadCoordinator::kRegistryFile, remove_error);
+            if (!CreateSyntheticDump(dump_path, dump_size) || !WriteErrorFile(error_path, error)) {
+                ok = false;
+                break;
+            }
+
+            const std::vector<std::string> arguments{
+                "-url=http://127.0.0.1:" + std::to_string(sink.port()) + "/", "-version=1.0.0",
+                "-error=" + TextUtils::WideToUtf8(error_path), "-dump=" + TextUtils::WideToUtf8(dump_path),
+                "-standalone", "-profile-startup" };
+            sink.ResetFirstByte();
+            std::chrono::steady_clock::time_point spawned;
+            std::chrono::steady_clock::time_point first_byte;
+            int exit_code = 1;
+            if (!RunProcess(options.sender, arguments, profile_path, spawned, exit_code) || exit_code != 0 ||
+                !sink.FirstByte(first_byte)) {
+                std::fprintf(stderr, "Sender run %zu failed with exit code %d\n", run, exit_code);
+                ok = false;
+                break;
+            }
+            const double total = std::chrono::duration<double, std::micro>(first_byte - spawned).count();
+            totals.push_back(total);
+
+            // The profile counts from main(), shift it so every stage counts from the spawn
+            std::vector<char> profile;
+            std::string error_message;
+            if (!FileUtils::AppendToBuffer(profile_path, profile, error_message)) {
+                continue;
+            }
+            const std::string_view text(profile.data(), profile.size());
+            std::vector<double> marks(stage_count, -1);
+            for (size_t i = 0; i < stage_count; ++i) {
+                const std::string key = "\"" + std::string(StartupProfile::Name(static_cast<StartupProfile::Stage>(i))) + "\":";
+                const size_t found = text.find(key);
+                if (found != std::string_view::npos) {
+                    marks[i] = std::strtod(std::string(text.substr(found + key.size(), 24)).c_str(), nullptr);
+                }
+            }
+            const double first_byte_mark = marks[static_cast<size_t>(StartupProfile::Stage::FirstByte)];
+            if (first_byte_mark < 0) {
+                continue;
+            }
+            for (size_t i = 0; i < stage_count; ++i) {
+                if (marks[i] >= 0) {
+                    stages[i].push_back(total - (first_byte_mark - marks[i]));
+                }
+            }
+        }
+
+        std::string stage_medians;
+        for (size_t i = 0; i < stage_count; ++i) {
+            if (stages[i].empty()) {
+                continue;
+            }
+            char median[64];
+            std::snprintf(median, sizeof(median), "%s\"%s\":%.0f", stage_medians.empty() ? "" : ",",
+                          std::string(StartupProfile::Name(static_cast<StartupProfile::Stage>(i))).c_str(),
+                          Percentile(stages[i], 0.5));
+            stage_medians += median;
+        }
+
+        std::printf("{\"case\":\"startup\",\"input_bytes\":%llu,\"runs\":%zu,\"p50_us\":%.0f,\"p99_us\":%.0f,"
+                    "\"max_us\":%.0f,\"stages_p50_us\":{%s},\"ok\":%s}\n",
+                    static_cast<unsigned long long>(dump_size), totals.size(), Percentile(totals, 0.5),
+                    Percentile(totals, 0.99), Percentile(totals, 1.0), stage_medians.c_str(), ok ? "true" : "false");
+        std::fflush(stdout);
+
+        std::string error_message;
+        (void)FileSystem::Remove(dump_path, error_message);
+        (void)FileSystem::Remove(error_path, error_message);
+        (void)FileSystem::Remove(profile_path, error_message);
+    }
+
+} // anonymous namespace
+
+int RunBenchmarks(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.sender.empty()) {
+        // Both are built into the same directory
+        const std::string_view self(argv[0]);
+        const size_t separator = self.find_last_of("/\\");
+        options.sender = std::string(separator == std::string_view::npos ? "." : self.substr(0, separator));
+#ifdef _WIN32
+        options.sender += "/L2CrashSender.exe";
+#else
+        options.sender += "/L2CrashSender";
+#endif
+    }
+
+    // Off the working directory, which may be a source tree or hold the log of a sender
+    static std::string log_path;
+    std::error_code temp_error;
+    const std::filesystem::path temp_directory = std::filesystem::temp_directory_path(temp_error);
+    log_path = ((temp_error ? std::filesystem::path(".") : temp_directory) / "crashsender_bench.log").string();
+    Logger::SetFileName(log_path.c_str());
+
+    RunTextCases(options);
+
+    LoopbackSink sink;
+    const bool sink_started = sink.Start();
+    if (!sink_started) {
+        std::fprintf(stderr, "Failed to start loopback server, upload cases are skipped\n");
+    }
+
+    if (Enabled(options, "startup") && sink_started) {
+        RunStartupCase(options, sink);
+    }
+
+    for (const uint64_t size : options.sizes) {
+        const std::wstring path = options.directory + L"/crashsender_bench_" + std::to_wstring(size) + L".dmp";
+        if (!CreateSyntheticDump(path, size)) {
+            std::fprintf(stderr, "Failed to create synthetic dump of %llu bytes\n", static_cast<unsigned long long>(size));
+            return 1;
+        }
+
+        RunFileCases(options, path, size, sink_started ? sink.port() : 0);
+
+        if (!options.keep_files) {
+            std::string error_message;
+            (void)FileSystem::Remove(path, error_message);
+        }
+    }
+    return 0;
+}
+
+} // namespace CrashSender
+
+int main(int argc, char* argv[]) {
+    try {
+        return CrashSender::RunBenchmarks(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,148 @@
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRASHSENDER_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRASHSENDER_CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+#include "crc32c.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr uint32_t POLYNOMIAL = 0x82F63B78; // Castagnoli, reflected
+
+    /**
+     * @brief Slicing-by-8 tables, row k advances a byte by k more positions
+     */
+    constexpr std::array<std::array<uint32_t, 256>, 8> MakeTables() {
+        std::array<std::array<uint32_t, 256>, 8> tables{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+            }
+            tables[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t k = 1; k < 8; ++k) {
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    constexpr auto TABLES = MakeTables();
+
+    uint32_t UpdateSoftware(uint32_t crc, const unsigned char* data, size_t size) noexcept {
+        while (size >= 8) {
+            uint32_t low;
+            uint32_t high;
+            std::memcpy(&low, data, 4);
+            std::memcpy(&high, data + 4, 4);
+            low ^= crc;
+            crc = TABLES[7][low & 0xFF] ^ TABLES[6][(low >> 8) & 0xFF] ^
+                  TABLES[5][(low >> 16) & 0xFF] ^ TABLES[4][low >> 24] ^
+                  TABLES[3][high & 0xFF] ^ TABLES[2][(high >> 8) & 0xFF] ^
+                  TABLES[1][(high >> 16) & 0xFF] ^ TABLES[0][high >> 24];
+            data += 8;
+            size -= 8;
+        }
+        while (size-- > 0) {
+            crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xFF];
+        }
+        return crc;
+    }
+
+#if defined(CRASHSENDER_CRC32C_SSE42)
+    bool DetectHardware() noexcept {
+#ifdef _MSC_VER
+        int registers[4]{};
+        __cpuid(registers, 1);
+        return (registers[2] & (1 << 20)) != 0;
+#else
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+#endif
+    }
+
+#ifndef _MSC_VER
+    __attribute__((target("sse4.2")))
+#endif
+    uint32_t UpdateHardware(uint32_t crc, const unsigned char* data, size_t size) noexcept {
+        uint64_t wide = crc;
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            wide = _mm_crc32_u64(wide, word);
+            data += 8;
+            size -= 8;
+        }
+        crc = static_cast<uint32_t>(wide);
+        while (size-- > 0) {
+            crc = _mm_crc32_u8(crc, *data++);
+        }
+        return crc;
+    }
+#elif defined(CRASHSENDER_CRC32C_ARM)
+    bool DetectHardware() noexcept {
+        return true;
+    }
+
+    uint32_t UpdateHardware(uint32_t crc, const unsigned char* data, size_t size) noexcept {
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            crc = __crc32cd(crc, word);
+            data += 8;
+            size -= 8;
+        }
+        while (size-- > 0) {
+            crc = __crc32cb(crc, *data++);
+        }
+        return crc;
+    }
+#endif
+
+} // anonymous namespace
+
+uint32_t Crc32c::Update(uint32_t crc, const char* data, size_t size) noexcept {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+#if defined(CRASHSENDER_CRC32C_SSE42) || defined(CRASHSENDER_CRC32C_ARM)
+    static const bool hardware = DetectHardware();
+    if (hardware) {
+        return ~UpdateHardware(~crc, bytes, size);
+    }
+#endif
+    return ~UpdateSoftware(~crc, bytes, size);
+}
+
+std::string Crc32c::ToHex(uint32_t crc) {
+    constexpr char digits[] = "0123456789abcdef";
+    std::string hex(kHexSize, '0');
+    for (size_t i = kHexSize; i-- > 0; crc >>= 4) {
+        hex[i] = digits[crc & 0xF];
+    }
+    return hex;
+}
+
+bool Crc32c::IsHardwareAccelerated() noexcept {
+#if defined(CRASHSENDER_CRC32C_SSE42) || defined(CRASHSENDER_CRC32C_ARM)
+    static const bool hardware = DetectHardware();
+    return hardware;
+#else
+    return false;
+#endif
+}
+
+} // namespace CrashSender
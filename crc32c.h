@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace CrashSender {
+
+/**
+ * @brief CRC32C (Castagnoli) checksum of uploaded files
+ *
+ * Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them and a
+ * slicing-by-8 table otherwise. Both give the same values.
+ */
+struct Crc32c {
+    /**
+     * @brief Continue a checksum with more bytes
+     * @param crc Checksum of the bytes before, 0 to start
+     * @return Checksum of all bytes so far
+     */
+    [[nodiscard]]
+    static uint32_t Update(uint32_t crc, const char* data, size_t size) noexcept;
+
+    /**
+     * @brief Checksum as 8 lowercase hex digits, the form sent to the server
+     */
+    [[nodiscard]]
+    static std::string ToHex(uint32_t crc);
+
+    [[nodiscard]]
+    static bool IsHardwareAccelerated() noexcept;
+
+    static constexpr size_t kHexSize = 8;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cwctype>
+
+#include "endpoint.h"
+
+namespace CrashSender {
+
+namespace {
+
+    bool StartsWithNoCase(std::wstring_view str, std::wstring_view prefix) noexcept {
+        return str.size() >= prefix.size() &&
+               std::equal(prefix.begin(), prefix.end(), str.begin(), [](wchar_t a, wchar_t b) {
+                   return std::towlower(a) == std::towlower(b);
+               });
+    }
+
+} // anonymous namespace
+
+std::optional<Endpoint> Endpoint::Parse(std::wstring_view url) noexcept {
+    try {
+        constexpr std::wstring_view http_prefix = L"http://";
+        constexpr std::wstring_view https_prefix = L"https://";
+
+        Endpoint endpoint;
+
+        // Scheme, plain host names default to http
+        if (StartsWithNoCase(url, https_prefix)) {
+            endpoint.secure = true;
+            endpoint.port = 443;
+            url.remove_prefix(https_prefix.size());
+        }
+        else if (StartsWithNoCase(url, http_prefix)) {
+            url.remove_prefix(http_prefix.size());
+        }
+        else if (url.find(L"://") != std::wstring_view::npos) {
+            return std::nullopt;
+        }
+
+        // Fragments are never sent to the server
+        if (const auto hash_pos = url.find(L'#'); hash_pos != std::wstring_view::npos) {
+            url = url.substr(0, hash_pos);
+        }
+
+        const auto authority_end = url.find_first_of(L"/?");
+        std::wstring_view authority = url.substr(0, authority_end);
+        const std::wstring_view rest = authority_end == std::wstring_view::npos ? std::wstring_view{} : url.substr(authority_end);
+
+        // Credentials are not supported, drop them
+        if (const auto at_pos = authority.rfind(L'@'); at_pos != std::wstring_view::npos) {
+            authority.remove_prefix(at_pos + 1);
+        }
+
+        std::wstring_view port;
+        if (!authority.empty() && authority.front() == L'[') {
+            // IPv6 literal
+            const auto close_pos = authority.find(L']');
+            if (close_pos == std::wstring_view::npos) {
+                return std::nullopt;
+            }
+            endpoint.host = authority.substr(1, close_pos - 1);
+            const std::wstring_view tail = authority.substr(close_pos + 1);
+            if (!tail.empty()) {
+                if (tail.front() != L':') {
+                    return std::nullopt;
+                }
+                port = tail.substr(1);
+            }
+        }
+        else if (const auto colon_pos = authority.rfind(L':'); colon_pos != std::wstring_view::npos) {
+            endpoint.host = authority.substr(0, colon_pos);
+            port = authority.substr(colon_pos + 1);
+        }
+        else {
+            endpoint.host = authority;
+        }
+
+        if (endpoint.host.empty()) {
+            return std::nullopt;
+        }
+
+        if (!port.empty()) {
+            if (port.size() > 5 || !std::all_of(port.begin(), port.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+                return std::nullopt;
+            }
+            const unsigned long value = std::stoul(std::wstring(port));
+            if (value == 0 || value > 65535) {
+                return std::nullopt;
+            }
+            endpoint.port = static_cast<uint16_t>(value);
+        }
+
+        if (rest.empty()) {
+            endpoint.path = L"/";
+        }
+        else if (rest.front() == L'?') {
+            endpoint.path = L"/" + std::wstring(rest);
+        }
+        else {
+            endpoint.path = rest;
+        }
+
+        return endpoint;
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+}
+
+std::wstring Endpoint::ToString() const {
+    std::wstring url = secure ? L"https://" : L"http://";
+    url += host.find(L':') != std::wstring::npos ? L"[" + host + L"]" : host;
+    if (port != (secure ? 443 : 80)) {
+        url += L":" + std::to_wstring(port);
+    }
+    url += path;
+    return url;
+}
+
+} // namespace CrashSender
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace CrashSender {
+
+/**
+ * @brief Parsed crash report server URL
+ */
+struct Endpoint {
+    std::wstring host{};     ///< Host name or address, IPv6 without brackets
+    uint16_t port{80};       ///< TCP port
+    std::wstring path{L"/"}; ///< Path and query, always starts with '/'
+    bool secure{false};      ///< true for https
+
+    /**
+     * @brief Parse an URL of the form [http[s]://]host[:port][/path][?query]
+     * @param url URL to parse
+     * @return Endpoint on success, nullopt for malformed URLs or unsupported schemes
+     */
+    [[nodiscard]]
+    static std::optional<Endpoint> Parse(std::wstring_view url) noexcept;
+
+    /**
+     * @brief Canonical URL, default ports are omitted
+     */
+    [[nodiscard]]
+    std::wstring ToString() const;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "http_client.h"
+#include "endpoint_selector.h"
+
+namespace CrashSender {
+
+namespace {
+
+    /**
+     * @brief Cached winner, the endpoint on the first line and the Unix time it was cached on the second
+     */
+    struct CachedEndpoint {
+        std::wstring endpoint;
+        int64_t cached_at = 0;
+    };
+
+    int64_t UnixSeconds() noexcept {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::optional<CachedEndpoint> LoadCachedEndpoint() noexcept {
+        try {
+            std::ifstream file(std::filesystem::path(EndpointSelector::kCacheFile), std::ios::in | std::ios::binary);
+            std::string line;
+            std::string stamp;
+            if (!file.is_open() || !std::getline(file, line) || line.empty() || !std::getline(file, stamp)) {
+                return std::nullopt;
+            }
+            return CachedEndpoint{ TextUtils::Utf8ToWide(line), std::stoll(stamp) };
+        }
+        catch (...) {
+            return std::nullopt;
+        }
+    }
+
+    bool IsFresh(const CachedEndpoint& cached) noexcept {
+        const int64_t age = UnixSeconds() - cached.cached_at;
+        return age >= 0 && age < std::chrono::duration_cast<std::chrono::seconds>(EndpointSelector::kCacheTtl).count();
+    }
+
+    /**
+     * @brief Probe result of one endpoint
+     */
+    struct ProbeResult {
+        bool finished = false;
+        bool reachable = false;
+        std::chrono::milliseconds latency{ 0 };
+    };
+
+} // anonymous namespace
+
+/**
+ * @brief Results shared with the probe threads, kept until they are joined
+ */
+struct EndpointSelector::ProbeState {
+    explicit ProbeState(const std::vector<Endpoint>& probed) : endpoints(probed), results(probed.size()) {}
+
+    const std::vector<Endpoint> endpoints;
+    CancellationToken cancellation;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<ProbeResult> results;
+    size_t finished = 0;
+};
+
+EndpointSelector::EndpointSelector() noexcept = default;
+
+EndpointSelector::~EndpointSelector() {
+    StopProbes();
+}
+
+void EndpointSelector::StopProbes() noexcept {
+    if (state_) {
+        state_->cancellation.Cancel();
+    }
+    // Joined before the state they write to goes away
+    probes_.clear();
+    state_.reset();
+}
+
+std::vector<Endpoint> EndpointSelector::Order(const std::vector<Endpoint>& endpoints, const CancellationToken& token) noexcept {
+    try {
+        if (endpoints.size() < 2) {
+            return endpoints;
+        }
+
+        // The last winner goes first, no probing needed until the cache expires
+        const auto cached = LoadCachedEndpoint();
+        if (cached && IsFresh(*cached)) {
+            const auto it = std::find_if(endpoints.begin(), endpoints.end(), [&](const Endpoint& endpoint) {
+                return endpoint.ToString() == cached->endpoint;
+            });
+
+            if (it != endpoints.end()) {
+                Logger::LogDebug(L"Using cached endpoint: " + cached->endpoint);
+                std::vector<Endpoint> ordered{ *it };
+                std::copy_if(endpoints.begin(), endpoints.end(), std::back_inserter(ordered), [&](const Endpoint& endpoint) {
+                    return &endpoint != &*it;
+                });
+                return ordered;
+            }
+        }
+
+        // Probe all endpoints at once, the selector joins the probes when it goes away
+        StopProbes();
+        const auto timeout = token.Clamp(kProbeTimeout);
+        state_ = std::make_unique<ProbeState>(endpoints);
+        ProbeState* const state = state_.get();
+        probes_.reserve(endpoints.size());
+        size_t started = 0;
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            try {
+                probes_.emplace_back([state, i, timeout]() noexcept {
+                    std::chrono::milliseconds latency{ 0 };
+                    const bool reachable = HttpClient::ProbeEndpoint(state->endpoints[i], timeout, state->cancellation, latency);
+                    {
+                        std::lock_guard lock(state->mutex);
+                        state->results[i] = ProbeResult{ true, reachable, latency };
+                        ++state->finished;
+                    }
+                    state->changed.notify_all();
+                });
+                ++started;
+            }
+            catch (...) {
+                // Endpoints that could not be probed keep their configured position
+                break;
+            }
+        }
+
+        // The first endpoint to answer is the lowest-latency one, the slower probes do not delay the report
+        std::vector<ProbeResult> results;
+        {
+            std::unique_lock lock(state->mutex);
+            state->changed.wait_for(lock, timeout, [&] {
+                return state->finished == started ||
+                       std::any_of(state->results.begin(), state->results.end(), [](const ProbeResult& result) { return result.reachable; });
+            });
+            results = state->results;
+        }
+
+        std::vector<size_t> order(endpoints.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (results[a].reachable != results[b].reachable) {
+                return results[a].reachable;
+            }
+            return results[a].reachable && results[a].latency < results[b].latency;
+        });
+
+        std::vector<Endpoint> ordered;
+        for (const size_t index : order) {
+            Logger::LogDebug(L"Endpoint " + endpoints[index].ToString() + L": " +
+                             (results[index].reachable ? std::to_wstring(results[index].latency.count()) + L" ms"
+                                                       : std::wstring(results[index].finished ? L"unreachable" : L"no answer yet")));
+            ordered.push_back(endpoints[index]);
+        }
+        return ordered;
+    }
+    catch (...) {
+        Logger::LogError("Exception occurred while ordering endpoints");
+        return endpoints;
+    }
+}
+
+void EndpointSelector::Remember(const Endpoint& endpoint) noexcept {
+    try {
+        const std::wstring name = endpoint.ToString();
+        const auto cached = LoadCachedEndpoint();
+        if (cached && cached->endpoint == name && IsFresh(*cached)) {
+            return;
+        }
+
+        std::ofstream file(std::filesystem::path(kCacheFile), std::ios::out | std::ios::binary | std::ios::trunc);
+        file << TextUtils::WideToUtf8(name) << '\n' << UnixSeconds() << '\n';
+    }
+    catch (...) {
+        // Non-critical failure
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "endpoint.h"
+
+namespace CrashSender {
+
+class CancellationToken;
+
+/**
+ * @brief Chooses the order in which report endpoints are tried
+ *
+ * The endpoint that delivered the previous report is cached on disk and tried
+ * first for kCacheTtl, then the endpoints are probed again. Without a usable
+ * cache all endpoints are probed in parallel and the first one to answer goes
+ * first. The slower probes keep running while the report is sent and are
+ * cancelled and joined when the selector is destroyed.
+ */
+class EndpointSelector {
+public:
+    static constexpr std::wstring_view kCacheFile = L"L2CrashSender.endpoint";
+    static constexpr std::chrono::milliseconds kProbeTimeout{ 3000 };
+    static constexpr std::chrono::hours kCacheTtl{ 1 }; ///< Age of the cached winner after which endpoints are probed again
+
+    EndpointSelector() noexcept;
+
+    /**
+     * @brief Cancel the probes still running and wait for them, at most about kProbeTimeout
+     */
+    ~EndpointSelector();
+
+    // Non-copyable, non-movable
+    EndpointSelector(const EndpointSelector&) = delete;
+    EndpointSelector& operator=(const EndpointSelector&) = delete;
+    EndpointSelector(EndpointSelector&&) = delete;
+    EndpointSelector& operator=(EndpointSelector&&) = delete;
+
+    /**
+     * @brief Order endpoints by preference
+     * @param endpoints Configured endpoints
+     * @param token Cancellation, bounds the probe phase
+     * @return Endpoints in the order they should be tried
+     */
+    [[nodiscard]]
+    std::vector<Endpoint> Order(const std::vector<Endpoint>& endpoints, const CancellationToken& token) noexcept;
+
+    /**
+     * @brief Cache the endpoint that accepted a report
+     *
+     * The age of the cache is kept when the endpoint did not change, so a
+     * winner that keeps delivering is still probed against the others once
+     * kCacheTtl has passed.
+     */
+    static void Remember(const Endpoint& endpoint) noexcept;
+
+private:
+    struct ProbeState;
+
+    /**
+     * @brief Cancel and join the probes of the previous Order() call
+     */
+    void StopProbes() noexcept;
+
+    std::unique_ptr<ProbeState> state_;
+    std::vector<std::jthread> probes_;
+};
+
+} // namespace CrashSender
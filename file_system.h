@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace CrashSender {
+
+#ifdef _WIN32
+using NativeFileHandle = void*; ///< HANDLE
+#else
+using NativeFileHandle = int;   ///< File descriptor
+#endif
+
+/**
+ * @brief RAII for a native file handle
+ */
+class FileHandle {
+public:
+    FileHandle() noexcept = default;
+    explicit FileHandle(NativeFileHandle handle) noexcept : handle_(handle) {}
+    ~FileHandle();
+
+    // Non-copyable, movable
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+
+    FileHandle(FileHandle&& other) noexcept : handle_(other.handle_) {
+        other.handle_ = kInvalid;
+    }
+
+    FileHandle& operator=(FileHandle&& other) noexcept;
+
+    [[nodiscard]]
+    NativeFileHandle get() const noexcept {
+        return handle_;
+    }
+
+    [[nodiscard]]
+    explicit operator bool() const noexcept {
+        return handle_ != kInvalid;
+    }
+
+    void Close() noexcept;
+
+    static const NativeFileHandle kInvalid;
+
+private:
+    NativeFileHandle handle_ = kInvalid;
+};
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ */
+class MappedFile {
+public:
+    MappedFile() noexcept = default;
+    ~MappedFile();
+
+    // Non-copyable, non-movable
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    /**
+     * @brief Map a file into memory
+     * @param filepath Path to file
+     * @param error_message Placeholder for error if it will occurs
+     * @return true on success, empty files map to an empty view
+     */
+    [[nodiscard]]
+    bool Open(std::wstring_view filepath, std::string& error_message) noexcept;
+
+    void Close() noexcept;
+
+    [[nodiscard]]
+    const char* data() const noexcept { return data_; }
+
+    [[nodiscard]]
+    uint64_t size() const noexcept { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    uint64_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
+/**
+ * @brief Platform file system operations used by the sender
+ */
+struct FileSystem {
+    enum class Access : int {
+        Normal = 0,     ///< Plain synchronous reads
+        Sequential = 1, ///< Hint sequential access to the cache manager
+        Overlapped = 2, ///< Asynchronous reads (OVERLAPPED on Windows, same as Sequential on POSIX)
+        Unbuffered = 3  ///< Overlapped reads around the system cache (FILE_FLAG_NO_BUFFERING, O_DIRECT), see kUnbufferedAlignment
+    };
+
+    /**
+     * @brief Alignment of offsets, lengths and buffer addresses of Unbuffered reads
+     *
+     * A multiple of the sector size of 512e and 4Kn disks, and the page size,
+     * so page-aligned buffers qualify. A read may end past the end of the file
+     * and then returns fewer bytes.
+     */
+    static constexpr size_t kUnbufferedAlignment = 4096;
+
+    enum class OpenResult : int {
+        Ok = 0,
+        NotFound = 1,
+        Busy = 2,   ///< Opened by another process without read sharing
+        Failed = 3
+    };
+
+    [[nodiscard]]
+    static OpenResult OpenRead(std::wstring_view filepath, Access access, FileHandle& file) noexcept;
+
+    [[nodiscard]]
+    static bool CreateWrite(std::wstring_view filepath, FileHandle& file) noexcept;
+
+    /**
+     * @brief Get size of an open file
+     * @return File size in bytes, -1 on error
+     */
+    [[nodiscard]]
+    static int64_t Size(const FileHandle& file) noexcept;
+
+    /**
+     * @brief Read at an absolute offset of a handle opened with Normal or Sequential access
+     * @return Number of bytes read, -1 on error
+     */
+    [[nodiscard]]
+    static int64_t ReadAt(const FileHandle& file, uint64_t offset, char* buffer, size_t size) noexcept;
+
+    /**
+     * @brief Evict a byte range of a file from the system cache, best effort
+     *
+     * Only clean pages go, the range of a file being written stays. Windows
+     * has no such call for a read handle, there Unbuffered reads are the only
+     * way to keep a file out of the cache.
+     */
+    static void DropCache(const FileHandle& file, uint64_t offset, uint64_t size) noexcept;
+
+    /**
+     * @brief Write the whole buffer at the current position
+     */
+    [[nodiscard]]
+    static bool Write(const FileHandle& file, const char* data, size_t size) noexcept;
+
+    [[nodiscard]]
+    static bool Exists(std::wstring_view filepath) noexcept;
+
+    [[nodiscard]]
+    static bool IsFile(std::wstring_view filepath) noexcept;
+
+    /**
+     * @brief Delete a file
+     * @return true if deleted or the file did not exist
+     */
+    [[nodiscard]]
+    static bool Remove(std::wstring_view filepath, std::string& error_message) noexcept;
+
+    /**
+     * @brief Get a path that reopens the file behind an open handle
+     * @return true on success
+     */
+    [[nodiscard]]
+    static bool PathFromHandle(NativeFileHandle handle, std::wstring& filepath) noexcept;
+
+    /**
+     * @brief Copy a file, existing target is kept
+     */
+    [[nodiscard]]
+    static bool Copy(std::wstring_view from, std::wstring_view to) noexcept;
+
+    /**
+     * @brief Open or create a lock file and lock it exclusively without waiting
+     * @param lock Holds the lock until closed, the system releases it when the process dies
+     * @return false if another process holds the lock or the file cannot be opened
+     */
+    [[nodiscard]]
+    static bool TryLock(std::wstring_view filepath, FileHandle& lock) noexcept;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,274 @@
+#include <algorithm>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "file_system.h"
+
+namespace CrashSender {
+
+namespace {
+
+    std::string NativePath(std::wstring_view filepath) {
+        return TextUtils::WideToUtf8(filepath);
+    }
+
+} // anonymous namespace
+
+const NativeFileHandle FileHandle::kInvalid = -1;
+
+FileHandle::~FileHandle() {
+    Close();
+}
+
+FileHandle& FileHandle::operator=(FileHandle&& other) noexcept {
+    if (this != &other) {
+        Close();
+        handle_ = other.handle_;
+        other.handle_ = kInvalid;
+    }
+    return *this;
+}
+
+void FileHandle::Close() noexcept {
+    if (handle_ >= 0) {
+        close(handle_);
+    }
+    handle_ = kInvalid;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(std::wstring_view filepath, std::string& error_message) noexcept {
+    Close();
+
+    FileHandle file;
+    if (FileSystem::OpenRead(filepath, FileSystem::Access::Sequential, file) != FileSystem::OpenResult::Ok) {
+        error_message = "Failed to open file: " + TextUtils::WideToUtf8(filepath);
+        return false;
+    }
+
+    const int64_t size = FileSystem::Size(file);
+    if (size < 0) {
+        error_message = "Failed to get file size";
+        return false;
+    }
+
+    // Empty files cannot be mapped
+    if (size == 0) {
+        return true;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, file.get(), 0);
+    if (data == MAP_FAILED) {
+        error_message = "Failed to map file: " + TextUtils::WideToUtf8(filepath);
+        return false;
+    }
+
+    madvise(data, static_cast<size_t>(size), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<uint64_t>(size);
+    return true;
+}
+
+void MappedFile::Close() noexcept {
+    if (data_) {
+        munmap(const_cast<char*>(data_), static_cast<size_t>(size_));
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+FileSystem::OpenResult FileSystem::OpenRead(std::wstring_view filepath, Access access, FileHandle& file) noexcept {
+    try {
+        int flags = O_RDONLY | O_CLOEXEC;
+        if (access == Access::Unbuffered) {
+#ifdef O_DIRECT
+            // File systems without direct I/O (tmpfs, some FUSE mounts) fail the open with EINVAL
+            flags |= O_DIRECT;
+#else
+            return OpenResult::Failed;
+#endif
+        }
+
+        file = FileHandle(open(NativePath(filepath).c_str(), flags));
+        if (!file) {
+            return errno == ENOENT || errno == ENOTDIR ? OpenResult::NotFound : OpenResult::Failed;
+        }
+
+        if (access == Access::Sequential || access == Access::Overlapped) {
+            posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+        return OpenResult::Ok;
+    }
+    catch (...) {
+        return OpenResult::Failed;
+    }
+}
+
+bool FileSystem::CreateWrite(std::wstring_view filepath, FileHandle& file) noexcept {
+    try {
+        file = FileHandle(open(NativePath(filepath).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        return static_cast<bool>(file);
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+int64_t FileSystem::Size(const FileHandle& file) noexcept {
+    struct stat info {};
+    if (fstat(file.get(), &info) != 0) {
+        return -1;
+    }
+    return info.st_size;
+}
+
+int64_t FileSystem::ReadAt(const FileHandle& file, uint64_t offset, char* buffer, size_t size) noexcept {
+    for (;;) {
+        const ssize_t result = pread(file.get(), buffer, size, static_cast<off_t>(offset));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        return result;
+    }
+}
+
+void FileSystem::DropCache(const FileHandle& file, uint64_t offset, uint64_t size) noexcept {
+    posix_fadvise(file.get(), static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+}
+
+bool FileSystem::Write(const FileHandle& file, const char* data, size_t size) noexcept {
+    while (size > 0) {
+        const ssize_t result = write(file.get(), data, size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        data += result;
+        size -= static_cast<size_t>(result);
+    }
+    return true;
+}
+
+bool FileSystem::Exists(std::wstring_view filepath) noexcept {
+    try {
+        struct stat info {};
+        return stat(NativePath(filepath).c_str(), &info) == 0;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::IsFile(std::wstring_view filepath) noexcept {
+    try {
+        struct stat info {};
+        return stat(NativePath(filepath).c_str(), &info) == 0 && S_ISREG(info.st_mode);
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::Remove(std::wstring_view filepath, std::string& error_message) noexcept {
+    try {
+        if (unlink(NativePath(filepath).c_str()) != 0) {
+            if (errno == ENOENT) {
+                return true; // File doesn't exist, consider it success
+            }
+            error_message = "Error: " + std::to_string(errno);
+            return false;
+        }
+        return true;
+    }
+    catch (...) {
+        error_message = "Exception occurred while deleting file";
+        return false;
+    }
+}
+
+bool FileSystem::PathFromHandle(NativeFileHandle handle, std::wstring& filepath) noexcept {
+    try {
+        if (handle < 0) {
+            return false;
+        }
+
+        // The descriptor link reopens the file even after it was unlinked
+        const std::string link = "/proc/self/fd/" + std::to_string(handle);
+        char target[4096];
+        const ssize_t length = readlink(link.c_str(), target, sizeof(target) - 1);
+        const std::string_view resolved(target, length > 0 ? static_cast<size_t>(length) : 0);
+        constexpr std::string_view deleted = " (deleted)";
+
+        if (!resolved.empty() && resolved.front() == '/' &&
+            !(resolved.size() > deleted.size() && resolved.substr(resolved.size() - deleted.size()) == deleted)) {
+            filepath = TextUtils::Utf8ToWide(resolved);
+        } else {
+            filepath = TextUtils::Utf8ToWide(link);
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::Copy(std::wstring_view from, std::wstring_view to) noexcept {
+    try {
+        FileHandle source;
+        if (OpenRead(from, Access::Sequential, source) != OpenResult::Ok) {
+            return false;
+        }
+
+        FileHandle target(open(NativePath(to).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644));
+        if (!target) {
+            return false;
+        }
+
+        char buffer[64 * 1024];
+        uint64_t offset = 0;
+        for (;;) {
+            const int64_t bytes_read = ReadAt(source, offset, buffer, sizeof(buffer));
+            if (bytes_read < 0) {
+                return false;
+            }
+            if (bytes_read == 0) {
+                return true;
+            }
+            if (!Write(target, buffer, static_cast<size_t>(bytes_read))) {
+                return false;
+            }
+            offset += static_cast<uint64_t>(bytes_read);
+        }
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::TryLock(std::wstring_view filepath, FileHandle& lock) noexcept {
+    try {
+        FileHandle file(open(NativePath(filepath).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+        if (!file || flock(file.get(), LOCK_EX | LOCK_NB) != 0) {
+            return false;
+        }
+
+        lock = std::move(file);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,259 @@
+#include <algorithm>
+
+#include <windows.h>
+
+#include "utils.h"
+#include "file_system.h"
+
+namespace CrashSender {
+
+const NativeFileHandle FileHandle::kInvalid = INVALID_HANDLE_VALUE;
+
+FileHandle::~FileHandle() {
+    Close();
+}
+
+FileHandle& FileHandle::operator=(FileHandle&& other) noexcept {
+    if (this != &other) {
+        Close();
+        handle_ = other.handle_;
+        other.handle_ = kInvalid;
+    }
+    return *this;
+}
+
+void FileHandle::Close() noexcept {
+    if (handle_ != kInvalid && handle_ != nullptr) {
+        CloseHandle(handle_);
+    }
+    handle_ = kInvalid;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(std::wstring_view filepath, std::string& error_message) noexcept {
+    Close();
+
+    FileHandle file;
+    if (FileSystem::OpenRead(filepath, FileSystem::Access::Sequential, file) != FileSystem::OpenResult::Ok) {
+        error_message = "Failed to open file: " + TextUtils::WideToUtf8(filepath);
+        return false;
+    }
+
+    const int64_t size = FileSystem::Size(file);
+    if (size < 0) {
+        error_message = "Failed to get file size";
+        return false;
+    }
+
+    // Empty files cannot be mapped
+    if (size == 0) {
+        return true;
+    }
+
+    mapping_ = CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+        error_message = "Failed to create file mapping: " + TextUtils::WideToUtf8(filepath);
+        return false;
+    }
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        error_message = "Failed to map file: " + TextUtils::WideToUtf8(filepath);
+        Close();
+        return false;
+    }
+
+    size_ = static_cast<uint64_t>(size);
+    return true;
+}
+
+void MappedFile::Close() noexcept {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    data_ = nullptr;
+    mapping_ = nullptr;
+    size_ = 0;
+}
+
+FileSystem::OpenResult FileSystem::OpenRead(std::wstring_view filepath, Access access, FileHandle& file) noexcept {
+    try {
+        DWORD flags = FILE_ATTRIBUTE_NORMAL;
+        if (access == Access::Sequential) {
+            flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        }
+        else if (access == Access::Overlapped) {
+            flags |= FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN;
+        }
+        else if (access == Access::Unbuffered) {
+            // The cache manager is bypassed, a sequential scan hint would have nothing to act on
+            flags |= FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING;
+        }
+
+        const std::wstring path(filepath);
+        file = FileHandle(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr));
+        if (file) {
+            return OpenResult::Ok;
+        }
+
+        switch (GetLastError()) {
+        case ERROR_FILE_NOT_FOUND:
+        case ERROR_PATH_NOT_FOUND:
+            return OpenResult::NotFound;
+        case ERROR_SHARING_VIOLATION:
+            return OpenResult::Busy;
+        default:
+            return OpenResult::Failed;
+        }
+    }
+    catch (...) {
+        return OpenResult::Failed;
+    }
+}
+
+bool FileSystem::CreateWrite(std::wstring_view filepath, FileHandle& file) noexcept {
+    try {
+        const std::wstring path(filepath);
+        file = FileHandle(CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        return static_cast<bool>(file);
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+int64_t FileSystem::Size(const FileHandle& file) noexcept {
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file.get(), &file_size)) {
+        return -1;
+    }
+    return file_size.QuadPart;
+}
+
+int64_t FileSystem::ReadAt(const FileHandle& file, uint64_t offset, char* buffer, size_t size) noexcept {
+    // Positional read on a synchronous handle
+    OVERLAPPED overlapped{};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFull);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD bytes_read = 0;
+    const auto request = static_cast<DWORD>(std::min<size_t>(size, MAXDWORD));
+    if (!ReadFile(file.get(), buffer, request, &bytes_read, &overlapped)) {
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    }
+    return bytes_read;
+}
+
+void FileSystem::DropCache(const FileHandle& /*file*/, uint64_t /*offset*/, uint64_t /*size*/) noexcept {
+    // The cache manager keeps no per-range eviction for readers
+}
+
+bool FileSystem::Write(const FileHandle& file, const char* data, size_t size) noexcept {
+    while (size > 0) {
+        DWORD bytes_written = 0;
+        const auto request = static_cast<DWORD>(std::min<size_t>(size, MAXDWORD));
+        if (!WriteFile(file.get(), data, request, &bytes_written, nullptr) || bytes_written == 0) {
+            return false;
+        }
+        data += bytes_written;
+        size -= bytes_written;
+    }
+    return true;
+}
+
+bool FileSystem::Exists(std::wstring_view filepath) noexcept {
+    try {
+        return GetFileAttributesW(std::wstring(filepath).c_str()) != INVALID_FILE_ATTRIBUTES;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::IsFile(std::wstring_view filepath) noexcept {
+    try {
+        const DWORD attributes = GetFileAttributesW(std::wstring(filepath).c_str());
+        return (attributes != INVALID_FILE_ATTRIBUTES) && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::Remove(std::wstring_view filepath, std::string& error_message) noexcept {
+    try {
+        if (!DeleteFileW(std::wstring(filepath).c_str())) {
+            const DWORD error = GetLastError();
+            if (error == ERROR_FILE_NOT_FOUND) {
+                return true; // File doesn't exist, consider it success
+            }
+            error_message = "Error: " + std::to_string(error);
+            return false;
+        }
+        return true;
+    }
+    catch (...) {
+        error_message = "Exception occurred while deleting file";
+        return false;
+    }
+}
+
+bool FileSystem::PathFromHandle(NativeFileHandle handle, std::wstring& filepath) noexcept {
+    try {
+        std::wstring buffer(MAX_PATH, L'\0');
+        DWORD length = GetFinalPathNameByHandleW(handle, buffer.data(), static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED);
+        if (length >= buffer.size()) {
+            buffer.resize(length);
+            length = GetFinalPathNameByHandleW(handle, buffer.data(), static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED);
+        }
+        if (length == 0 || length >= buffer.size()) {
+            return false;
+        }
+
+        buffer.resize(length);
+        filepath = std::move(buffer);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::Copy(std::wstring_view from, std::wstring_view to) noexcept {
+    try {
+        return CopyFileW(std::wstring(from).c_str(), std::wstring(to).c_str(), TRUE) != FALSE;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool FileSystem::TryLock(std::wstring_view filepath, FileHandle& lock) noexcept {
+    try {
+        const std::wstring path(filepath);
+        FileHandle file(CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!file) {
+            return false;
+        }
+
+        OVERLAPPED overlapped{};
+        if (!LockFileEx(file.get(), LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+            return false;
+        }
+
+        lock = std::move(file);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+} // namespace CrashSender
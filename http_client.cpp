@@ -1,14 +1,25 @@
-#include <filesystem>
-
-#include <windows.h>
-#include <wininet.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "utils.h"
 #include "logger.h"
+#include "crc32c.h"
+#include "compression.h"
+#include "read_ahead_pipeline.h"
+#include "rate_limiter.h"
+#include "cancellation_token.h"
+#include "endpoint_selector.h"
+#include "file_system.h"
+#include "connection_pool.h"
+#include "report_archive.h"
+#include "startup_profile.h"
 #include "http_client.h"
 
-#pragma comment(lib, "wininet.lib")
-
 namespace CrashSender {
 
 namespace {
@@ -16,160 +27,722 @@ namespace {
     constexpr std::string_view BOUNDARY = "--MULTIPART-DATA-BOUNDARY";
     constexpr std::string_view CRLF = "\r\n";
 
+    constexpr std::string_view MULTIPART_HEADERS =
+        "Content-Type: multipart/form-data; boundary=MULTIPART-DATA-BOUNDARY\r\n"
+        "Content-Transfer-Encoding: binary\r\n";
+    constexpr std::string_view PART_HEADERS =
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Transfer-Encoding: binary\r\n";
+
+    // Zero-copy sends are split so cancellation is noticed between them
+    constexpr uint64_t ZERO_COPY_CHUNK = 8 * 1024 * 1024;
+
+    // Compressed parts are held in memory and the codec is chosen again for each of them
+    constexpr uint64_t COMPRESSED_PART_SIZE = 8 * 1024 * 1024;
+
     /**
-     * @brief RAII wrapper for WinINet handles
+     * @brief Write the whole buffer to the request, throttled by the limiter if any
      */
-    class InternetHandle {
-    public:
-        InternetHandle() = default;
-        
-        explicit InternetHandle(HINTERNET handle) noexcept : handle_(handle) {}
-        
-        ~InternetHandle() noexcept {
-            if (handle_) {
-                InternetCloseHandle(handle_);
-            }
-        }
-
-        // Non-copyable, movable
-        InternetHandle(const InternetHandle&) = delete;
-        InternetHandle& operator=(const InternetHandle&) = delete;
-        
-        InternetHandle(InternetHandle&& other) noexcept : handle_(other.handle_) {
-            other.handle_ = nullptr;
-        }
-        
-        InternetHandle& operator=(InternetHandle&& other) noexcept {
-            if (this != &other) {
-                if (handle_) {
-                    InternetCloseHandle(handle_);
-                }
-                handle_ = other.handle_;
-                other.handle_ = nullptr;
+    bool WriteToRequest(HttpConnection& connection, const char* data, size_t size, RateLimiter* limiter,
+                        const CancellationToken& token, std::string& error_message) noexcept {
+        while (size > 0) {
+            if (token.IsCancelled()) {
+                error_message = "Upload cancelled";
+                return false;
+            }
+
+            const size_t chunk = limiter ? std::min(size, RateLimiter::kChunkSize) : size;
+            if (limiter) {
+                limiter->Acquire(chunk);
             }
-            return *this;
+
+            const auto started = std::chrono::steady_clock::now();
+            if (!connection.Write(data, chunk, error_message)) {
+                return false;
+            }
+
+            // Write latency grows with the uplink queue and serves as the RTT signal
+            if (limiter) {
+                limiter->ReportLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - started));
+            }
+
+            data += chunk;
+            size -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Send a file segment without copying it through user space, throttled by the limiter if any
+     * @param checksum Continued with the bytes of the segment
+     */
+    bool SendFileToRequest(HttpConnection& connection, const BodySegment& segment, RateLimiter* limiter,
+                           const CancellationToken& token, uint32_t& checksum, std::string& error_message) noexcept {
+        FileHandle file;
+        if (FileSystem::OpenRead(segment.path, FileSystem::Access::Sequential, file) != FileSystem::OpenResult::Ok) {
+            error_message = "Failed to open file: " + TextUtils::WideToUtf8(segment.path);
+            return false;
         }
 
-        [[nodiscard]]
-        HINTERNET get() const noexcept {
-            return handle_;
+        // The checksum reads each chunk from the page cache it was just sent from, not from the disk
+        MappedFile mapping;
+        std::string mapping_error;
+        if (!mapping.Open(segment.path, mapping_error) || mapping.size() < segment.offset + segment.size) {
+            error_message = "Failed to map file for its checksum: " + TextUtils::WideToUtf8(segment.path);
+            return false;
         }
 
-        [[nodiscard]]
-        explicit operator bool() const noexcept {
-            return handle_ != nullptr;
+        uint64_t offset = segment.offset;
+        uint64_t size = segment.size;
+        while (size > 0) {
+            if (token.IsCancelled()) {
+                error_message = "Upload cancelled";
+                return false;
+            }
+
+            const uint64_t chunk = std::min<uint64_t>(size, limiter ? RateLimiter::kChunkSize : ZERO_COPY_CHUNK);
+            if (limiter) {
+                limiter->Acquire(static_cast<size_t>(chunk));
+            }
+
+            const auto started = std::chrono::steady_clock::now();
+            if (!connection.SendFileRange(file, offset, chunk, error_message)) {
+                return false;
+            }
+            checksum = Crc32c::Update(checksum, mapping.data() + offset, static_cast<size_t>(chunk));
+
+            if (limiter) {
+                limiter->ReportLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - started));
+            }
+
+            offset += chunk;
+            size -= chunk;
         }
+        return true;
+    }
 
-    private:
-        HINTERNET handle_ = nullptr;
+    /**
+     * @brief Everything a request needs besides its path and body
+     */
+    struct RequestContext {
+        const CrashReportData& data;
+        const Endpoint& endpoint;
+        RateLimiter* limiter;
+        const CancellationToken& token;
     };
+
+    /**
+     * @brief Per-phase timeouts of a request, clamped to the overall deadline
+     */
+    TransportTimeouts RequestTimeouts(const CrashReportData& data, const CancellationToken& token) noexcept {
+        const auto clamp = [&](uint32_t timeout_ms) {
+            return static_cast<uint32_t>(std::max<int64_t>(token.Clamp(std::chrono::milliseconds(timeout_ms)).count(), 1));
+        };
+        return TransportTimeouts{ clamp(data.connect_timeout_ms), clamp(data.send_timeout_ms), clamp(data.receive_timeout_ms) };
+    }
+
+    /**
+     * @brief POST a body on an open connection and collect the response
+     * @param file_checksum Set to the CRC32C of the file bytes of a body with a single file, may be nullptr
+     * @return true if the request completed, regardless of the HTTP status
+     */
+    bool PerformRequest(HttpConnection& connection, const RequestContext& context, const std::wstring& path, std::string_view headers,
+                        const MultipartBody& body, ReadAheadPipeline& pipeline,
+                        HttpResponse& response, std::string& error_message, uint32_t* file_checksum = nullptr) noexcept {
+        const CancellationToken& token = context.token;
+        RateLimiter* limiter = context.limiter;
+
+        try {
+            if (token.IsCancelled()) {
+                error_message = "Request cancelled";
+                return false;
+            }
+
+            // Calculate total content length
+            const uint64_t total_length = body.TotalSize();
+            Logger::LogDebug(L"Creating HTTP POST request to: " + path);
+            Logger::LogDebug("Total upload size: " + std::to_string(total_length) + " bytes");
+
+            if (!connection.BeginRequest("POST", path, headers, total_length, RequestTimeouts(context.data, token), error_message)) {
+                return false;
+            }
+            StartupProfile::Mark(StartupProfile::Stage::FirstByte);
+
+            // The report is on its way, the log lines held back during startup can go to disk now
+            Logger::Flush();
+
+            // Checksums of the files are computed on the way out, checksum segments send them after the files
+            std::map<std::pair<std::wstring_view, uint64_t>, uint32_t> checksums;
+            uint32_t* checksum = nullptr;
+
+            // Send data, attachments are streamed through the read-ahead pipeline
+            uint64_t bytes_sent = 0;
+            const auto sink = [&](const char* chunk, size_t size, std::string& sink_error) {
+                if (checksum) {
+                    *checksum = Crc32c::Update(*checksum, chunk, size);
+                }
+                if (!WriteToRequest(connection, chunk, size, limiter, token, sink_error)) {
+                    return false;
+                }
+                bytes_sent += size;
+                return true;
+            };
+
+            // Only headers go through user space when the transport can send files directly
+            const bool zero_copy = context.data.zero_copy && connection.CanSendFile();
+            const auto started = std::chrono::steady_clock::now();
+
+            pipeline.SetCancellation(&token);
+            pipeline.SetUnbufferedThreshold(context.data.unbuffered_threshold);
+            bool streamed = false;
+            for (const auto& segment : body.Segments()) {
+                bool sent = false;
+                checksum = nullptr;
+                if (segment.kind == BodySegment::Kind::Memory) {
+                    sent = sink(segment.bytes.data(), segment.bytes.size(), error_message);
+                } else if (segment.kind == BodySegment::Kind::Checksum) {
+                    const std::string hex = Crc32c::ToHex(checksums[{ segment.path, segment.offset }]);
+                    sent = sink(hex.data(), hex.size(), error_message);
+                } else if (zero_copy && !pipeline.BypassesCache(segment.path)) {
+                    // Sending from the page cache would pull a large file into it, those take the pipeline
+                    sent = SendFileToRequest(connection, segment, limiter, token, checksums[{ segment.path, segment.offset }], error_message);
+                    bytes_sent += sent ? segment.size : 0;
+                } else {
+                    checksum = &checksums[{ segment.path, segment.offset }];
+                    sent = pipeline.Stream(segment.path, segment.offset, segment.size, sink, error_message);
+                    streamed = true;
+                }
+                if (!sent) {
+                    return false;
+                }
+            }
+            if (file_checksum) {
+                *file_checksum = checksums.size() == 1 ? checksums.begin()->second : 0;
+            }
+
+            const auto elapsed_ms = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started).count(), 1);
+            Logger::LogDebug("Body sent in " + std::to_string(elapsed_ms) + " ms (" +
+                             std::to_string(bytes_sent / 1024 * 1000 / static_cast<uint64_t>(elapsed_ms) / 1024) + " MB/s" +
+                             (zero_copy && !streamed ? ", zero-copy)" : ", buffered)"));
+
+            // Complete the request
+            Logger::LogDebug("Finalizing HTTP request: body=" + std::to_string(bytes_sent));
+            if (!connection.EndRequest(response, token, error_message)) {
+                return false;
+            }
+
+            Logger::LogDebug("Server responded with status: " + std::to_string(response.status_code));
+            return true;
+        }
+        catch (const std::exception& e) {
+            error_message = "Exception during HTTP request: " + std::string(e.what());
+            return false;
+        }
+        catch (...) {
+            error_message = "Unknown exception during HTTP request";
+            return false;
+        }
+    }
+
+    /**
+     * @brief Percent-encode a UTF-8 value for use in a query string
+     */
+    std::wstring EncodeQueryValue(std::string_view value) {
+        constexpr wchar_t hex[] = L"0123456789ABCDEF";
+
+        std::wstring encoded;
+        encoded.reserve(value.size());
+        for (const unsigned char c : value) {
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                c == '-' || c == '_' || c == '.' || c == '~') {
+                encoded += static_cast<wchar_t>(c);
+            }
+            else {
+                encoded += L'%';
+                encoded += hex[c >> 4];
+                encoded += hex[c & 0x0F];
+            }
+        }
+        return encoded;
+    }
+
+    std::wstring EncodeQueryValue(std::wstring_view value) {
+        return EncodeQueryValue(std::string_view(TextUtils::WideToUtf8(value)));
+    }
+
+    /**
+     * @brief Append query parameters to a server path
+     */
+    std::wstring WithQuery(const std::wstring& path, std::wstring_view query) {
+        return path + (path.find(L'?') == std::wstring::npos ? L"?" : L"&") + std::wstring(query);
+    }
+
+    uint64_t ElapsedUs(std::chrono::steady_clock::time_point started) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count());
+    }
+
+    uint64_t ElapsedMs(std::chrono::steady_clock::time_point started) {
+        return ElapsedUs(started) / 1000;
+    }
+
+    /**
+     * @brief Byte range of one attachment uploaded as a separate request
+     */
+    struct PartJob {
+        const Attachment* attachment = nullptr;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t checksum = 0;  ///< CRC32C of the range, known once it was sent
+    };
+
 } // anonymous namespace
 
-bool HttpClient::SendCrashReport(const CrashReportData& data, std::string& error_message) noexcept {
+bool HttpClient::SendCrashReport(const CrashReportData& data, const CancellationToken& token, bool& retryable,
+                                 std::string& error_message) noexcept {
+    // Connections live as long as this report
+    ConnectionPool pool;
+    return SendCrashReport(data, token, pool, retryable, error_message);
+}
+
+bool HttpClient::SendCrashReport(const CrashReportData& data, const CancellationToken& token, ConnectionPool& pool,
+                                 bool& retryable, std::string& error_message) noexcept {
+    retryable = true;
     try {
-        Logger::LogInfo(L"Attempting to send crash report to " + data.full_url);
-        
-        // Initialize WinINet
-        InternetHandle internet(InternetOpenW(L"L2CrashSender/1.0", INTERNET_OPEN_TYPE_DIRECT, nullptr, nullptr, 0));
-        if (!internet) {
-            error_message = "Failed to initialize WinINet";
+        if (data.endpoints.empty()) {
+            error_message = "No valid server endpoint";
+            retryable = false;
             return false;
         }
 
-        // Connect to server
-        Logger::LogDebug(L"Connecting to server: " + data.full_url);
-        InternetHandle connect(InternetConnectW(internet.get(), data.full_url.c_str(),
-                                               INTERNET_DEFAULT_HTTP_PORT, nullptr, nullptr,
-                                               INTERNET_SERVICE_HTTP, 0, 0));
-        if (!connect) {
-            error_message = "Failed to connect to server: " + TextUtils::WideToUtf8(data.full_url);
+        // One bucket for all connections so the cap applies to the whole report
+        std::unique_ptr<RateLimiter> limiter;
+        if (data.rate_limit > 0 || data.adaptive_rate) {
+            limiter = std::make_unique<RateLimiter>(data.rate_limit, data.adaptive_rate);
+            Logger::LogDebug("Upload rate limited to " + std::to_string(limiter->CurrentRate() / 1024) + " KB/s" +
+                             (limiter->IsAdaptive() ? " (adaptive)" : ""));
+        }
+
+        // Fail over to the next endpoint until one accepts the report
+        EndpointSelector selector;
+        for (const auto& endpoint : selector.Order(data.endpoints, token)) {
+            if (token.IsCancelled()) {
+                break;
+            }
+
+            Logger::LogInfo(L"Attempting to send crash report to " + endpoint.ToString());
+
+            const bool sent = data.parallel_uploads > 1 || data.compress
+                ? SendPartedReport(data, endpoint, pool, limiter.get(), token, retryable, error_message)
+                : SendSingleReport(data, endpoint, pool, limiter.get(), token, retryable, error_message);
+            if (sent) {
+                EndpointSelector::Remember(endpoint);
+                return true;
+            }
+
+            Logger::LogError(L"Endpoint " + endpoint.ToString() + L" failed: " + TextUtils::Utf8ToWide(error_message));
+            if (!retryable) {
+                return false;
+            }
+        }
+
+        if (token.IsCancelled()) {
+            error_message = "Upload cancelled: " + error_message;
+        }
+        return false;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception during HTTP request: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception during HTTP request";
+        return false;
+    }
+}
+
+bool HttpClient::SendOccurrences(const CrashReportData& data, uint32_t count, const CancellationToken& token,
+                                 std::string& error_message) noexcept {
+    try {
+        MultipartBody form_data;
+        AddFieldToMultipartData("CRVersion", data.version, form_data);
+        AddFieldToMultipartData("signature", data.signature, form_data);
+        form_data.AppendString(CRLF);
+        form_data.AppendString(BOUNDARY);
+        form_data.AppendString("--");
+
+        const std::wstring query = L"action=occurrences&signature=" + EncodeQueryValue(data.signature) +
+                                   L"&count=" + std::to_wstring(count);
+
+        ConnectionPool pool;
+        EndpointSelector selector;
+        for (const auto& endpoint : selector.Order(data.endpoints, token)) {
+            if (token.IsCancelled()) {
+                error_message = "Upload cancelled";
+                return false;
+            }
+
+            const auto connection = pool.Acquire(endpoint, RequestTimeouts(data, token), error_message);
+            if (!connection) {
+                continue;
+            }
+
+            const RequestContext context{ data, endpoint, nullptr, token };
+            ReadAheadPipeline pipeline;
+            HttpResponse response;
+            if (!PerformRequest(*connection, context, WithQuery(endpoint.path, query), MULTIPART_HEADERS,
+                                form_data, pipeline, response, error_message)) {
+                continue;
+            }
+
+            if (response.IsSuccess()) {
+                Logger::LogInfo("Reported " + std::to_string(count) + " more occurrences of crash " + data.signature);
+                return true;
+            }
+
+            error_message = "Server rejected occurrence count (" + response.Describe() + ")";
+            if (response.status_code < 500) {
+                return false;
+            }
+        }
+        return false;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception during HTTP request: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception during HTTP request";
+        return false;
+    }
+}
+
+bool HttpClient::ProbeEndpoint(const Endpoint& endpoint, std::chrono::milliseconds timeout, const CancellationToken& token,
+                               std::chrono::milliseconds& latency) noexcept {
+    try {
+        const auto started = std::chrono::steady_clock::now();
+
+        std::string error_message;
+        const auto transport = HttpTransport::Create(error_message);
+        if (!transport) {
             return false;
         }
 
-        // Create HTTP request
-        Logger::LogDebug(L"Creating HTTP POST request to: " + data.server_path);
-        InternetHandle request(HttpOpenRequestW(connect.get(), L"POST", data.server_path.c_str(),
-                                               L"HTTP/1.1", nullptr, nullptr,
-                                               INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD, 0));
-        if (!request) {
-            error_message = "Failed to create HTTP request";
+        const auto timeout_ms = static_cast<uint32_t>(std::max<int64_t>(timeout.count(), 1));
+        const TransportTimeouts timeouts{ timeout_ms, timeout_ms, timeout_ms };
+        const auto connection = transport->Connect(endpoint, timeouts, error_message);
+        if (!connection) {
             return false;
         }
 
-        // Set HTTP headers
-        const std::wstring headers = 
-            L"Content-Type: multipart/form-data; boundary=MULTIPART-DATA-BOUNDARY\r\n"
-            L"Content-Transfer-Encoding: binary\r\n";
+        // Any HTTP status proves the endpoint is alive, HEAD keeps it cheap
+        HttpResponse response;
+        if (!connection->BeginRequest("HEAD", endpoint.path, {}, 0, timeouts, error_message) ||
+            !connection->EndRequest(response, token, error_message)) {
+            return false;
+        }
+
+        latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        return response.status_code < 500;
+    }
+    catch (...) {
+        return false;
+    }
+}
 
-        if (!HttpAddRequestHeadersW(request.get(), headers.c_str(), 
-                                   static_cast<DWORD>(-1), 
-                                   HTTP_ADDREQ_FLAG_ADD | HTTP_ADDREQ_FLAG_REPLACE)) {
-            error_message = "Failed to add HTTP headers";
+bool HttpClient::SendSingleReport(const CrashReportData& data, const Endpoint& endpoint, ConnectionPool& pool, RateLimiter* limiter,
+                                  const CancellationToken& token, bool& retryable, std::string& error_message) noexcept {
+    try {
+        const RequestContext context{ data, endpoint, limiter, token };
+
+        // Connect to server
+        Logger::LogDebug(L"Connecting to server: " + endpoint.host);
+        const auto connection = pool.Acquire(endpoint, RequestTimeouts(data, token), error_message);
+        if (!connection) {
             return false;
         }
+        StartupProfile::Mark(StartupProfile::Stage::Connect);
 
         // Prepare multipart form data
-        std::vector<char> form_data;
+        MultipartBody form_data;
         if (!CreateMultipartFormData(data, form_data, error_message)) {
+            retryable = false;
+            return false;
+        }
+        StartupProfile::Mark(StartupProfile::Stage::Body);
+
+        Logger::LogDebug("Uploading crash report data");
+        ReadAheadPipeline pipeline;
+        HttpResponse response;
+        if (!PerformRequest(*connection, context, endpoint.path, MULTIPART_HEADERS, form_data, pipeline, response, error_message)) {
+            return false;
+        }
+
+        // Check for success status (2xx), only server errors are worth another endpoint
+        if (!response.IsSuccess()) {
+            error_message = "Server rejected crash report (" + response.Describe() + ")";
+            retryable = response.status_code >= 500;
             return false;
         }
 
-        // Calculate total content length
-        const auto total_length = static_cast<DWORD>(form_data.size());
-        Logger::LogDebug("Total upload size: " + std::to_string(total_length) + " bytes");
+        Logger::LogInfo("Crash report sent successfully");
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception during HTTP request: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception during HTTP request";
+        return false;
+    }
+}
 
-        // Prepare request
-        INTERNET_BUFFERSW buffers{};
-        buffers.dwStructSize = sizeof(INTERNET_BUFFERSW);
-        buffers.dwBufferTotal = total_length;
+bool HttpClient::SendPartedReport(const CrashReportData& data, const Endpoint& endpoint, ConnectionPool& pool, RateLimiter* limiter,
+                                  const CancellationToken& token, bool& retryable, std::string& error_message) noexcept {
+    try {
+        const RequestContext context{ data, endpoint, limiter, token };
 
-        if (!HttpSendRequestExW(request.get(), &buffers, nullptr, 0, 0)) {
-            error_message = "Failed to prepare HTTP request";
+        std::vector<Attachment> attachments;
+        if (!CollectAttachments(data, attachments, error_message)) {
+            retryable = false;
             return false;
         }
 
-        // Send data
-        Logger::LogDebug("Uploading crash report data");
-        DWORD bytes_written = 0;
-        
-        // Send form header
-        if (!InternetWriteFile(request.get(), form_data.data(), static_cast<DWORD>(form_data.size()), &bytes_written)) {
-            error_message = "Failed to upload form data";
+        // The pool is shared by all upload threads
+        Logger::LogDebug(L"Connecting to server: " + endpoint.host);
+        const auto connection = pool.Acquire(endpoint, RequestTimeouts(data, token), error_message);
+        if (!connection) {
+            return false;
+        }
+        StartupProfile::Mark(StartupProfile::Stage::Connect);
+
+        // Create the report with a small metadata request
+        MultipartBody metadata;
+        if (!CreateMetadataFormData(data, attachments, metadata, error_message)) {
+            return false;
+        }
+        StartupProfile::Mark(StartupProfile::Stage::Body);
+
+        ReadAheadPipeline pipeline;
+        HttpResponse response;
+        if (!PerformRequest(*connection, context, WithQuery(endpoint.path, L"action=create"), MULTIPART_HEADERS,
+                            metadata, pipeline, response, error_message)) {
             return false;
         }
 
-        // Complete the request
-        Logger::LogDebug("Finalizing HTTP request: body=" + std::to_string(bytes_written));
-        if (!HttpEndRequestW(request.get(), nullptr, 0, 0)) {
-            error_message = "Failed to finalize HTTP request";
+        if (!response.IsSuccess()) {
+            error_message = "Server rejected crash report metadata (" + response.Describe() + ")";
+            retryable = response.status_code >= 500;
             return false;
         }
 
-        // Check HTTP status code
-        DWORD status_code = 0;
-        DWORD status_size = sizeof(status_code);
-        if (!HttpQueryInfoW(request.get(), HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
-                           &status_code, &status_size, nullptr)) {
-            error_message = "Failed to query HTTP status";
+        const auto id_begin = response.body.find_first_not_of(" \t\r\n");
+        const auto id_end = response.body.find_last_not_of(" \t\r\n");
+        if (id_begin == std::string::npos) {
+            error_message = "Server did not return a report id";
             return false;
         }
 
-        Logger::LogDebug("Server responded with status: " + std::to_string(status_code));
+        const std::string report_id = response.body.substr(id_begin, id_end - id_begin + 1);
+        const std::wstring encoded_id = EncodeQueryValue(report_id);
+        Logger::LogDebug("Report id: " + report_id);
+
+        // Split attachments into independent byte ranges
+        const bool compress = data.compress && Compressor::IsAvailable();
+        const uint64_t part_size = std::max<uint64_t>(compress ? std::min(data.part_size, COMPRESSED_PART_SIZE) : data.part_size, 1);
+        std::vector<PartJob> jobs;
+        for (const auto& attachment : attachments) {
+            uint64_t offset = 0;
+            do {
+                const uint64_t size = std::min(part_size, attachment.size - offset);
+                jobs.push_back(PartJob{ &attachment, offset, size });
+                offset += size;
+            } while (offset < attachment.size);
+        }
+
+        const size_t worker_count = std::min(data.parallel_uploads, jobs.size());
+        Logger::LogDebug("Uploading " + std::to_string(jobs.size()) + " parts over " +
+                         std::to_string(worker_count) + " connections");
+
+        // Compression reads the attachments through mappings, the dump start is the sample for the codec choice
+        CompressionPlanner planner;
+        std::vector<MappedFile> mappings(compress ? attachments.size() : 0);
+        std::atomic<uint64_t> remaining_bytes{ 0 };
+        std::atomic<uint64_t> wire_bytes{ 0 };
+        std::atomic<uint64_t> compress_us{ 0 };
+        std::atomic<uint64_t> send_us{ 0 };
+        const auto upload_started = std::chrono::steady_clock::now();
+        if (compress) {
+            for (size_t i = 0; i < attachments.size(); ++i) {
+                std::string mapping_error;
+                remaining_bytes += attachments[i].size;
+                if (attachments[i].size > 0 && !mappings[i].Open(attachments[i].path, mapping_error)) {
+                    // Sent uncompressed
+                    Logger::LogError(mapping_error);
+                }
+            }
+            if (!mappings.empty() && mappings.front().data()) {
+                planner.Sample(mappings.front().data() + attachments.front().offset,
+                               static_cast<size_t>(std::min<uint64_t>(attachments.front().size, CompressionPlanner::kSampleSize)));
+            }
+            Logger::LogInfo("Compression sampled in " + std::to_string(ElapsedMs(upload_started)) + " ms: " + planner.Describe());
+        }
+
+        std::atomic<size_t> next_job{ 0 };
+        std::atomic<bool> failed{ false };
+        std::mutex error_mutex;
+        std::string first_error;
+
+        const auto record_error = [&](const std::string& message) {
+            std::lock_guard lock(error_mutex);
+            if (first_error.empty()) {
+                first_error = message;
+            }
+            failed = true;
+        };
+
+        // Every worker owns its connection and read-ahead buffers
+        const auto worker = [&]() noexcept {
+            try {
+                std::string connect_error;
+                const auto worker_connection = pool.Acquire(endpoint, RequestTimeouts(data, token), connect_error);
+                if (!worker_connection) {
+                    record_error(connect_error);
+                    return;
+                }
+
+                ReadAheadPipeline worker_pipeline;
+                std::vector<char> compressed;
+                for (size_t index = next_job++; index < jobs.size() && !failed; index = next_job++) {
+                    PartJob& job = jobs[index];
+
+                    const std::wstring path = WithQuery(endpoint.path,
+                        L"action=part&report=" + encoded_id +
+                        L"&name=" + EncodeQueryValue(job.attachment->name) +
+                        L"&filename=" + EncodeQueryValue(job.attachment->filename) +
+                        L"&offset=" + std::to_wstring(job.offset) +
+                        L"&size=" + std::to_wstring(job.size) +
+                        L"&total=" + std::to_wstring(job.attachment->size));
+
+                    const MappedFile* mapping = compress ? &mappings[job.attachment - attachments.data()] : nullptr;
+                    const CompressionSetting setting = mapping && mapping->data()
+                        ? planner.Choose(remaining_bytes.load()) : CompressionSetting{};
+
+                    std::string part_error;
+                    MultipartBody part;
+                    std::string headers(PART_HEADERS);
+                    uint64_t part_compress_us = 0;
+                    if (setting.codec == CompressionSetting::Codec::Identity) {
+                        part.AppendFile(job.attachment->path, job.attachment->offset + job.offset, job.size);
+                    } else {
+                        // Checksums cover the uncompressed bytes, the server verifies them after decoding
+                        const char* raw = mapping->data() + job.attachment->offset + job.offset;
+                        const auto compress_started = std::chrono::steady_clock::now();
+                        if (!Compressor::Compress(setting, raw, static_cast<size_t>(job.size), compressed, part_error)) {
+                            record_error(part_error);
+                            return;
+                        }
+                        part_compress_us = ElapsedUs(compress_started);
+                        planner.RecordCompression(setting, job.size, compressed.size(), part_compress_us / 1e6);
+                        job.checksum = Crc32c::Update(0, raw, static_cast<size_t>(job.size));
+
+                        // Sent straight from the compression buffer, which outlives the request
+                        part.AppendExternal(std::string_view(compressed.data(), compressed.size()));
+                        headers += setting.EncodingHeader();
+                    }
+
+                    const auto send_started = std::chrono::steady_clock::now();
+                    HttpResponse part_response;
+                    if (!PerformRequest(*worker_connection, context, path, headers, part, worker_pipeline, part_response, part_error,
+                                        setting.codec == CompressionSetting::Codec::Identity ? &job.checksum : nullptr)) {
+                        record_error(part_error);
+                        return;
+                    }
+                    if (!part_response.IsSuccess()) {
+                        record_error("Server rejected report part (" + part_response.Describe() + ")");
+                        return;
+                    }
+
+                    if (compress) {
+                        const uint64_t part_send_us = ElapsedUs(send_started);
+                        planner.RecordSend(part.TotalSize(), part_send_us / 1e6);
+                        remaining_bytes -= job.size;
+                        wire_bytes += part.TotalSize();
+                        compress_us += part_compress_us;
+                        send_us += part_send_us;
+                        Logger::LogDebug("Part " + job.attachment->name + "@" + std::to_string(job.offset) + ": " + setting.Name() +
+                                         ", " + std::to_string(job.size) + " -> " + std::to_string(part.TotalSize()) +
+                                         " bytes, compressed in " + std::to_string(part_compress_us / 1000) +
+                                         " ms, sent in " + std::to_string(part_send_us / 1000) + " ms");
+                    }
+                }
+            }
+            catch (...) {
+                record_error("Unknown exception during part upload");
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < worker_count; ++i) {
+            try {
+                threads.emplace_back(worker);
+            }
+            catch (...) {
+                // Continue with the workers that did start
+                break;
+            }
+        }
+
+        if (threads.empty()) {
+            worker();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
 
-        // Read response body
-        std::string response_body;
-        char buffer[4096] = {};
-        DWORD bytes_read = 0;
-        while (InternetReadFile(request.get(), buffer, sizeof(buffer), &bytes_read) && bytes_read > 0) {
-            response_body.append(buffer, bytes_read);
+        if (failed) {
+            error_message = first_error;
+            return false;
         }
 
-        // Check for success status (2xx)
-        if (status_code < 200 || status_code >= 300) {
-            error_message = "Server rejected crash report (HTTP " + std::to_string(status_code) + ")";
-            if (!response_body.empty()) {
-                error_message += ": " + response_body;
+        if (compress) {
+            uint64_t raw_bytes = 0;
+            for (const auto& attachment : attachments) {
+                raw_bytes += attachment.size;
             }
+            Logger::LogInfo("Compressed upload of " + std::to_string(raw_bytes / 1024) + " KB as " +
+                            std::to_string(wire_bytes / 1024) + " KB in " + std::to_string(ElapsedMs(upload_started)) +
+                            " ms, compression " + std::to_string(compress_us / 1000) + " ms, sending " +
+                            std::to_string(send_us / 1000) + " ms over " + std::to_string(worker_count) +
+                            " connections (" + planner.Describe() + ")");
+        }
+
+        // Let the server stitch the parts together, one "name<TAB>offset<TAB>size<TAB>crc32c" line per part to verify them
+        std::string part_checksums;
+        for (const auto& job : jobs) {
+            part_checksums += job.attachment->name + "\t" + std::to_string(job.offset) + "\t" + std::to_string(job.size) +
+                              "\t" + Crc32c::ToHex(job.checksum) + "\n";
+        }
+
+        MultipartBody completion;
+        AddFieldToMultipartData("checksums", part_checksums, completion);
+        completion.AppendString(CRLF);
+        completion.AppendString(BOUNDARY);
+        completion.AppendString("--");
+
+        if (!PerformRequest(*connection, context,
+                            WithQuery(endpoint.path, L"action=complete&report=" + encoded_id +
+                                                     L"&parts=" + std::to_wstring(jobs.size())),
+                            MULTIPART_HEADERS, completion, pipeline, response, error_message)) {
+            return false;
+        }
+
+        if (!response.IsSuccess()) {
+            error_message = "Server failed to complete crash report (" + response.Describe() + ")";
             return false;
         }
 
@@ -177,102 +750,229 @@ bool HttpClient::SendCrashReport(const CrashReportData& data, std::string& error
         return true;
     }
     catch (const std::exception& e) {
-        error_message = "Exception during HTTP request: " + std::string(e.what());
+        error_message = "Exception during parted upload: " + std::string(e.what());
         return false;
     }
     catch (...) {
-        error_message = "Unknown exception during HTTP request";
+        error_message = "Unknown exception during parted upload";
+        return false;
+    }
+}
+
+bool HttpClient::CollectAttachments(const CrashReportData& data, std::vector<Attachment>& attachments, std::string& error_message) noexcept {
+    try {
+        attachments.clear();
+
+        // Files of a packed report are ranges of the archive
+        if (!data.archive_path.empty()) {
+            ReportArchive archive;
+            if (!archive.Open(data.archive_path, error_message)) {
+                return false;
+            }
+            for (const auto& entry : archive.Entries()) {
+                if (!entry.IsFile()) {
+                    continue;
+                }
+                if (entry.codec != ArchiveEntry::Codec::Identity) {
+                    Logger::LogError("Skipping encoded archive entry " + entry.name);
+                    continue;
+                }
+                attachments.push_back(Attachment{ entry.name, entry.filename, data.archive_path, entry.offset, entry.size });
+            }
+            if (!archive.Find("dumpfile")) {
+                error_message = "Report archive has no dump";
+                return false;
+            }
+            return true;
+        }
+
+        attachments.reserve(3);
+        Attachment attachment;
+        if (!data.dump_path.empty()) {
+            if (!ProbeAttachment("dumpfile", data.dump_path, attachment, error_message)) {
+                return false;
+            }
+            attachments.push_back(std::move(attachment));
+        }
+
+        if (!data.game_log_path.empty()) {
+            if (ProbeAttachment("gamelog", data.game_log_path, attachment, error_message)) {
+                attachments.push_back(std::move(attachment));
+            } else {
+                // Not-crtitical failure
+                Logger::LogError(error_message);
+                error_message = "";
+            }
+        }
+
+        if (!data.network_log_path.empty()) {
+            if (ProbeAttachment("networklog", data.network_log_path, attachment, error_message)) {
+                attachments.push_back(std::move(attachment));
+            } else {
+                // Not-crtitical failure
+                Logger::LogError(error_message);
+                error_message = "";
+            }
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Failed to collect attachments: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while collecting attachments";
         return false;
     }
 }
 
-bool HttpClient::CreateMultipartFormData(const CrashReportData& data, std::vector<char>& output, std::string& error_message) noexcept {
+bool HttpClient::CreateMultipartFormData(const CrashReportData& data, MultipartBody& output, std::string& error_message) noexcept {
     try {
-        output.clear();
-
-        // Add version field
-        TextUtils::AppendString(output, BOUNDARY);
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, "Content-Disposition: form-data; name=\"CRVersion\"");
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, data.version);
-        TextUtils::AppendString(output, CRLF);
-
-        // Add error field
-        TextUtils::AppendString(output, BOUNDARY);
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, "Content-Disposition: form-data; name=\"error\"");
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, CRLF);
-        TextUtils::AppendString(output, data.error);
-        TextUtils::AppendString(output, CRLF);
-
-        if (!data.dump_path.empty() && !AddFileToMultipartData("dumpfile", data.dump_path, output, error_message)) {
+        output.Clear();
+
+        std::vector<Attachment> attachments;
+        if (!CollectAttachments(data, attachments, error_message)) {
             return false;
         }
 
-        if (!data.game_log_path.empty() && !AddFileToMultipartData("gamelog", data.game_log_path, output, error_message)) {
-            // Not-crtitical failure
-            Logger::LogError(error_message);
-            error_message = "";
+        // Headers of adjacent parts share a segment, every file adds its own and one for its checksum
+        output.Reserve(4 * attachments.size() + 2);
+
+        AddFieldToMultipartData("CRVersion", data.version, output);
+        AddFieldToMultipartData("error", data.error, output);
+        if (!data.signature.empty()) {
+            AddFieldToMultipartData("signature", data.signature, output);
         }
-        
-        if (!data.network_log_path.empty() && !AddFileToMultipartData("networklog", data.network_log_path, output, error_message)) {
-            // Not-crtitical failure
-            Logger::LogError(error_message);
-            error_message = "";
+
+        for (const auto& attachment : attachments) {
+            AddFileToMultipartData(attachment, output);
         }
+        AddChecksumsToMultipartData(attachments, output);
 
         // Create form footer
-        const std::string footer = std::string(CRLF) + std::string(BOUNDARY) + "--";
-        output.insert(output.end(), footer.begin(), footer.end());
+        output.AppendString(CRLF);
+        output.AppendString(BOUNDARY);
+        output.AppendString("--");
         return true;
     }
     catch (const std::exception& e) {
         error_message = "Failed to create multipart form data: " + std::string(e.what());
-        output.clear();
+        output.Clear();
         return false;
     }
     catch (...) {
         error_message = "Unknown exception while creating multipart form data";
-        output.clear();
+        output.Clear();
         return false;
     }
 }
 
-bool HttpClient::AddFileToMultipartData(std::string_view name, std::wstring_view filepath, std::vector<char>& output, std::string& error_message) noexcept {
-    Logger::LogDebug(L"Try to add multipart data file: " + std::wstring(filepath));
+bool HttpClient::CreateMetadataFormData(const CrashReportData& data, const std::vector<Attachment>& attachments, MultipartBody& output, std::string& error_message) noexcept {
+    try {
+        output.Clear();
 
-    // Add file field
-    TextUtils::AppendString(output, BOUNDARY);
-    TextUtils::AppendString(output, CRLF);
-    TextUtils::AppendString(output, "Content-Disposition: form-data; name=\"");
-    TextUtils::AppendString(output, name);
-    TextUtils::AppendString(output, "\"; filename=\"");
+        AddFieldToMultipartData("CRVersion", data.version, output);
+        AddFieldToMultipartData("error", data.error, output);
+        if (!data.signature.empty()) {
+            AddFieldToMultipartData("signature", data.signature, output);
+        }
 
-    try {
-        // Extract filename from path
-        const std::filesystem::path path(filepath);
-        const std::wstring filename = path.filename().wstring();
-        TextUtils::AppendString(output, filename);
+        // One "name<TAB>filename<TAB>size" line per attachment that will follow
+        std::string manifest;
+        for (const auto& attachment : attachments) {
+            manifest += attachment.name + "\t" + TextUtils::WideToUtf8(attachment.filename) + "\t" +
+                        std::to_string(attachment.size) + "\n";
+        }
+        AddFieldToMultipartData("parts", manifest, output);
+
+        // Create form footer
+        output.AppendString(CRLF);
+        output.AppendString(BOUNDARY);
+        output.AppendString("--");
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Failed to create metadata form data: " + std::string(e.what());
+        output.Clear();
+        return false;
     }
     catch (...) {
-        // Fallback: use the whole path as filename
-        TextUtils::AppendString(output, filepath);
+        error_message = "Unknown exception while creating metadata form data";
+        output.Clear();
+        return false;
     }
+}
 
-    TextUtils::AppendString(output, "\"");
-    TextUtils::AppendString(output, CRLF);
-    TextUtils::AppendString(output, "Content-Type: application/octet-stream");
-    TextUtils::AppendString(output, CRLF);
-    TextUtils::AppendString(output, CRLF);
+void HttpClient::AddFieldToMultipartData(std::string_view name, std::string_view value, MultipartBody& output) {
+    output.AppendString(BOUNDARY);
+    output.AppendString(CRLF);
+    output.AppendString("Content-Disposition: form-data; name=\"");
+    output.AppendString(name);
+    output.AppendString("\"");
+    output.AppendString(CRLF);
+    output.AppendString(CRLF);
+    output.AppendString(value);
+    output.AppendString(CRLF);
+}
+
+void HttpClient::AddFileToMultipartData(const Attachment& attachment, MultipartBody& output) {
+    // Add file field
+    output.AppendString(BOUNDARY);
+    output.AppendString(CRLF);
+    output.AppendString("Content-Disposition: form-data; name=\"");
+    output.AppendString(attachment.name);
+    output.AppendString("\"; filename=\"");
+    output.AppendString(attachment.filename);
+    output.AppendString("\"");
+    output.AppendString(CRLF);
+    output.AppendString("Content-Type: application/octet-stream");
+    output.AppendString(CRLF);
+    output.AppendString(CRLF);
+
+    output.AppendFile(attachment.path, attachment.offset, attachment.size);
+}
 
-    if (!FileUtils::AppendToBuffer(filepath, output, error_message)) {
+void HttpClient::AddChecksumsToMultipartData(const std::vector<Attachment>& attachments, MultipartBody& output) {
+    if (attachments.empty()) {
+        return;
+    }
+
+    // One "name<TAB>crc32c" line per attachment, the values are filled in as the files are sent
+    output.AppendString(BOUNDARY);
+    output.AppendString(CRLF);
+    output.AppendString("Content-Disposition: form-data; name=\"checksums\"");
+    output.AppendString(CRLF);
+    output.AppendString(CRLF);
+    for (const auto& attachment : attachments) {
+        output.AppendString(attachment.name);
+        output.AppendString("\t");
+        output.AppendChecksum(attachment.path, attachment.offset);
+        output.AppendString("\n");
+    }
+    // The CRLF of the footer ends the value
+}
+
+bool HttpClient::ProbeAttachment(std::string_view name, std::wstring_view filepath, Attachment& attachment, std::string& error_message) noexcept {
+    Logger::LogDebug(L"Try to add multipart data file: " + std::wstring(filepath));
+
+    try {
+        attachment.name = name;
+
+        // Extract filename from path, either separator works on Windows
+        const size_t separator = filepath.find_last_of(L"/\\");
+        attachment.filename = separator == std::wstring_view::npos ? filepath : filepath.substr(separator + 1);
+
+        // Resolve the file first so an unreadable attachment leaves no dangling part header
+        return FileUtils::ProbeReadableFile(filepath, attachment.path, attachment.size, error_message);
+    }
+    catch (const std::exception& e) {
+        error_message = "Failed to add multipart file: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while adding multipart file";
         return false;
     }
-    return true;
 }
 
 } // namespace CrashSender
-
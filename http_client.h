@@ -1,12 +1,19 @@
 #pragma once
 
 #include "crash_report_data.h"
-#include <vector>
+#include "endpoint.h"
+#include "multipart_body.h"
+#include <chrono>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace CrashSender {
 
+class RateLimiter;
+class CancellationToken;
+class ConnectionPool;
+
 /**
  * @brief HTTP client for sending crash reports
  */
@@ -15,14 +22,72 @@ public:
     /**
      * @brief Send a crash report to server
      * @param data Crash report data to send
+     * @param token Cancellation checked by every blocking loop
+     * @param retryable Set to false if sending the report again cannot succeed: rejected by the server or unreadable
      * @return true on success, error message on failure
      */
     [[nodiscard]]
-    static bool SendCrashReport(const CrashReportData& data, std::string& error_message) noexcept;
+    static bool SendCrashReport(const CrashReportData& data, const CancellationToken& token, bool& retryable,
+                                std::string& error_message) noexcept;
+
+    /**
+     * @brief Send a crash report over connections kept warm by a pool
+     * @param pool Pool shared by consecutive or concurrent reports
+     */
+    [[nodiscard]]
+    static bool SendCrashReport(const CrashReportData& data, const CancellationToken& token, ConnectionPool& pool,
+                                bool& retryable, std::string& error_message) noexcept;
+
+    /**
+     * @brief Report further occurrences of a crash that was already uploaded
+     * @param data Report carrying the signature of the uploaded crash
+     * @param count Occurrences not reported yet
+     * @return true if a server accepted the count
+     */
+    [[nodiscard]]
+    static bool SendOccurrences(const CrashReportData& data, uint32_t count, const CancellationToken& token,
+                                std::string& error_message) noexcept;
+
+    /**
+     * @brief Check that an endpoint answers HTTP requests
+     * @param endpoint Endpoint to probe
+     * @param timeout Upper bound for the probe
+     * @param token Stops the probe early once cancelled
+     * @param latency Time until the response status arrived
+     * @return true if the endpoint is reachable
+     */
+    [[nodiscard]]
+    static bool ProbeEndpoint(const Endpoint& endpoint, std::chrono::milliseconds timeout, const CancellationToken& token,
+                              std::chrono::milliseconds& latency) noexcept;
+
+    /**
+     * @brief Describe the single-request body of a report, attachments are referenced rather than read
+     * @param data Crash report data
+     * @param output Body segments in send order
+     * @param error_message Placeholder for error if it will occurs
+     */
+    [[nodiscard]]
+    static bool CreateMultipartFormData(const CrashReportData& data, MultipartBody& output, std::string& error_message) noexcept;
 
 private:
-    static bool CreateMultipartFormData(const CrashReportData& data, std::vector<char>& output, std::string& error_message) noexcept;
-    static bool AddFileToMultipartData(std::string_view name, std::wstring_view filename, std::vector<char>& output, std::string& error_message) noexcept;
+    /**
+     * @brief Send the whole report as one multipart POST
+     */
+    static bool SendSingleReport(const CrashReportData& data, const Endpoint& endpoint, ConnectionPool& pool, RateLimiter* limiter,
+                                 const CancellationToken& token, bool& retryable, std::string& error_message) noexcept;
+
+    /**
+     * @brief Create the report with a metadata request, then upload attachment parts in parallel
+     */
+    static bool SendPartedReport(const CrashReportData& data, const Endpoint& endpoint, ConnectionPool& pool, RateLimiter* limiter,
+                                 const CancellationToken& token, bool& retryable, std::string& error_message) noexcept;
+
+    static bool CollectAttachments(const CrashReportData& data, std::vector<Attachment>& attachments, std::string& error_message) noexcept;
+    static bool CreateMetadataFormData(const CrashReportData& data, const std::vector<Attachment>& attachments, MultipartBody& output, std::string& error_message) noexcept;
+    static void AddFieldToMultipartData(std::string_view name, std::string_view value, MultipartBody& output);
+    static void AddFileToMultipartData(const Attachment& attachment, MultipartBody& output);
+    static void AddChecksumsToMultipartData(const std::vector<Attachment>& attachments, MultipartBody& output);
+    static bool ProbeAttachment(std::string_view name, std::wstring_view filepath, Attachment& attachment, std::string& error_message) noexcept;
 };
 
 } // namespace CrashSender
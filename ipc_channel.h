@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "file_system.h"
+
+namespace CrashSender {
+
+/**
+ * @brief Local stream channel between processes of one user: named pipe on Windows, UNIX domain socket elsewhere
+ */
+class IpcServer {
+public:
+    enum class AcceptResult : int {
+        Accepted = 0,
+        Timeout = 1,
+        Failed = 2
+    };
+
+    explicit IpcServer(std::wstring_view name);
+    ~IpcServer();
+
+    // Non-copyable, non-movable
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+    IpcServer(IpcServer&&) = delete;
+    IpcServer& operator=(IpcServer&&) = delete;
+
+    /**
+     * @brief Claim the channel name
+     * @return false if another server owns it or the channel cannot be created
+     */
+    [[nodiscard]]
+    bool Listen(std::string& error_message) noexcept;
+
+    /**
+     * @brief Wait for the next client
+     * @param client Stream to the client on Accepted
+     */
+    [[nodiscard]]
+    AcceptResult Accept(std::chrono::milliseconds timeout, FileHandle& client) noexcept;
+
+private:
+    std::wstring name_;
+    FileHandle listener_;   ///< Listening socket, or the pipe instance waiting for a client
+#ifdef _WIN32
+    struct ConnectState;
+    std::unique_ptr<ConnectState> connect_; ///< Overlapped ConnectNamedPipe that survives an Accept timeout
+#else
+    std::string socket_path_;
+#endif
+};
+
+struct IpcChannel {
+    static constexpr size_t kMaxMessageSize = 64 * 1024;
+
+    /**
+     * @brief Connect to a running server
+     * @return false if no server listens on the name
+     */
+    [[nodiscard]]
+    static bool Connect(std::wstring_view name, FileHandle& stream) noexcept;
+
+    /**
+     * @brief Write the whole message
+     */
+    [[nodiscard]]
+    static bool Send(const FileHandle& stream, std::string_view message, std::chrono::milliseconds timeout) noexcept;
+
+    /**
+     * @brief Read until the message ends with the terminator, the terminator is kept
+     * @return false on timeout, disconnect or an oversized message
+     */
+    [[nodiscard]]
+    static bool Receive(const FileHandle& stream, std::string_view terminator, std::string& message,
+                        std::chrono::milliseconds timeout) noexcept;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "ipc_channel.h"
+
+namespace CrashSender {
+
+namespace {
+
+    /**
+     * @brief Directory holding the socket of a channel
+     *
+     * The runtime directory is private to the user. Without one the server
+     * creates a 0700 directory under /tmp, the socket itself never sits in a
+     * world-writable directory.
+     */
+    std::string SocketDirectory(std::wstring_view name) {
+        const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+        if (runtime_dir && *runtime_dir) {
+            return runtime_dir;
+        }
+        return "/tmp/" + TextUtils::WideToUtf8(name) + "-" + std::to_string(getuid());
+    }
+
+    std::string SocketPath(const std::string& directory, std::wstring_view name) {
+        return directory + "/" + TextUtils::WideToUtf8(name) + ".sock";
+    }
+
+    /**
+     * @brief True for a real directory owned by this user that nobody else can enter
+     */
+    bool IsPrivateDirectory(const std::string& directory) noexcept {
+        struct stat info{};
+        return lstat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == getuid() &&
+               (info.st_mode & (S_IRWXG | S_IRWXO)) == 0;
+    }
+
+    /**
+     * @brief True if the process at the other end runs as this user
+     */
+    bool IsSameUser(int fd) noexcept {
+#if defined(SO_PEERCRED)
+        ucred credentials{};
+        socklen_t length = sizeof(credentials);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == getuid();
+#else
+        uid_t uid = 0;
+        gid_t gid = 0;
+        return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+    }
+
+    bool MakeAddress(const std::string& path, sockaddr_un& address) noexcept {
+        address = sockaddr_un{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        std::copy(path.begin(), path.end(), address.sun_path);
+        return true;
+    }
+
+    bool ConnectTo(const std::string& path, FileHandle& stream) noexcept {
+        sockaddr_un address{};
+        if (!MakeAddress(path, address)) {
+            return false;
+        }
+
+        FileHandle socket_handle(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (!socket_handle || connect(socket_handle.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            return false;
+        }
+        // Report files are only handed to a server of the same user
+        if (!IsSameUser(socket_handle.get())) {
+            return false;
+        }
+        stream = std::move(socket_handle);
+        return true;
+    }
+
+    /**
+     * @brief Wait until the descriptor is ready or the deadline passes
+     */
+    bool WaitReady(int fd, short events, std::chrono::steady_clock::time_point deadline) noexcept {
+        for (;;) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                return false;
+            }
+
+            pollfd descriptor{ fd, events, 0 };
+            const int result = poll(&descriptor, 1, static_cast<int>(remaining));
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            return result == 1;
+        }
+    }
+
+} // anonymous namespace
+
+IpcServer::IpcServer(std::wstring_view name) : name_(name) {
+}
+
+IpcServer::~IpcServer() {
+    if (listener_ && !socket_path_.empty()) {
+        unlink(socket_path_.c_str());
+    }
+}
+
+bool IpcServer::Listen(std::string& error_message) noexcept {
+    try {
+        const std::string directory = SocketDirectory(name_);
+        if (mkdir(directory.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+            error_message = "Failed to create IPC directory: " + directory;
+            return false;
+        }
+        if (!IsPrivateDirectory(directory)) {
+            error_message = "IPC directory is not private to this user: " + directory;
+            return false;
+        }
+        socket_path_ = SocketPath(directory, name_);
+
+        sockaddr_un address{};
+        if (!MakeAddress(socket_path_, address)) {
+            error_message = "IPC socket path is too long: " + socket_path_;
+            return false;
+        }
+
+        FileHandle listener(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (!listener) {
+            error_message = "Failed to create IPC socket";
+            return false;
+        }
+
+        if (bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            if (errno != EADDRINUSE) {
+                error_message = "Failed to bind IPC socket: " + socket_path_;
+                return false;
+            }
+
+            // A socket file nobody listens on is left over from a crashed server
+            FileHandle probe;
+            if (ConnectTo(socket_path_, probe)) {
+                error_message = "Another sender daemon is already running";
+                return false;
+            }
+            unlink(socket_path_.c_str());
+            if (bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                error_message = "Failed to bind IPC socket: " + socket_path_;
+                return false;
+            }
+        }
+
+        if (listen(listener.get(), SOMAXCONN) != 0) {
+            error_message = "Failed to listen on IPC socket";
+            unlink(socket_path_.c_str());
+            return false;
+        }
+
+        listener_ = std::move(listener);
+        return true;
+    }
+    catch (...) {
+        error_message = "Unknown exception while creating IPC channel";
+        return false;
+    }
+}
+
+IpcServer::AcceptResult IpcServer::Accept(std::chrono::milliseconds timeout, FileHandle& client) noexcept {
+    if (!WaitReady(listener_.get(), POLLIN, std::chrono::steady_clock::now() + timeout)) {
+        return AcceptResult::Timeout;
+    }
+
+    FileHandle accepted(accept4(listener_.get(), nullptr, nullptr, SOCK_CLOEXEC));
+    if (!accepted) {
+        return errno == EINTR || errno == EAGAIN || errno == ECONNABORTED ? AcceptResult::Timeout : AcceptResult::Failed;
+    }
+
+    // The directory already keeps other users out, the peer check also covers a runtime directory shared by mistake
+    if (!IsSameUser(accepted.get())) {
+        return AcceptResult::Timeout;
+    }
+
+    client = std::move(accepted);
+    return AcceptResult::Accepted;
+}
+
+bool IpcChannel::Connect(std::wstring_view name, FileHandle& stream) noexcept {
+    try {
+        const std::string directory = SocketDirectory(name);
+        return IsPrivateDirectory(directory) && ConnectTo(SocketPath(directory, name), stream);
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool IpcChannel::Send(const FileHandle& stream, std::string_view message, std::chrono::milliseconds timeout) noexcept {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!message.empty()) {
+        if (!WaitReady(stream.get(), POLLOUT, deadline)) {
+            return false;
+        }
+
+        const ssize_t sent = send(stream.get(), message.data(), message.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        message.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+bool IpcChannel::Receive(const FileHandle& stream, std::string_view terminator, std::string& message,
+                         std::chrono::milliseconds timeout) noexcept {
+    try {
+        message.clear();
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        char buffer[4096];
+        while (message.size() < terminator.size() ||
+               std::string_view(message).substr(message.size() - terminator.size()) != terminator) {
+            if (message.size() >= kMaxMessageSize || !WaitReady(stream.get(), POLLIN, deadline)) {
+                return false;
+            }
+
+            // Byte-wise framing would be slow, the peer sends nothing after the terminator
+            const ssize_t received = recv(stream.get(), buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                return false;
+            }
+            message.append(buffer, static_cast<size_t>(received));
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+} // namespace CrashSender
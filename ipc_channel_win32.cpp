@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <vector>
+
+#include <windows.h>
+
+#include "utils.h"
+#include "ipc_channel.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+
+    std::wstring PipePath(std::wstring_view name) {
+        return L"\\\\.\\pipe\\" + std::wstring(name);
+    }
+
+    /**
+     * @brief Read the user of a process token
+     * @param user Receives a TOKEN_USER structure
+     */
+    bool QueryProcessUser(HANDLE process, std::vector<BYTE>& user) noexcept {
+        try {
+            HANDLE token = nullptr;
+            if (!OpenProcessToken(process, TOKEN_QUERY, &token)) {
+                return false;
+            }
+
+            DWORD size = 0;
+            GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+            user.resize(size);
+            const bool queried = size > 0 && GetTokenInformation(token, TokenUser, user.data(), size, &size);
+            CloseHandle(token);
+            return queried;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    PSID UserSid(std::vector<BYTE>& user) noexcept {
+        return reinterpret_cast<TOKEN_USER*>(user.data())->User.Sid;
+    }
+
+    /**
+     * @brief Check that the process serving the pipe runs as the current user, a pipe
+     * squatted by another account must not receive the report
+     */
+    bool IsServedByCurrentUser(HANDLE pipe) noexcept {
+        ULONG server_id = 0;
+        if (!GetNamedPipeServerProcessId(pipe, &server_id)) {
+            return false;
+        }
+
+        const HANDLE server = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, server_id);
+        if (!server) {
+            return false;
+        }
+
+        std::vector<BYTE> server_user;
+        const bool queried = QueryProcessUser(server, server_user);
+        CloseHandle(server);
+
+        std::vector<BYTE> own_user;
+        return queried && QueryProcessUser(GetCurrentProcess(), own_user) &&
+               EqualSid(UserSid(server_user), UserSid(own_user));
+    }
+
+    /**
+     * @brief Run one overlapped read or write and wait for it with a timeout
+     */
+    template <typename Operation>
+    bool WaitOverlapped(HANDLE handle, Operation&& operation, DWORD& transferred, std::chrono::milliseconds timeout) noexcept {
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!overlapped.hEvent) {
+            return false;
+        }
+
+        bool completed = operation(&overlapped) != FALSE;
+        if (!completed && GetLastError() == ERROR_IO_PENDING) {
+            const auto wait_ms = static_cast<DWORD>(std::clamp<int64_t>(timeout.count(), 0, MAXDWORD - 1));
+            if (WaitForSingleObject(overlapped.hEvent, wait_ms) != WAIT_OBJECT_0) {
+                // The buffer must outlive the operation
+                CancelIoEx(handle, &overlapped);
+            }
+            completed = GetOverlappedResult(handle, &overlapped, &transferred, TRUE) != FALSE;
+        }
+        else if (completed) {
+            completed = GetOverlappedResult(handle, &overlapped, &transferred, TRUE) != FALSE;
+        }
+
+        CloseHandle(overlapped.hEvent);
+        return completed;
+    }
+
+} // anonymous namespace
+
+struct IpcServer::ConnectState {
+    OVERLAPPED overlapped{};
+    HANDLE event = nullptr;
+    bool pending = false;
+
+    // Every pipe instance is created with a DACL that admits only the current user
+    std::vector<BYTE> user;
+    std::vector<BYTE> acl;
+    SECURITY_DESCRIPTOR descriptor{};
+    SECURITY_ATTRIBUTES security{};
+
+    bool InitializeSecurity() noexcept {
+        try {
+            if (!QueryProcessUser(GetCurrentProcess(), user)) {
+                return false;
+            }
+
+            const PSID sid = UserSid(user);
+            const DWORD acl_size = sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) - sizeof(DWORD) + GetLengthSid(sid);
+            acl.resize(acl_size);
+            const auto dacl = reinterpret_cast<PACL>(acl.data());
+            if (!InitializeAcl(dacl, acl_size, ACL_REVISION) ||
+                !AddAccessAllowedAce(dacl, ACL_REVISION, GENERIC_ALL, sid) ||
+                !InitializeSecurityDescriptor(&descriptor, SECURITY_DESCRIPTOR_REVISION) ||
+                !SetSecurityDescriptorDacl(&descriptor, TRUE, dacl, FALSE)) {
+                return false;
+            }
+
+            security.nLength = sizeof(security);
+            security.lpSecurityDescriptor = &descriptor;
+            security.bInheritHandle = FALSE;
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+};
+
+IpcServer::IpcServer(std::wstring_view name) : name_(name), connect_(std::make_unique<ConnectState>()) {
+}
+
+IpcServer::~IpcServer() {
+    if (connect_->pending) {
+        CancelIoEx(listener_.get(), &connect_->overlapped);
+        DWORD ignored = 0;
+        GetOverlappedResult(listener_.get(), &connect_->overlapped, &ignored, TRUE);
+    }
+    listener_.Close();
+    if (connect_->event) {
+        CloseHandle(connect_->event);
+    }
+}
+
+bool IpcServer::Listen(std::string& error_message) noexcept {
+    try {
+        connect_->event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!connect_->event) {
+            error_message = "Failed to create IPC event";
+            return false;
+        }
+        if (!connect_->InitializeSecurity()) {
+            error_message = "Failed to build IPC pipe security descriptor";
+            return false;
+        }
+
+        // The first instance claims the name, a second daemon or a pipe squatted by another user fails here
+        const std::wstring path = PipePath(name_);
+        listener_ = FileHandle(CreateNamedPipeW(path.c_str(),
+                                                PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                                PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0,
+                                                &connect_->security));
+        if (!listener_) {
+            error_message = GetLastError() == ERROR_ACCESS_DENIED ? "Another sender daemon is already running"
+                                                                  : "Failed to create IPC pipe";
+            return false;
+        }
+
+        return true;
+    }
+    catch (...) {
+        error_message = "Unknown exception while creating IPC channel";
+        return false;
+    }
+}
+
+IpcServer::AcceptResult IpcServer::Accept(std::chrono::milliseconds timeout, FileHandle& client) noexcept {
+    try {
+        // Every client gets its own pipe instance
+        if (!listener_) {
+            const std::wstring path = PipePath(name_);
+            listener_ = FileHandle(CreateNamedPipeW(path.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+                                                    PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                                    PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0,
+                                                    &connect_->security));
+            if (!listener_) {
+                return AcceptResult::Failed;
+            }
+        }
+
+        ConnectState& state = *connect_;
+        if (!state.pending) {
+            state.overlapped = OVERLAPPED{};
+            state.overlapped.hEvent = state.event;
+            ResetEvent(state.event);
+
+            // A client that connected between instances is reported as ERROR_PIPE_CONNECTED
+            if (!ConnectNamedPipe(listener_.get(), &state.overlapped)) {
+                const DWORD error = GetLastError();
+                if (error == ERROR_IO_PENDING) {
+                    state.pending = true;
+                } else if (error != ERROR_PIPE_CONNECTED) {
+                    listener_.Close();
+                    return AcceptResult::Failed;
+                }
+            }
+        }
+
+        if (state.pending) {
+            const auto wait_ms = static_cast<DWORD>(std::clamp<int64_t>(timeout.count(), 0, MAXDWORD - 1));
+            if (WaitForSingleObject(state.event, wait_ms) != WAIT_OBJECT_0) {
+                return AcceptResult::Timeout;
+            }
+
+            DWORD ignored = 0;
+            state.pending = false;
+            if (!GetOverlappedResult(listener_.get(), &state.overlapped, &ignored, FALSE)) {
+                listener_.Close();
+                return AcceptResult::Timeout;
+            }
+        }
+
+        client = std::move(listener_);
+        return AcceptResult::Accepted;
+    }
+    catch (...) {
+        return AcceptResult::Failed;
+    }
+}
+
+bool IpcChannel::Connect(std::wstring_view name, FileHandle& stream) noexcept {
+    try {
+        // The server may only identify the client, it must not act as it
+        const std::wstring path = PipePath(name);
+        constexpr DWORD flags = FILE_FLAG_OVERLAPPED | SECURITY_SQOS_PRESENT | SECURITY_IDENTIFICATION;
+        FileHandle pipe(CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, flags, nullptr));
+        if (!pipe && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeW(path.c_str(), 1000)) {
+            pipe = FileHandle(CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, flags, nullptr));
+        }
+        if (!pipe || !IsServedByCurrentUser(pipe.get())) {
+            return false;
+        }
+
+        stream = std::move(pipe);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool IpcChannel::Send(const FileHandle& stream, std::string_view message, std::chrono::milliseconds timeout) noexcept {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!message.empty()) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+
+        DWORD written = 0;
+        const auto size = static_cast<DWORD>(std::min<size_t>(message.size(), PIPE_BUFFER_SIZE));
+        const bool ok = WaitOverlapped(stream.get(), [&](OVERLAPPED* overlapped) {
+            return WriteFile(stream.get(), message.data(), size, nullptr, overlapped);
+        }, written, remaining);
+        if (!ok || written == 0) {
+            return false;
+        }
+        message.remove_prefix(written);
+    }
+    return true;
+}
+
+bool IpcChannel::Receive(const FileHandle& stream, std::string_view terminator, std::string& message,
+                         std::chrono::milliseconds timeout) noexcept {
+    try {
+        message.clear();
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        char buffer[4096];
+        while (message.size() < terminator.size() ||
+               std::string_view(message).substr(message.size() - terminator.size()) != terminator) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (message.size() >= kMaxMessageSize || remaining.count() <= 0) {
+                return false;
+            }
+
+            DWORD received = 0;
+            const bool ok = WaitOverlapped(stream.get(), [&](OVERLAPPED* overlapped) {
+                return ReadFile(stream.get(), buffer, sizeof(buffer), nullptr, overlapped);
+            }, received, remaining);
+            if (!ok || received == 0) {
+                return false;
+            }
+            message.append(buffer, received);
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "connection_pool.h"
+#include "crash_report_data.h"
+#include "crash_report_data_builder.h"
+#include "file_system.h"
+#include "http_client.h"
+
+/**
+ * Load generator replaying many simulated senders against an ingest endpoint.
+ *
+ * Reports arrive on an open-loop schedule and are uploaded by a pool of
+ * sender threads through HttpClient, the same body builder and transport the
+ * sender uses. Latency is measured from the scheduled arrival, so time spent
+ * waiting for a free sender counts as it would for a real crashed client.
+ *
+ * Usage: crashsender_load --url=http://127.0.0.1:18080/ [--reports=1000] [--duration=SECONDS]
+ *                         [--rate=200] [--arrival=poisson|uniform|burst] [--concurrency=256]
+ *                         [--sizes=256K:60,4M:30,64M:10] [--dir=.] [--keep-alive] [--parallel=1]
+ *                         [--timeout=60] [--seed=1] [--keep]
+ *
+ * Progress goes to standard error once a second, the summary is printed as
+ * one JSON object to standard output.
+ */
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr uint64_t KB = 1024;
+    constexpr uint64_t MB = 1024 * KB;
+    constexpr uint64_t GB = 1024 * MB;
+
+    enum class Arrival : int {
+        Poisson = 0,  ///< Exponential gaps around the rate, like independent crashes
+        Uniform = 1,  ///< Evenly spaced at the rate
+        Burst = 2     ///< All reports at once, like a crash storm after a bad patch
+    };
+
+    struct DumpSize {
+        uint64_t size = 0;
+        uint32_t weight = 1;
+        std::wstring path{};
+    };
+
+    struct LoadOptions {
+        std::wstring url{};
+        size_t reports = 1000;
+        double duration = 0;            ///< Seconds, overrides reports together with rate
+        double rate = 200;              ///< Reports per second
+        Arrival arrival = Arrival::Poisson;
+        size_t concurrency = 256;       ///< Simulated senders uploading at once
+        std::vector<DumpSize> sizes{ { 256 * KB, 60 }, { 4 * MB, 30 }, { 64 * MB, 10 } };
+        std::wstring directory{ L"." };
+        bool keep_alive = false;        ///< Reuse connections between the reports of a sender thread
+        size_t parallel_uploads = 1;
+        uint32_t timeout_s = 60;
+        uint32_t seed = 1;
+        bool keep_files = false;
+    };
+
+    bool ParseSize(std::string_view text, uint64_t& size) {
+        if (text.empty()) {
+            return false;
+        }
+        uint64_t unit = 1;
+        switch (text.back()) {
+        case 'K': case 'k': unit = KB; break;
+        case 'M': case 'm': unit = MB; break;
+        case 'G': case 'g': unit = GB; break;
+        default: break;
+        }
+        if (unit != 1) {
+            text.remove_suffix(1);
+        }
+        try {
+            size = std::stoull(std::string(text)) * unit;
+            return size > 0;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parse "size[:weight],..." into the dump size distribution
+     */
+    bool ParseSizes(std::string_view list, std::vector<DumpSize>& sizes) {
+        sizes.clear();
+        size_t start = 0;
+        while (start < list.size()) {
+            const size_t end = std::min(list.find(',', start), list.size());
+            const std::string_view item = list.substr(start, end - start);
+            start = end + 1;
+
+            DumpSize dump;
+            const size_t colon = item.find(':');
+            if (!ParseSize(item.substr(0, colon), dump.size)) {
+                return false;
+            }
+            if (colon != std::string_view::npos) {
+                dump.weight = static_cast<uint32_t>(std::strtoul(std::string(item.substr(colon + 1)).c_str(), nullptr, 10));
+            }
+            if (dump.weight > 0) {
+                sizes.push_back(std::move(dump));
+            }
+        }
+        return !sizes.empty();
+    }
+
+    bool ParseOptions(int argc, char* argv[], LoadOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            const auto value = [&](std::string_view name) { return std::string(arg.substr(name.size())); };
+
+            if (arg.starts_with("--url=")) {
+                options.url = TextUtils::Utf8ToWide(value("--url="));
+            } else if (arg.starts_with("--reports=")) {
+                options.reports = std::strtoull(value("--reports=").c_str(), nullptr, 10);
+            } else if (arg.starts_with("--duration=")) {
+                options.duration = std::atof(value("--duration=").c_str());
+            } else if (arg.starts_with("--rate=")) {
+                options.rate = std::atof(value("--rate=").c_str());
+            } else if (arg.starts_with("--arrival=")) {
+                const std::string arrival = value("--arrival=");
+                if (arrival == "poisson") {
+                    options.arrival = Arrival::Poisson;
+                } else if (arrival == "uniform") {
+                    options.arrival = Arrival::Uniform;
+                } else if (arrival == "burst") {
+                    options.arrival = Arrival::Burst;
+                } else {
+                    std::fprintf(stderr, "Unknown arrival pattern: %s\n", arrival.c_str());
+                    return false;
+                }
+            } else if (arg.starts_with("--concurrency=")) {
+                options.concurrency = std::max<size_t>(1, std::strtoull(value("--concurrency=").c_str(), nullptr, 10));
+            } else if (arg.starts_with("--sizes=")) {
+                if (!ParseSizes(value("--sizes="), options.sizes)) {
+                    std::fprintf(stderr, "Invalid size distribution: %s\n", value("--sizes=").c_str());
+                    return false;
+                }
+            } else if (arg.starts_with("--dir=")) {
+                options.directory = TextUtils::Utf8ToWide(value("--dir="));
+            } else if (arg == "--keep-alive") {
+                options.keep_alive = true;
+            } else if (arg.starts_with("--parallel=")) {
+                options.parallel_uploads = std::max<size_t>(1, std::strtoull(value("--parallel=").c_str(), nullptr, 10));
+            } else if (arg.starts_with("--timeout=")) {
+                options.timeout_s = static_cast<uint32_t>(std::strtoul(value("--timeout=").c_str(), nullptr, 10));
+            } else if (arg.starts_with("--seed=")) {
+                options.seed = static_cast<uint32_t>(std::strtoul(value("--seed=").c_str(), nullptr, 10));
+            } else if (arg == "--keep") {
+                options.keep_files = true;
+            } else {
+                std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+                return false;
+            }
+        }
+
+        if (options.url.empty()) {
+            std::fprintf(stderr, "Missing --url\n");
+            return false;
+        }
+        if (options.duration > 0 && options.arrival != Arrival::Burst) {
+            options.reports = static_cast<size_t>(options.duration * options.rate);
+        }
+        if (options.rate <= 0 && options.arrival != Arrival::Burst) {
+            std::fprintf(stderr, "Rate must be positive\n");
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Write a dump of pseudo-random bytes, an existing file of the right size is reused
+     */
+    bool CreateSyntheticDump(const std::wstring& path, uint64_t size) {
+        FileHandle existing;
+        if (FileSystem::OpenRead(path, FileSystem::Access::Normal, existing) == FileSystem::OpenResult::Ok &&
+            FileSystem::Size(existing) == static_cast<int64_t>(size)) {
+            return true;
+        }
+        existing.Close();
+
+        FileHandle file;
+        if (!FileSystem::CreateWrite(path, file)) {
+            return false;
+        }
+
+        std::mt19937_64 random(size);
+        std::vector<uint64_t> block(MB / sizeof(uint64_t));
+        for (uint64_t written = 0; written < size;) {
+            for (auto& word : block) {
+                word = random();
+            }
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(size - written, MB));
+            if (!FileSystem::Write(file, reinterpret_cast<const char*>(block.data()), chunk)) {
+                return false;
+            }
+            written += chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Milliseconds at the given percentile of sorted samples
+     */
+    double Percentile(const std::vector<double>& sorted, double percentile) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        const size_t index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    std::string FormatPercentiles(std::vector<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        char text[256];
+        std::snprintf(text, sizeof(text), "{\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"p999\":%.2f,\"max\":%.2f}",
+                      Percentile(samples, 50), Percentile(samples, 90), Percentile(samples, 99),
+                      Percentile(samples, 99.9), samples.empty() ? 0.0 : samples.back());
+        return text;
+    }
+
+    /**
+     * @brief Simulated senders fed by the arrival schedule
+     */
+    class LoadGenerator {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit LoadGenerator(const LoadOptions& options) : options_(options), random_(options.seed) {
+        }
+
+        int Run() {
+            if (!PrepareDumps()) {
+                return 1;
+            }
+
+            CrashReportData report;
+            report.url = options_.url;
+            report.urls = { options_.url };
+            report.version = "1.0.0";
+            report.temp_path = L"error.txt";
+            report.parallel_uploads = options_.parallel_uploads;
+            report.timeout_ms = options_.timeout_s * 1000;
+            CrashReportDataBuilder::ProcessServerUrl(report);
+            if (report.endpoints.empty()) {
+                std::fprintf(stderr, "Invalid URL\n");
+                return 1;
+            }
+            template_ = report;
+
+            ScheduleArrivals();
+            samples_.reserve(schedule_.size());
+
+            std::fprintf(stderr, "Replaying %zu reports with %zu senders\n", schedule_.size(), options_.concurrency);
+            started_ = Clock::now();
+
+            std::vector<std::thread> senders;
+            senders.reserve(options_.concurrency);
+            for (size_t i = 0; i < options_.concurrency; ++i) {
+                senders.emplace_back([this]() { Sender(); });
+            }
+            std::thread dispatcher([this]() { Dispatch(); });
+
+            // Progress until the last report is done
+            while (finished_.load() < schedule_.size()) {
+                std::unique_lock lock(mutex_);
+                progress_.wait_for(lock, std::chrono::seconds(1));
+                const double elapsed = std::chrono::duration<double>(Clock::now() - started_).count();
+                std::fprintf(stderr, "%6.1fs  done %zu/%zu  failed %zu  in flight %zu\n", elapsed, finished_.load(),
+                             schedule_.size(), failed_.load(), in_flight_.load());
+            }
+
+            dispatcher.join();
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_all();
+            for (auto& sender : senders) {
+                sender.join();
+            }
+
+            PrintSummary(std::chrono::duration<double>(Clock::now() - started_).count());
+            CleanupDumps();
+            return failed_.load() == schedule_.size() ? 1 : 0;
+        }
+
+    private:
+        struct Job {
+            size_t index = 0;
+            size_t dump = 0;            ///< Index into the size distribution
+            Clock::duration arrival{};  ///< Scheduled time after the start
+        };
+
+        struct Sample {
+            double latency_ms = 0;      ///< Scheduled arrival to delivery
+            double service_ms = 0;      ///< Upload only
+            double queue_ms = 0;        ///< Waiting for a free sender
+            uint64_t bytes = 0;
+            bool ok = false;
+        };
+
+        bool PrepareDumps() {
+            dumps_ = options_.sizes;
+            for (auto& dump : dumps_) {
+                dump.path = options_.directory + L"/crashsender_load_" + std::to_wstring(dump.size) + L".dmp";
+                if (!CreateSyntheticDump(dump.path, dump.size)) {
+                    std::fprintf(stderr, "Failed to create dump of %llu bytes\n", static_cast<unsigned long long>(dump.size));
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void CleanupDumps() {
+            if (options_.keep_files) {
+                return;
+            }
+            for (const auto& dump : dumps_) {
+                std::string error_message;
+                (void)FileSystem::Remove(dump.path, error_message);
+            }
+        }
+
+        void ScheduleArrivals() {
+            std::vector<uint32_t> weights;
+            for (const auto& dump : dumps_) {
+                weights.push_back(dump.weight);
+            }
+            std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+            std::exponential_distribution<double> gap(options_.rate > 0 ? options_.rate : 1);
+
+            double at = 0;
+            schedule_.reserve(options_.reports);
+            for (size_t i = 0; i < options_.reports; ++i) {
+                switch (options_.arrival) {
+                case Arrival::Poisson: at += gap(random_); break;
+                case Arrival::Uniform: at = static_cast<double>(i) / options_.rate; break;
+                case Arrival::Burst: at = 0; break;
+                }
+                schedule_.push_back(Job{ i, pick(random_),
+                    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(at)) });
+            }
+        }
+
+        /**
+         * @brief Release reports at their scheduled time, whether or not a sender is free
+         */
+        void Dispatch() {
+            for (const auto& job : schedule_) {
+                std::this_thread::sleep_until(started_ + job.arrival);
+                {
+                    std::lock_guard lock(mutex_);
+                    queue_.push_back(job);
+                }
+                ready_.notify_one();
+            }
+        }
+
+        void Sender() {
+            // One pool per sender: with keep-alive it is reused, otherwise every report connects anew
+            ConnectionPool pool;
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock lock(mutex_);
+                    ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                    if (queue_.empty()) {
+                        return;
+                    }
+                    job = queue_.front();
+                    queue_.pop_front();
+                }
+
+                ConnectionPool fresh;
+                ++in_flight_;
+                const Sample sample = Send(job, options_.keep_alive ? pool : fresh);
+                --in_flight_;
+
+                {
+                    std::lock_guard lock(mutex_);
+                    samples_.push_back(sample);
+                }
+                if (!sample.ok) {
+                    ++failed_;
+                }
+                if (++finished_ == schedule_.size()) {
+                    progress_.notify_all();
+                }
+            }
+        }
+
+        Sample Send(const Job& job, ConnectionPool& pool) {
+            const DumpSize& dump = dumps_[job.dump];
+            CrashReportData data = template_;
+            data.dump_path = dump.path;
+            data.error = "Simulated crash #" + std::to_string(job.index) + " of crashsender_load";
+
+            Sample sample;
+            sample.bytes = dump.size;
+            const auto scheduled = started_ + job.arrival;
+            const auto begun = Clock::now();
+
+            CancellationToken token;
+            token.SetTimeout(std::chrono::milliseconds(data.timeout_ms));
+            bool retryable = true;
+            std::string error_message;
+            sample.ok = HttpClient::SendCrashReport(data, token, pool, retryable, error_message);
+            if (!sample.ok) {
+                Logger::LogError("Simulated report failed: " + error_message);
+            }
+
+            using Milliseconds = std::chrono::duration<double, std::milli>;
+            const auto done = Clock::now();
+            sample.latency_ms = Milliseconds(done - scheduled).count();
+            sample.service_ms = Milliseconds(done - begun).count();
+            sample.queue_ms = Milliseconds(begun - scheduled).count();
+            return sample;
+        }
+
+        void PrintSummary(double seconds) {
+            std::vector<double> latency;
+            std::vector<double> service;
+            std::vector<double> queue;
+            uint64_t bytes = 0;
+            for (const auto& sample : samples_) {
+                if (!sample.ok) {
+                    continue;
+                }
+                latency.push_back(sample.latency_ms);
+                service.push_back(sample.service_ms);
+                queue.push_back(sample.queue_ms);
+                bytes += sample.bytes;
+            }
+
+            const size_t succeeded = samples_.size() - failed_.load();
+            std::printf("{\"reports\":%zu,\"succeeded\":%zu,\"failed\":%zu,\"concurrency\":%zu,\"seconds\":%.3f,"
+                        "\"reports_per_second\":%.1f,\"bytes_per_second\":%.0f,\"latency_ms\":%s,\"service_ms\":%s,"
+                        "\"queue_ms\":%s}\n",
+                        samples_.size(), succeeded, failed_.load(), options_.concurrency, seconds,
+                        seconds > 0 ? static_cast<double>(succeeded) / seconds : 0.0,
+                        seconds > 0 ? static_cast<double>(bytes) / seconds : 0.0,
+                        FormatPercentiles(std::move(latency)).c_str(), FormatPercentiles(std::move(service)).c_str(),
+                        FormatPercentiles(std::move(queue)).c_str());
+            std::fflush(stdout);
+        }
+
+        const LoadOptions options_;
+        std::mt19937 random_;
+        std::vector<DumpSize> dumps_;
+        CrashReportData template_;
+        std::vector<Job> schedule_;
+        Clock::time_point started_;
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::condition_variable progress_;
+        std::deque<Job> queue_;
+        bool stopping_ = false;
+        std::vector<Sample> samples_;
+        std::atomic<size_t> in_flight_{ 0 };
+        std::atomic<size_t> finished_{ 0 };
+        std::atomic<size_t> failed_{ 0 };
+    };
+
+} // anonymous namespace
+
+} // namespace CrashSender
+
+int main(int argc, char* argv[]) {
+    CrashSender::LoadOptions options;
+    if (!CrashSender::ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep the log of a sender in the same directory intact
+    CrashSender::Logger::SetFileName("crashsender_load.log");
+
+    CrashSender::LoadGenerator generator(options);
+    return generator.Run();
+}
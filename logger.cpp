@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "utils.h"
+#include "startup_profile.h"
 #include "logger.h"
 
 namespace CrashSender {
@@ -10,24 +11,37 @@ Logger& Logger::GetInstance() noexcept {
     return instance;
 }
 
-Logger::Logger() {
+void Logger::SetFileName(const char* file_name) noexcept {
+    file_name_ = file_name;
+}
+
+void Logger::Flush() noexcept {
+    Logger& logger = GetInstance();
     try {
-        log_file_.open("L2CrashSender.log", std::ios::out);
-        if (log_file_.is_open()) {
-            is_initialized_ = true;
-            LogImpl(LogLevel::Info, "L2CrashSender started");
+        std::lock_guard lock(logger.mutex_);
+        if (logger.deferred_) {
+            logger.Open();
         }
     }
     catch (...) {
         // Continue without logging if a file cannot be opened
-        is_initialized_ = false;
     }
 }
 
+Logger::Logger() {
+    // Held back like any other line, the file is opened later
+    LogImpl(LogLevel::Info, "L2CrashSender started");
+}
+
 Logger::~Logger() {
     try {
-        if (is_initialized_ && log_file_.is_open()) {
-            LogImpl(LogLevel::Info, "L2CrashSender finished");
+        LogImpl(LogLevel::Info, "L2CrashSender finished");
+
+        std::lock_guard lock(mutex_);
+        if (deferred_) {
+            Open();
+        }
+        if (log_file_.is_open()) {
             log_file_.flush();
             log_file_.close();
         }
@@ -42,7 +56,7 @@ void Logger::Debug(std::string_view message) noexcept {
 }
 
 void Logger::Debug(std::wstring_view message) noexcept {
-    LogImpl(LogLevel::Debug, TextUtils::WideToUtf8(message));
+    LogImpl(LogLevel::Debug, message);
 }
 
 void Logger::Info(std::string_view message) noexcept {
@@ -50,7 +64,7 @@ void Logger::Info(std::string_view message) noexcept {
 }
 
 void Logger::Info(std::wstring_view message) noexcept {
-    LogImpl(LogLevel::Info, TextUtils::WideToUtf8(message));
+    LogImpl(LogLevel::Info, message);
 }
 
 void Logger::Error(std::string_view message) noexcept {
@@ -58,22 +72,77 @@ void Logger::Error(std::string_view message) noexcept {
 }
 
 void Logger::Error(std::wstring_view message) noexcept {
-    LogImpl(LogLevel::Error, TextUtils::WideToUtf8(message));
+    LogImpl(LogLevel::Error, message);
 }
 
 void Logger::LogImpl(LogLevel level, std::string_view message) noexcept {
-    if (!is_initialized_) {
-        return;
+    try {
+        // Upload workers and daemon jobs log concurrently
+        std::lock_guard lock(mutex_);
+        if (deferred_ || log_file_.is_open()) {
+            BeginLine(level);
+            line_.append(message);
+            WriteLine(level);
+        }
+    } catch (...) {
+        // Ignore logging errors to prevent cascading failures
     }
+}
 
+void Logger::LogImpl(LogLevel level, std::wstring_view message) noexcept {
     try {
-        if (log_file_.is_open()) {
-            log_file_ << TimeUtils::GetCurrentTimestamp() << " [" << LogLevelToString(level) << "] " << message << '\n';
-            log_file_.flush(); // Ensure immediate write for crash reporting tool
+        std::lock_guard lock(mutex_);
+        if (deferred_ || log_file_.is_open()) {
+            // Converted straight into the line, no intermediate string
+            BeginLine(level);
+            const size_t prefix_size = line_.size();
+            line_.resize(prefix_size + message.size() * TextUtils::kMaxUtf8PerWide);
+            line_.resize(prefix_size + TextUtils::WideToUtf8(message, line_.data() + prefix_size));
+            WriteLine(level);
         }
     } catch (...) {
         // Ignore logging errors to prevent cascading failures
     }
 }
 
+void Logger::BeginLine(LogLevel level) {
+    char timestamp[TimeUtils::kTimestampSize];
+    const size_t timestamp_size = TimeUtils::FormatCurrentTimestamp(timestamp);
+
+    line_.clear();
+    line_.append(timestamp_size > 0 ? std::string_view(timestamp, timestamp_size) : std::string_view("TIMESTAMP_ERROR"));
+    line_.append(" [");
+    line_.append(LogLevelToString(level));
+    line_.append("] ");
+}
+
+void Logger::WriteLine(LogLevel level) {
+    line_.push_back('\n');
+    if (deferred_) {
+        pending_.append(line_);
+
+        // An error may be the last thing this process does
+        if (level == LogLevel::Error || pending_.size() >= kMaxPending) {
+            Open();
+        }
+        return;
+    }
+
+    log_file_.write(line_.data(), static_cast<std::streamsize>(line_.size()));
+    log_file_.flush(); // Ensure immediate write for crash reporting tool
+}
+
+void Logger::Open() {
+    deferred_ = false;
+
+    // Without a file logging goes on silently
+    log_file_.open(file_name_, std::ios::out);
+    if (log_file_.is_open()) {
+        StartupProfile::Mark(StartupProfile::Stage::Logger);
+        log_file_.write(pending_.data(), static_cast<std::streamsize>(pending_.size()));
+        log_file_.flush();
+    }
+    std::string().swap(pending_);
+}
+
 } // namespace CrashSender
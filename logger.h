@@ -2,12 +2,18 @@
 #pragma once
 
 #include <fstream>
+#include <mutex>
+#include <string>
 #include <string_view>
 
 namespace CrashSender {
 
 /**
  * @brief Logger with RAII lifecycle management
+ *
+ * A starting sender must not wait for the file system before its report is
+ * on the wire, so the log file is opened lazily: lines are held in memory
+ * until Flush(), the first error, a full buffer or shutdown.
  */
 class Logger {
 public:
@@ -23,6 +29,17 @@ public:
      */
     static Logger& GetInstance() noexcept;
 
+    /**
+     * @brief Choose the log file, only effective before the first message is logged
+     * @param file_name Log file name, a daemon must not share the file of sender processes
+     */
+    static void SetFileName(const char* file_name) noexcept;
+
+    /**
+     * @brief Open the log file and write the lines held back so far, later lines go straight to the file
+     */
+    static void Flush() noexcept;
+
     /**
      * @brief Log a debug message
      * @param message Message to log
@@ -63,6 +80,22 @@ private:
     Logger& operator=(Logger&&) = delete;
 
     void LogImpl(LogLevel level, std::string_view message) noexcept;
+    void LogImpl(LogLevel level, std::wstring_view message) noexcept;
+
+    /**
+     * @brief Start line_ with the timestamp and level, called with the mutex held
+     */
+    void BeginLine(LogLevel level);
+
+    /**
+     * @brief Terminate line_ and write it out or hold it back, called with the mutex held
+     */
+    void WriteLine(LogLevel level);
+
+    /**
+     * @brief Open the log file and write the held back lines, called with the mutex held
+     */
+    void Open();
 
     static constexpr std::string_view LogLevelToString(LogLevel level) noexcept {
         switch (level) {
@@ -73,8 +106,15 @@ private:
         }
     }
 
+    static constexpr size_t kMaxPending = 64 * 1024; ///< Held back lines beyond this open the file
+
+    static inline const char* file_name_ = "L2CrashSender.log";
+
     std::ofstream log_file_;
-    bool is_initialized_{false};
+    std::string line_;    ///< Reused for every line, logging stops allocating once it fits the longest message
+    std::string pending_; ///< Lines logged before the file was opened
+    std::mutex mutex_;
+    bool deferred_{true}; ///< The file was not opened yet
 };
 
 } // namespace CrashSender
@@ -1,19 +1,162 @@
+#include <cstdio>
 #include <iostream>
-#include <clocale>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#endif
 
 #include "utils.h"
 #include "logger.h"
+#include "cancellation_token.h"
 #include "crash_report_data.h"
 #include "crash_report_data_builder.h"
-#include "http_client.h"
+#include "crash_sender.h"
+#include "file_system.h"
+#include "report_spool.h"
+#include "sender_daemon.h"
+#include "upload_coordinator.h"
+#include "startup_profile.h"
 #include "main.h"
 
 namespace CrashSender {
 
+namespace {
+
+    CancellationToken cancellation;
+
+#ifdef _WIN32
+    BOOL WINAPI ConsoleControlHandler(DWORD control_type) {
+        cancellation.Cancel();
+
+        // The process is terminated when the handler returns from a close event,
+        // give the main thread a moment to spool the report
+        if (control_type != CTRL_C_EVENT && control_type != CTRL_BREAK_EVENT) {
+            Sleep(2000);
+        }
+        return TRUE;
+    }
+
+    void InstallCancelHandler() noexcept {
+        SetConsoleCtrlHandler(ConsoleControlHandler, TRUE);
+    }
+#else
+    void SignalHandler(int) {
+        // Only the lock-free flag is touched, the main thread does the spooling
+        cancellation.Cancel();
+    }
+
+    void InstallCancelHandler() noexcept {
+        struct sigaction action {};
+        action.sa_handler = SignalHandler;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGHUP, &action, nullptr);
+    }
+#endif
+
+    /**
+     * @brief Print the startup profile as one JSON line to stderr, where a benchmark can collect it
+     */
+    void ReportStartupProfile(const CrashReportData& data) noexcept {
+        if (!data.profile_startup) {
+            return;
+        }
+
+        try {
+            const std::string profile = StartupProfile::Describe();
+            std::fprintf(stderr, "%s\n", profile.c_str());
+            std::fflush(stderr);
+            Logger::LogInfo("Startup profile (us): " + profile);
+        }
+        catch (...) {
+            // Profiling is diagnostic only
+        }
+    }
+
+    /**
+     * @brief Serve reports of other sender processes until cancelled
+     */
+    int RunDaemon(const CrashReportData& options) noexcept {
+        // A resident process has no startup to hurry, its log is written as it goes
+        Logger::Flush();
+
+        if (options.background_mode) {
+            ProcessUtils::EnterBackgroundMode();
+        }
+        InstallCancelHandler();
+
+        SenderDaemon daemon(options);
+        std::string daemon_error;
+        if (!daemon.Run(cancellation, daemon_error)) {
+            Logger::LogError("Sender daemon failed: " + daemon_error);
+            return 1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Deliver reports spooled by earlier runs while time is left
+     * @param options Current report, its transport settings are reused
+     */
+    void SendSpooledReports(const CrashReportData& options) noexcept {
+        try {
+            // A failed report must not hold up the newer ones behind it, only the deadline stops the loop
+            for (const auto& report : ReportSpool::LoadPending()) {
+                if (cancellation.IsCancelled()) {
+                    return;
+                }
+
+                CrashReportData data = options;
+                data.url = report.data.url;
+                data.urls = report.data.urls;
+                data.version = report.data.version;
+                data.error = report.data.error;
+                data.signature = report.data.signature;
+                data.archive_path = report.data.archive_path;
+                data.temp_path = report.data.temp_path;
+                data.dump_path = report.data.dump_path;
+                data.game_log_path = report.data.game_log_path;
+                data.network_log_path = report.data.network_log_path;
+
+                if (!CrashReportDataBuilder::ProcessErrorContent(data)) {
+                    continue;
+                }
+
+                // The daemon or another sender may be sending it already
+                FileHandle claim;
+                if (!ReportSpool::Claim(report, claim)) {
+                    Logger::LogDebug(L"Skipping spooled crash report claimed elsewhere: " + report.path);
+                    continue;
+                }
+
+                Logger::LogInfo(L"Sending spooled crash report " + report.path);
+                bool retryable = true;
+                std::string send_error;
+                if (!SubmitCrashReport(data, cancellation, retryable, send_error)) {
+                    Logger::LogError("Failed to send spooled crash report: " + send_error);
+                    if (retryable) {
+                        continue;
+                    }
+                    Logger::LogError(L"Dropping spooled crash report that cannot be sent: " + report.path);
+                }
+                ReportSpool::Remove(report);
+            }
+        }
+        catch (...) {
+            Logger::LogError("Exception occurred while sending spooled reports");
+        }
+    }
+
+} // anonymous namespace
+
 int RunApplication(int argc, wchar_t* argv[]) noexcept {
     try {
-        // Set locale for proper character handling
-        std::setlocale(LC_ALL, "");
+        // No std::setlocale, text is converted by TextUtils and the ASCII-only
+        // comparisons of header and scheme names must not follow the user locale
 
         // Parse command line arguments
         std::string parse_error;
@@ -22,6 +165,16 @@ int RunApplication(int argc, wchar_t* argv[]) noexcept {
             Logger::LogError("Command line parsing failed: " + parse_error);
             return 1;
         }
+        StartupProfile::Mark(StartupProfile::Stage::Arguments);
+
+        if (crash_data->daemon_mode) {
+            Logger::SetFileName("L2CrashSenderDaemon.log");
+            return RunDaemon(*crash_data);
+        }
+
+        if (crash_data->background_mode) {
+            ProcessUtils::EnterBackgroundMode();
+        }
 
         CrashReportDataBuilder::ProcessServerUrl(crash_data.value());
         CrashReportDataBuilder::ProcessLogFiles(crash_data.value());
@@ -32,7 +185,7 @@ int RunApplication(int argc, wchar_t* argv[]) noexcept {
         }
 
         // Log parsed data for debugging
-        Logger::LogDebug(L"Version: " + crash_data->version);
+        Logger::LogDebug("Version: " + crash_data->version);
         Logger::LogDebug(L"Error file path: " + crash_data->temp_path);
         Logger::LogDebug(L"Dump path: " + crash_data->dump_path);
         Logger::LogDebug(L"Game log path: " + crash_data->game_log_path);
@@ -46,17 +199,46 @@ int RunApplication(int argc, wchar_t* argv[]) noexcept {
             Logger::LogError("Invalid crash report data");
             return 1;
         }
+        StartupProfile::Mark(StartupProfile::Stage::Report);
+
+        // A running daemon uploads over warm connections and owns the files from here on
+        if (crash_data->use_daemon) {
+            std::string daemon_error;
+            if (SenderDaemon::Submit(*crash_data, daemon_error)) {
+                Logger::LogInfo("Crash report handed to sender daemon");
+                return 0;
+            }
+            Logger::LogDebug("Sending in-process: " + daemon_error);
+        }
+
+        // Everything below runs against one overall deadline
+        cancellation.SetTimeout(std::chrono::milliseconds(crash_data->timeout_ms));
+        InstallCancelHandler();
 
         // Send crash report
-        Logger::LogInfo(L"Sending crash report to " + crash_data->full_url);
+        // Other senders on this machine share the uplink and may carry the same crash
+        bool retryable = true;
         std::string send_error;
-        if (HttpClient::SendCrashReport(*crash_data, send_error)) {
+        const auto upload = [&](std::string& upload_error) {
+            return SubmitCrashReport(*crash_data, cancellation, retryable, upload_error);
+        };
+        const bool sent = UploadCoordinator::Submit(*crash_data, cancellation, upload, send_error);
+        ReportStartupProfile(*crash_data);
+        if (sent) {
             // Clean up temporary files on success
             FileUtils::CleanupTempFiles(*crash_data);
             Logger::LogInfo("Temporary files cleaned up");
+
+            SendSpooledReports(*crash_data);
             return 0;
         } else {
             Logger::LogError("Failed to send crash report: " + send_error);
+
+            // Keep the report for the next run unless the server rejected it or it cannot be read
+            std::string spool_error;
+            if (retryable && !ReportSpool::Store(*crash_data, spool_error)) {
+                Logger::LogError("Failed to spool crash report: " + spool_error);
+            }
             return 1;
         }
     }
@@ -72,9 +254,40 @@ int RunApplication(int argc, wchar_t* argv[]) noexcept {
 
 } // namespace CrashSender
 
+#ifdef _WIN32
+
 /**
  * @brief Main entry point for the application
  */
 int wmain(int argc, wchar_t* argv[]) {
+    CrashSender::StartupProfile::Mark(CrashSender::StartupProfile::Stage::Entry);
     return CrashSender::RunApplication(argc, argv);
 }
+
+#else
+
+/**
+ * @brief Main entry point for the application, arguments are UTF-8
+ */
+int main(int argc, char* argv[]) {
+    CrashSender::StartupProfile::Mark(CrashSender::StartupProfile::Stage::Entry);
+    try {
+        std::vector<std::wstring> arguments;
+        std::vector<wchar_t*> wide_argv;
+        arguments.reserve(static_cast<size_t>(argc));
+        for (int i = 0; i < argc; ++i) {
+            arguments.push_back(CrashSender::TextUtils::Utf8ToWide(argv[i]));
+        }
+        for (auto& argument : arguments) {
+            wide_argv.push_back(argument.data());
+        }
+        wide_argv.push_back(nullptr);
+
+        return CrashSender::RunApplication(argc, wide_argv.data());
+    }
+    catch (...) {
+        return 1;
+    }
+}
+
+#endif
@@ -0,0 +1,731 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "crc32c.h"
+#include "multipart_parser.h"
+#include "rate_limiter.h"
+
+/**
+ * Local ingest server for end-to-end tests of the sender, Linux only.
+ *
+ * Speaks the protocol of the sender: single multipart reports, the parted
+ * upload actions (create, part, complete) and occurrence counts. Faults are
+ * injected per request:
+ *
+ *   --port=18080            Listening port on 127.0.0.1
+ *   --latency=MS            Delay before every response
+ *   --bandwidth=KBPS        Cap on the bytes read from all clients together
+ *   --reset-rate=PERCENT    Reset the connection in the middle of the request body
+ *   --reset-after=BYTES     Body bytes read before a reset (default half the body)
+ *   --slow-response=MS      Trickle every response over this time
+ *   --error-rate=PERCENT    Answer with --error-status (default 503) after reading the body
+ *   --seed=N                Seed of the fault dice
+ *   --log=PATH              Per-request records, standard output by default
+ *
+ * The CRC32C of every file and part is checked against the checksums the
+ * sender appends, a mismatch is answered with 400. Parts sent with
+ * "Content-Encoding: deflate" are decoded first.
+ *
+ * Every request is recorded as one JSON object per line with its timing,
+ * the injected fault and the fields and files found in the body.
+ */
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr size_t MAX_HEADER_SIZE = 64 * 1024;
+    constexpr size_t MAX_FIELD_SIZE = 64 * 1024;
+
+    struct ServerOptions {
+        uint16_t port = 18080;
+        uint32_t latency_ms = 0;
+        uint64_t bandwidth = 0;        ///< Bytes per second, 0 is unlimited
+        uint32_t reset_rate = 0;       ///< Percent of requests
+        uint64_t reset_after = 0;      ///< 0 resets halfway through the body
+        uint32_t slow_response_ms = 0;
+        uint32_t error_rate = 0;       ///< Percent of requests
+        uint32_t error_status = 503;
+        uint32_t seed = 0;
+        std::string log_path{};
+    };
+
+    bool ParseOptions(int argc, char* argv[], ServerOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            const auto number = [&](std::string_view name, auto& output) {
+                if (!arg.starts_with(name)) {
+                    return false;
+                }
+                output = static_cast<std::remove_reference_t<decltype(output)>>(
+                    std::strtoull(std::string(arg.substr(name.size())).c_str(), nullptr, 10));
+                return true;
+            };
+
+            uint64_t bandwidth_kb = 0;
+            if (number("--port=", options.port) || number("--latency=", options.latency_ms) ||
+                number("--reset-rate=", options.reset_rate) || number("--reset-after=", options.reset_after) ||
+                number("--slow-response=", options.slow_response_ms) || number("--error-rate=", options.error_rate) ||
+                number("--error-status=", options.error_status) || number("--seed=", options.seed)) {
+                continue;
+            }
+            if (number("--bandwidth=", bandwidth_kb)) {
+                options.bandwidth = bandwidth_kb * 1024;
+            } else if (arg.starts_with("--log=")) {
+                options.log_path = arg.substr(6);
+            } else {
+                std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string EscapeJson(std::string_view text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const unsigned char c : text) {
+            switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += static_cast<char>(c);
+                }
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * @brief Value of a query parameter with %XX escapes decoded, empty if absent
+     */
+    std::string QueryValue(std::string_view target, std::string_view key) {
+        const size_t query = target.find('?');
+        if (query == std::string_view::npos) {
+            return {};
+        }
+        std::string_view rest = target.substr(query + 1);
+        while (!rest.empty()) {
+            const std::string_view pair = rest.substr(0, rest.find('&'));
+            rest.remove_prefix(std::min(rest.size(), pair.size() + 1));
+            if (pair.size() <= key.size() || !pair.starts_with(key) || pair[key.size()] != '=') {
+                continue;
+            }
+
+            std::string value;
+            for (size_t i = key.size() + 1; i < pair.size(); ++i) {
+                if (pair[i] == '%' && i + 2 < pair.size()) {
+                    value += static_cast<char>(std::strtoul(std::string(pair.substr(i + 1, 2)).c_str(), nullptr, 16));
+                    i += 2;
+                } else {
+                    value += pair[i] == '+' ? ' ' : pair[i];
+                }
+            }
+            return value;
+        }
+        return {};
+    }
+
+    /**
+     * @brief Split a checksums field into its lines of tab separated columns
+     */
+    std::vector<std::vector<std::string>> SplitChecksums(std::string_view field) {
+        std::vector<std::vector<std::string>> lines;
+        while (!field.empty()) {
+            std::string_view line = field.substr(0, field.find('\n'));
+            field.remove_prefix(std::min(field.size(), line.size() + 1));
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+
+            std::vector<std::string> columns;
+            while (!line.empty()) {
+                const std::string_view column = line.substr(0, line.find('\t'));
+                columns.emplace_back(column);
+                line.remove_prefix(std::min(line.size(), column.size() + 1));
+            }
+            lines.push_back(std::move(columns));
+        }
+        return lines;
+    }
+
+    /**
+     * @brief Keeps the fields of a report and counts the bytes of its files
+     */
+    class ReportRecorder : public MultipartHandler {
+    public:
+        struct File {
+            std::string name;
+            std::string filename;
+            uint64_t bytes = 0;
+            uint32_t checksum = 0;  ///< CRC32C of the bytes
+        };
+
+        bool OnPartBegin(const MultipartPart& part) noexcept override {
+            try {
+                if (part.IsFile()) {
+                    files_.push_back(File{ std::string(part.name), std::string(part.filename), 0, 0 });
+                    field_ = nullptr;
+                } else {
+                    field_ = &fields_[std::string(part.name)];
+                }
+                return true;
+            }
+            catch (...) {
+                return false;
+            }
+        }
+
+        bool OnPartData(std::string_view data) noexcept override {
+            try {
+                if (field_) {
+                    field_->append(data.substr(0, MAX_FIELD_SIZE - std::min(MAX_FIELD_SIZE, field_->size())));
+                } else if (!files_.empty()) {
+                    files_.back().bytes += data.size();
+                    files_.back().checksum = Crc32c::Update(files_.back().checksum, data.data(), data.size());
+                }
+                return true;
+            }
+            catch (...) {
+                return false;
+            }
+        }
+
+        bool OnPartEnd() noexcept override {
+            field_ = nullptr;
+            return true;
+        }
+
+        [[nodiscard]]
+        const std::map<std::string, std::string>& Fields() const noexcept { return fields_; }
+
+        [[nodiscard]]
+        const std::vector<File>& Files() const noexcept { return files_; }
+
+    private:
+        std::map<std::string, std::string> fields_;
+        std::vector<File> files_;
+        std::string* field_ = nullptr;
+    };
+
+    /**
+     * @brief Decodes a part body as it arrives and checksums the decoded bytes
+     */
+    class PartDecoder {
+    public:
+        explicit PartDecoder(bool deflate) : deflate_(deflate) {
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+            if (deflate_) {
+                failed_ = inflateInit(&stream_) != Z_OK;
+                output_.resize(64 * 1024);
+            }
+#else
+            failed_ = deflate_;
+#endif
+        }
+
+        ~PartDecoder() {
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+            if (deflate_) {
+                inflateEnd(&stream_);
+            }
+#endif
+        }
+
+        PartDecoder(const PartDecoder&) = delete;
+        PartDecoder& operator=(const PartDecoder&) = delete;
+
+        void Feed(const char* data, size_t size) {
+            if (!deflate_) {
+                Take(data, size);
+                return;
+            }
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+            stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            stream_.avail_in = static_cast<uInt>(size);
+            while (!failed_ && !finished_ && stream_.avail_in > 0) {
+                stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+                stream_.avail_out = static_cast<uInt>(output_.size());
+                const int result = inflate(&stream_, Z_NO_FLUSH);
+                failed_ = result != Z_OK && result != Z_STREAM_END;
+                finished_ = result == Z_STREAM_END;
+                Take(output_.data(), output_.size() - stream_.avail_out);
+            }
+            // Bytes after the end of the stream
+            failed_ = failed_ || stream_.avail_in > 0;
+#endif
+        }
+
+        /**
+         * @brief Whether the whole body decoded, call once it was received
+         */
+        [[nodiscard]]
+        bool IsValid() const noexcept { return !failed_ && (!deflate_ || finished_); }
+
+        [[nodiscard]]
+        uint64_t Bytes() const noexcept { return bytes_; }
+
+        [[nodiscard]]
+        uint32_t Checksum() const noexcept { return checksum_; }
+
+    private:
+        void Take(const char* data, size_t size) {
+            checksum_ = Crc32c::Update(checksum_, data, size);
+            bytes_ += size;
+        }
+
+        const bool deflate_;
+        bool failed_ = false;
+        bool finished_ = false;
+        uint64_t bytes_ = 0;
+        uint32_t checksum_ = 0;
+#ifdef L2CRASHSENDER_HAVE_ZLIB
+        z_stream stream_{};
+        std::vector<char> output_;
+#endif
+    };
+
+    /**
+     * @brief Faults and records shared by all connections
+     */
+    class IngestServer {
+    public:
+        explicit IngestServer(const ServerOptions& options)
+            : options_(options), random_(options.seed),
+              limiter_(options.bandwidth, false), started_(std::chrono::steady_clock::now()) {
+            log_ = options.log_path.empty() ? stdout : std::fopen(options.log_path.c_str(), "w");
+        }
+
+        ~IngestServer() {
+            if (log_ && log_ != stdout) {
+                std::fclose(log_);
+            }
+        }
+
+        int Run() {
+            if (!log_) {
+                std::fprintf(stderr, "Failed to open log file: %s\n", options_.log_path.c_str());
+                return 1;
+            }
+
+            const int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            const int reuse = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(options_.port);
+            if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(listener, SOMAXCONN) != 0) {
+                std::fprintf(stderr, "Failed to listen on 127.0.0.1:%u\n", options_.port);
+                return 1;
+            }
+            std::fprintf(stderr, "Mock ingest server listening on http://127.0.0.1:%u/\n", options_.port);
+
+            for (;;) {
+                const int client = accept(listener, nullptr, nullptr);
+                if (client < 0) {
+                    continue;
+                }
+                std::thread([this, client]() { Serve(client); }).detach();
+            }
+        }
+
+    private:
+        enum class Fault { None, Reset, Error };
+
+        /**
+         * @brief Outcome of the checksum check, None for requests without checksums
+         */
+        enum class Checksum { None, Ok, Mismatch };
+
+        /**
+         * @brief A part of a parted upload, stored until the upload is completed
+         */
+        struct StoredPart {
+            uint64_t size = 0;
+            uint32_t checksum = 0;
+        };
+
+        struct Request {
+            std::string method;
+            std::string target;
+            std::string boundary;    ///< Empty for bodies that are not multipart
+            bool deflate = false;    ///< Content-Encoding: deflate
+            uint64_t content_length = 0;
+            bool keep_alive = true;
+        };
+
+        /**
+         * @brief Read from the client, throttled by the shared bandwidth cap
+         */
+        ssize_t Receive(int client, char* buffer, size_t size) {
+            if (options_.bandwidth > 0) {
+                size = std::min(size, RateLimiter::kChunkSize);
+                limiter_.Acquire(size);
+            }
+            for (;;) {
+                const ssize_t received = recv(client, buffer, size, 0);
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                return received;
+            }
+        }
+
+        bool SendAll(int client, std::string_view data) {
+            while (!data.empty()) {
+                const ssize_t sent = send(client, data.data(), data.size(), MSG_NOSIGNAL);
+                if (sent <= 0) {
+                    return false;
+                }
+                data.remove_prefix(static_cast<size_t>(sent));
+            }
+            return true;
+        }
+
+        Fault RollFault() {
+            std::lock_guard lock(mutex_);
+            std::uniform_int_distribution<uint32_t> percent(0, 99);
+            if (percent(random_) < options_.reset_rate) {
+                return Fault::Reset;
+            }
+            if (percent(random_) < options_.error_rate) {
+                return Fault::Error;
+            }
+            return Fault::None;
+        }
+
+        bool ReadRequestHead(int client, std::string& buffer, Request& request) {
+            size_t end = std::string::npos;
+            char chunk[4096];
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                if (buffer.size() > MAX_HEADER_SIZE) {
+                    return false;
+                }
+                const ssize_t received = recv(client, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    return false;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+
+            const std::string_view head = std::string_view(buffer).substr(0, end);
+            const size_t method_end = head.find(' ');
+            const size_t target_end = head.find(' ', method_end + 1);
+            if (method_end == std::string_view::npos || target_end == std::string_view::npos) {
+                return false;
+            }
+            request.method = head.substr(0, method_end);
+            request.target = head.substr(method_end + 1, target_end - method_end - 1);
+            request.keep_alive = head.find("HTTP/1.0") == std::string_view::npos;
+
+            // Header names are matched case-insensitively
+            std::string lower(head);
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            const size_t length = lower.find("\r\ncontent-length:");
+            if (length != std::string::npos) {
+                request.content_length = std::strtoull(lower.c_str() + length + 17, nullptr, 10);
+            }
+            const size_t type = lower.find("\r\ncontent-type:");
+            if (type != std::string::npos) {
+                const size_t value = type + 15;
+                const std::string_view content_type = head.substr(value, lower.find("\r\n", value) - value);
+                (void)MultipartParser::BoundaryFromContentType(content_type, request.boundary);
+            }
+            const size_t encoding = lower.find("\r\ncontent-encoding:");
+            if (encoding != std::string::npos) {
+                request.deflate = lower.substr(encoding, lower.find("\r\n", encoding + 2) - encoding).find("deflate") != std::string::npos;
+            }
+            if (lower.find("\r\nconnection: close") != std::string::npos) {
+                request.keep_alive = false;
+            }
+
+            buffer.erase(0, end + 4);
+            return true;
+        }
+
+        void Serve(int client) {
+            const int nodelay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+            std::string buffer;
+            std::vector<char> chunk(1024 * 1024);
+            for (;;) {
+                Request request;
+                if (!ReadRequestHead(client, buffer, request)) {
+                    break;
+                }
+                const auto request_started = std::chrono::steady_clock::now();
+                const Fault fault = request.method == "HEAD" ? Fault::None : RollFault();
+                const uint64_t reset_after = options_.reset_after > 0 ? options_.reset_after : request.content_length / 2;
+
+                // Raw part uploads carry no multipart framing
+                const bool multipart = !request.boundary.empty() && request.content_length > 0;
+                ReportRecorder recorder;
+                MultipartParser parser(request.boundary, recorder);
+                std::string parse_error;
+                bool parsed = true;
+
+                uint64_t received_total = 0;
+                PartDecoder decoder(request.deflate && !multipart);
+                bool reset = false;
+                const auto take = [&](const char* data, size_t size) {
+                    if (multipart && parsed) {
+                        parsed = parser.Feed(data, size, parse_error);
+                    } else if (!multipart) {
+                        decoder.Feed(data, size);
+                    }
+                    received_total += size;
+                };
+
+                const size_t buffered = static_cast<size_t>(std::min<uint64_t>(buffer.size(), request.content_length));
+                take(buffer.data(), buffered);
+                buffer.erase(0, buffered);
+
+                while (received_total < request.content_length) {
+                    if (fault == Fault::Reset && received_total >= reset_after) {
+                        reset = true;
+                        break;
+                    }
+                    uint64_t wanted = std::min<uint64_t>(request.content_length - received_total, chunk.size());
+                    if (fault == Fault::Reset) {
+                        wanted = std::min(wanted, std::max<uint64_t>(reset_after - received_total, 1));
+                    }
+                    const ssize_t received = Receive(client, chunk.data(), static_cast<size_t>(wanted));
+                    if (received <= 0) {
+                        break;
+                    }
+                    take(chunk.data(), static_cast<size_t>(received));
+                }
+                const auto body_received = std::chrono::steady_clock::now();
+
+                uint32_t status = 0;
+                std::string response_body;
+                Checksum checksum = Checksum::None;
+                if (reset || (fault == Fault::Reset && received_total >= reset_after)) {
+                    reset = true;
+                } else if (received_total < request.content_length) {
+                    // Client went away
+                } else if (fault == Fault::Error) {
+                    status = options_.error_status;
+                    response_body = "injected error";
+                } else if (multipart && !parser.IsComplete()) {
+                    status = 400;
+                    response_body = parsed ? "truncated multipart body" : parse_error;
+                } else if (!multipart && !decoder.IsValid()) {
+                    status = 400;
+                    response_body = "undecodable part body";
+                } else if ((checksum = VerifyChecksums(request, recorder, decoder, response_body)) == Checksum::Mismatch) {
+                    status = 400;
+                } else {
+                    status = 200;
+                    response_body = request.target.find("action=create") != std::string::npos
+                        ? std::to_string(next_report_id_.fetch_add(1)) : "ok";
+                }
+
+                bool open = !reset && status != 0;
+                if (open) {
+                    if (options_.latency_ms > 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(options_.latency_ms));
+                    }
+                    open = Respond(client, request, status, response_body) && request.keep_alive;
+                }
+
+                Record(request, fault, status, received_total, request_started, body_received, recorder, multipart, checksum);
+                if (reset) {
+                    // Zero linger turns the close into a RST
+                    linger abort{ 1, 0 };
+                    setsockopt(client, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+                }
+                if (!open) {
+                    break;
+                }
+            }
+            close(client);
+        }
+
+        /**
+         * @brief Check the checksums of a fully received request
+         *
+         * Parts are only stored, the complete request checks all of them at once.
+         */
+        Checksum VerifyChecksums(const Request& request, const ReportRecorder& recorder, const PartDecoder& decoder,
+                                 std::string& error_message) {
+            const std::string action = QueryValue(request.target, "action");
+            const std::string report = QueryValue(request.target, "report");
+            if (action == "part") {
+                std::lock_guard lock(mutex_);
+                parts_[report][QueryValue(request.target, "name") + "\t" + QueryValue(request.target, "offset")] =
+                    StoredPart{ decoder.Bytes(), decoder.Checksum() };
+                return Checksum::None;
+            }
+
+            const auto field = recorder.Fields().find("checksums");
+            if (field == recorder.Fields().end()) {
+                return Checksum::None;
+            }
+
+            if (action == "complete") {
+                std::lock_guard lock(mutex_);
+                const auto stored = parts_.find(report);
+                if (stored == parts_.end()) {
+                    error_message = "checksum mismatch: no parts of report " + report;
+                    return Checksum::Mismatch;
+                }
+                for (const auto& columns : SplitChecksums(field->second)) {
+                    if (columns.size() != 4) {
+                        error_message = "checksum mismatch: malformed line";
+                        return Checksum::Mismatch;
+                    }
+                    const auto part = stored->second.find(columns[0] + "\t" + columns[1]);
+                    if (part == stored->second.end() || std::to_string(part->second.size) != columns[2] ||
+                        Crc32c::ToHex(part->second.checksum) != columns[3]) {
+                        error_message = "checksum mismatch: " + columns[0] + " at " + columns[1];
+                        return Checksum::Mismatch;
+                    }
+                }
+                parts_.erase(stored);
+                return Checksum::Ok;
+            }
+
+            for (const auto& columns : SplitChecksums(field->second)) {
+                if (columns.size() != 2) {
+                    error_message = "checksum mismatch: malformed line";
+                    return Checksum::Mismatch;
+                }
+                const auto file = std::find_if(recorder.Files().begin(), recorder.Files().end(), [&](const auto& candidate) {
+                    return candidate.name == columns[0];
+                });
+                if (file == recorder.Files().end() || Crc32c::ToHex(file->checksum) != columns[1]) {
+                    error_message = "checksum mismatch: " + columns[0];
+                    return Checksum::Mismatch;
+                }
+            }
+            return Checksum::Ok;
+        }
+
+        bool Respond(int client, const Request& request, uint32_t status, const std::string& body) {
+            const char* reason = status == 200 ? "OK" : status == 400 ? "Bad Request" : "Service Unavailable";
+            std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" +
+                                   "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                                   (request.keep_alive ? "" : "Connection: close\r\n") + "\r\n";
+            if (request.method != "HEAD") {
+                response += body;
+            }
+
+            if (options_.slow_response_ms == 0) {
+                return SendAll(client, response);
+            }
+
+            // One byte at a time spread over the configured time
+            const auto pause = std::chrono::microseconds(options_.slow_response_ms * 1000ull / response.size());
+            for (const char c : response) {
+                if (!SendAll(client, std::string_view(&c, 1))) {
+                    return false;
+                }
+                std::this_thread::sleep_for(pause);
+            }
+            return true;
+        }
+
+        void Record(const Request& request, Fault fault, uint32_t status, uint64_t body_bytes,
+                    std::chrono::steady_clock::time_point request_started, std::chrono::steady_clock::time_point body_received,
+                    const ReportRecorder& recorder, bool multipart, Checksum checksum) {
+            using Milliseconds = std::chrono::duration<double, std::milli>;
+            const auto now = std::chrono::steady_clock::now();
+            const double receive_ms = Milliseconds(body_received - request_started).count();
+            const double total_ms = Milliseconds(now - request_started).count();
+
+            std::string record = "{\"id\":" + std::to_string(next_request_id_.fetch_add(1)) +
+                ",\"at_ms\":" + std::to_string(static_cast<uint64_t>(Milliseconds(request_started - started_).count())) +
+                ",\"method\":\"" + EscapeJson(request.method) + "\",\"target\":\"" + EscapeJson(request.target) + "\"" +
+                ",\"status\":" + std::to_string(status) +
+                ",\"fault\":\"" + (fault == Fault::Reset ? "reset" : fault == Fault::Error ? "error" : "none") + "\"" +
+                ",\"content_length\":" + std::to_string(request.content_length) +
+                ",\"body_bytes\":" + std::to_string(body_bytes) +
+                ",\"receive_ms\":" + std::to_string(receive_ms) +
+                ",\"total_ms\":" + std::to_string(total_ms) +
+                ",\"bytes_per_second\":" + std::to_string(receive_ms > 0 ? static_cast<uint64_t>(body_bytes / receive_ms * 1000) : 0) +
+                ",\"checksum\":\"" + (checksum == Checksum::Ok ? "ok" : checksum == Checksum::Mismatch ? "mismatch" : "none") + "\"";
+
+            if (multipart) {
+                record += ",\"fields\":{";
+                bool first = true;
+                for (const auto& [name, value] : recorder.Fields()) {
+                    record += (first ? "\"" : ",\"") + EscapeJson(name) + "\":\"" + EscapeJson(value.substr(0, 256)) + "\"";
+                    first = false;
+                }
+                record += "},\"files\":[";
+                first = true;
+                for (const auto& file : recorder.Files()) {
+                    record += std::string(first ? "" : ",") + "{\"name\":\"" + EscapeJson(file.name) +
+                              "\",\"filename\":\"" + EscapeJson(file.filename) + "\",\"bytes\":" + std::to_string(file.bytes) + "}";
+                    first = false;
+                }
+                record += "]";
+            }
+            record += "}\n";
+
+            std::lock_guard lock(mutex_);
+            std::fputs(record.c_str(), log_);
+            std::fflush(log_);
+        }
+
+        const ServerOptions options_;
+        std::mutex mutex_;
+        std::mt19937 random_;
+        RateLimiter limiter_;
+        std::FILE* log_ = nullptr;
+        const std::chrono::steady_clock::time_point started_;
+        std::atomic<uint64_t> next_request_id_{ 1 };
+        std::atomic<uint64_t> next_report_id_{ 1 };
+        std::map<std::string, std::map<std::string, StoredPart>> parts_;  ///< By report id, then "name<TAB>offset"
+    };
+
+} // anonymous namespace
+
+} // namespace CrashSender
+
+int main(int argc, char* argv[]) {
+    CrashSender::ServerOptions options;
+    if (!CrashSender::ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    CrashSender::IngestServer server(options);
+    return server.Run();
+}
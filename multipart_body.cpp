@@ -0,0 +1,91 @@
+#include "utils.h"
+#include "crc32c.h"
+#include "multipart_body.h"
+
+namespace CrashSender {
+
+void MultipartBody::Clear() noexcept {
+    segments_.clear();
+    arena_.Reset();
+    total_size_ = 0;
+}
+
+void MultipartBody::Reserve(size_t segment_count) {
+    segments_.reserve(segment_count);
+}
+
+void MultipartBody::AppendString(std::string_view str) {
+    if (str.empty()) {
+        return;
+    }
+    AppendStored(arena_.Store(str));
+}
+
+void MultipartBody::AppendString(std::wstring_view wstr) {
+    if (wstr.empty()) {
+        return;
+    }
+    AppendStored(arena_.StoreUtf8(wstr));
+}
+
+void MultipartBody::AppendFile(std::wstring_view path, uint64_t offset, uint64_t size) {
+    BodySegment segment;
+    segment.kind = BodySegment::Kind::File;
+    segment.path = arena_.StoreWide(path);
+    segment.offset = offset;
+    segment.size = size;
+
+    segments_.push_back(segment);
+    total_size_ += size;
+}
+
+void MultipartBody::AppendExternal(std::string_view bytes) {
+    if (bytes.empty()) {
+        return;
+    }
+
+    BodySegment segment;
+    segment.bytes = bytes;
+    segment.size = bytes.size();
+
+    segments_.push_back(segment);
+    total_size_ += bytes.size();
+}
+
+void MultipartBody::AppendChecksum(std::wstring_view path, uint64_t offset) {
+    BodySegment segment;
+    segment.kind = BodySegment::Kind::Checksum;
+    segment.offset = offset;
+    segment.size = Crc32c::kHexSize;
+
+    // The file was appended before, its stored path is shared
+    for (auto it = segments_.rbegin(); it != segments_.rend() && segment.path.empty(); ++it) {
+        if (it->kind == BodySegment::Kind::File && it->path == path) {
+            segment.path = it->path;
+        }
+    }
+    if (segment.path.empty()) {
+        segment.path = arena_.StoreWide(path);
+    }
+
+    segments_.push_back(segment);
+    total_size_ += Crc32c::kHexSize;
+}
+
+void MultipartBody::AppendStored(std::string_view stored) {
+    // Coalesce adjacent in-memory pieces into one segment
+    if (!segments_.empty() && segments_.back().kind == BodySegment::Kind::Memory &&
+        segments_.back().bytes.data() + segments_.back().bytes.size() == stored.data()) {
+        BodySegment& segment = segments_.back();
+        segment.bytes = std::string_view(segment.bytes.data(), segment.bytes.size() + stored.size());
+        segment.size = segment.bytes.size();
+    } else {
+        BodySegment segment;
+        segment.bytes = stored;
+        segment.size = stored.size();
+        segments_.push_back(segment);
+    }
+    total_size_ += stored.size();
+}
+
+} // namespace CrashSender
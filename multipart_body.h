@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "report_arena.h"
+
+namespace CrashSender {
+
+/**
+ * @brief One contiguous piece of a multipart request body
+ */
+struct BodySegment {
+    enum class Kind : int {
+        Memory = 0,  ///< Bytes are held in `bytes`
+        File = 1,    ///< Bytes are streamed from `path`
+        Checksum = 2 ///< CRC32C of the File segments of `path` at `offset` sent before, as hex digits filled in while sending
+    };
+
+    Kind kind{Kind::Memory};
+    std::string_view bytes{}; ///< In-memory payload (Memory segments), held by the body or by the caller
+    std::wstring_view path{}; ///< File to stream from (File segments), or whose checksum is sent (Checksum segments), held by the body
+    uint64_t offset{0};    ///< First file byte of the segment (File segments), or of the checksummed file (Checksum segments)
+    uint64_t size{0};      ///< Segment size in bytes
+};
+
+/**
+ * @brief File attached to a crash report
+ */
+struct Attachment {
+    std::string name{};      ///< Form field name
+    std::wstring filename{}; ///< File name reported to the server
+    std::wstring path{};     ///< Path the data is read from
+    uint64_t offset{0};      ///< First byte of the file in `path`, set for files inside a report archive
+    uint64_t size{0};        ///< File size in bytes
+};
+
+/**
+ * @brief Multipart request body described as a list of segments
+ *
+ * Small header fields are kept in memory, attachments are only referenced
+ * by path and size so they can be streamed instead of loaded at once. Text
+ * and paths are copied into an arena owned by the body, wide text is
+ * converted to UTF-8 on the way in, so building a body allocates a constant
+ * number of times however many pieces it has.
+ */
+class MultipartBody {
+public:
+    MultipartBody() noexcept = default;
+
+    // Non-copyable, movable
+    MultipartBody(const MultipartBody&) = delete;
+    MultipartBody& operator=(const MultipartBody&) = delete;
+    MultipartBody(MultipartBody&&) noexcept = default;
+    MultipartBody& operator=(MultipartBody&&) noexcept = default;
+
+    void Clear() noexcept;
+
+    /**
+     * @brief Make room for a number of segments up front
+     */
+    void Reserve(size_t segment_count);
+
+    void AppendString(std::string_view str);
+    void AppendString(std::wstring_view wstr);
+    void AppendFile(std::wstring_view path, uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Send bytes owned by the caller without copying them, they must outlive the body
+     */
+    void AppendExternal(std::string_view bytes);
+
+    /**
+     * @brief Reserve room for the checksum of a file appended earlier, its value is only known once the file was sent
+     * @param offset Offset the file was appended with, files of one archive share their path
+     */
+    void AppendChecksum(std::wstring_view path, uint64_t offset);
+
+    [[nodiscard]]
+    uint64_t TotalSize() const noexcept { return total_size_; }
+
+    [[nodiscard]]
+    const std::vector<BodySegment>& Segments() const noexcept { return segments_; }
+
+private:
+    /**
+     * @brief Add bytes stored in the arena, joined with the previous piece when they follow it in memory
+     */
+    void AppendStored(std::string_view stored);
+
+    ReportArena arena_;
+    std::vector<BodySegment> segments_;
+    uint64_t total_size_{0};
+};
+
+} // namespace CrashSender
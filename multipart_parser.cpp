@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CRASHSENDER_MULTIPART_SSE2 1
+#endif
+
+#include "utils.h"
+#include "multipart_parser.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr std::string_view CRLF = "\r\n";
+    constexpr std::string_view HEADERS_END = "\r\n\r\n";
+
+    bool EqualsIgnoreCase(std::string_view left, std::string_view right) noexcept {
+        return left.size() == right.size() &&
+               std::equal(left.begin(), left.end(), right.begin(), [](unsigned char a, unsigned char b) {
+                   return std::tolower(a) == std::tolower(b);
+               });
+    }
+
+    std::string_view Trim(std::string_view text) noexcept {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    /**
+     * @brief Value of a `key=value` or `key="value"` parameter of a header value
+     */
+    bool HeaderParameter(std::string_view value, std::string_view key, std::string& output) {
+        size_t start = 0;
+        while (start < value.size()) {
+            const size_t end = std::min(value.find(';', start), value.size());
+            const std::string_view parameter = Trim(value.substr(start, end - start));
+            start = end + 1;
+
+            const size_t separator = parameter.find('=');
+            if (separator == std::string_view::npos || !EqualsIgnoreCase(Trim(parameter.substr(0, separator)), key)) {
+                continue;
+            }
+
+            std::string_view result = Trim(parameter.substr(separator + 1));
+            if (result.size() >= 2 && result.front() == '"' && result.back() == '"') {
+                result = result.substr(1, result.size() - 2);
+            }
+            output = result;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Field names become file names, so only a safe subset is accepted
+     */
+    bool IsSafeFileName(std::string_view name) noexcept {
+        return !name.empty() && name != "." && name != ".." &&
+               std::all_of(name.begin(), name.end(), [](unsigned char c) {
+                   return std::isalnum(c) || c == '_' || c == '-' || c == '.';
+               });
+    }
+
+} // anonymous namespace
+
+MultipartParser::MultipartParser(std::string_view boundary, MultipartHandler& handler)
+    : delimiter_("--" + std::string(boundary)), handler_(handler) {
+}
+
+bool MultipartParser::Feed(const char* data, size_t size, std::string& error_message) noexcept {
+    if (state_ == State::Failed) {
+        error_message = "Multipart parser stopped on an earlier error";
+        return false;
+    }
+
+    try {
+        std::string_view input(data, size);
+        while (!input.empty() && state_ != State::Done) {
+            bool parsed = false;
+            switch (state_) {
+            case State::Preamble:
+            case State::Data:
+                parsed = ScanData(input, error_message);
+                break;
+            case State::Delimiter:
+                parsed = ScanDelimiter(input, error_message);
+                break;
+            case State::Headers:
+                parsed = ScanHeaders(input, error_message);
+                break;
+            default:
+                break;
+            }
+
+            if (!parsed) {
+                state_ = State::Failed;
+                return false;
+            }
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while parsing multipart body: " + std::string(e.what());
+        state_ = State::Failed;
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while parsing multipart body";
+        state_ = State::Failed;
+        return false;
+    }
+}
+
+bool MultipartParser::ScanData(std::string_view& input, std::string& error_message) {
+    // Held back: a delimiter cut off at the chunk end, and the CRLF in front of it
+    const size_t hold = delimiter_.size() + 1;
+
+    if (!carry_.empty()) {
+        // The window covers every delimiter starting in the carry or in the first two input bytes
+        const size_t take = std::min(input.size(), delimiter_.size() + CRLF.size());
+        std::string& window = window_;
+        window.assign(carry_).append(input.substr(0, take));
+
+        const size_t found = Find(window, delimiter_);
+        if (found != std::string_view::npos) {
+            if (!Emit(BeforeDelimiter(window, found), error_message)) {
+                return false;
+            }
+            input.remove_prefix(std::min(input.size(), found + delimiter_.size() - std::min(found + delimiter_.size(), carry_.size())));
+            carry_.clear();
+            state_ = State::Delimiter;
+            return true;
+        }
+
+        if (take == input.size()) {
+            const size_t emit = window.size() > hold ? window.size() - hold : 0;
+            if (!Emit(std::string_view(window).substr(0, emit), error_message)) {
+                return false;
+            }
+            carry_.assign(window, emit);
+            input = {};
+            return true;
+        }
+
+        if (!Emit(carry_, error_message)) {
+            return false;
+        }
+        carry_.clear();
+    }
+
+    const size_t found = Find(input, delimiter_);
+    if (found != std::string_view::npos) {
+        if (!Emit(BeforeDelimiter(input, found), error_message)) {
+            return false;
+        }
+        input.remove_prefix(found + delimiter_.size());
+        state_ = State::Delimiter;
+        return true;
+    }
+
+    const size_t keep = std::min(input.size(), hold);
+    if (!Emit(input.substr(0, input.size() - keep), error_message)) {
+        return false;
+    }
+    carry_.assign(input.substr(input.size() - keep));
+    input = {};
+    return true;
+}
+
+bool MultipartParser::ScanDelimiter(std::string_view& input, std::string& error_message) {
+    // Two bytes tell the closing delimiter from the next part
+    while (carry_.size() < 2 && !input.empty()) {
+        carry_.push_back(input.front());
+        input.remove_prefix(1);
+    }
+    if (carry_.size() < 2) {
+        return true;
+    }
+
+    const bool closing = carry_ == "--";
+    if (!closing && carry_ != CRLF) {
+        error_message = "Malformed multipart delimiter";
+        return false;
+    }
+    carry_.clear();
+
+    if (in_part_) {
+        in_part_ = false;
+        if (!handler_.OnPartEnd()) {
+            error_message = "Multipart handler failed to finish part " + name_;
+            return false;
+        }
+    }
+
+    if (closing) {
+        // Epilogue is ignored
+        state_ = State::Done;
+        input = {};
+        return true;
+    }
+
+    // Leading CRLF lets the header search treat the first line like the others
+    headers_.assign(CRLF);
+    state_ = State::Headers;
+    return true;
+}
+
+bool MultipartParser::ScanHeaders(std::string_view& input, std::string& error_message) {
+    const size_t previous = headers_.size();
+    headers_.append(input.substr(0, std::min(input.size(), kMaxHeaderSize + HEADERS_END.size() - previous)));
+
+    // Headers start with the CRLF put in front, so an empty block is found at offset 0
+    const size_t end = headers_.find(HEADERS_END, previous >= 3 ? previous - 3 : 0);
+    if (end == std::string::npos) {
+        if (headers_.size() > kMaxHeaderSize) {
+            error_message = "Multipart part headers are too large";
+            return false;
+        }
+        input = {};
+        return true;
+    }
+    input.remove_prefix(end + HEADERS_END.size() - previous);
+
+    name_.clear();
+    filename_.clear();
+    content_type_.clear();
+
+    std::string_view block = end > CRLF.size() ? std::string_view(headers_).substr(CRLF.size(), end - CRLF.size())
+                                               : std::string_view{};
+    while (!block.empty()) {
+        const size_t line_end = std::min(block.find(CRLF), block.size());
+        const std::string_view line = block.substr(0, line_end);
+        block.remove_prefix(std::min(block.size(), line_end + CRLF.size()));
+
+        const size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        const std::string_view header = Trim(line.substr(0, colon));
+        const std::string_view value = Trim(line.substr(colon + 1));
+        if (EqualsIgnoreCase(header, "Content-Disposition")) {
+            (void)HeaderParameter(value, "name", name_);
+            (void)HeaderParameter(value, "filename", filename_);
+        } else if (EqualsIgnoreCase(header, "Content-Type")) {
+            content_type_ = value;
+        }
+    }
+    headers_.clear();
+
+    state_ = State::Data;
+    in_part_ = true;
+    if (!handler_.OnPartBegin(MultipartPart{ name_, filename_, content_type_ })) {
+        error_message = "Multipart handler rejected part " + name_;
+        return false;
+    }
+    return true;
+}
+
+bool MultipartParser::Emit(std::string_view data, std::string& error_message) {
+    if (!in_part_ || data.empty()) {
+        return true;
+    }
+    if (!handler_.OnPartData(data)) {
+        error_message = "Multipart handler failed to store part " + name_;
+        return false;
+    }
+    return true;
+}
+
+std::string_view MultipartParser::BeforeDelimiter(std::string_view data, size_t offset) noexcept {
+    data = data.substr(0, offset);
+    if (data.ends_with(CRLF)) {
+        data.remove_suffix(CRLF.size());
+    }
+    return data;
+}
+
+bool MultipartParser::BoundaryFromContentType(std::string_view content_type, std::string& boundary) {
+    const size_t separator = content_type.find(';');
+    if (separator == std::string_view::npos ||
+        !EqualsIgnoreCase(Trim(content_type.substr(0, separator)), "multipart/form-data")) {
+        return false;
+    }
+    return HeaderParameter(content_type.substr(separator + 1), "boundary", boundary) && !boundary.empty();
+}
+
+size_t MultipartParser::Find(std::string_view haystack, std::string_view needle) noexcept {
+    if (needle.empty()) {
+        return 0;
+    }
+    if (haystack.size() < needle.size()) {
+        return std::string_view::npos;
+    }
+
+    size_t offset = 0;
+#ifdef CRASHSENDER_MULTIPART_SSE2
+    // Candidates match the first and the last needle byte, 64 positions are checked per step
+    constexpr size_t kBlock = 16;
+    constexpr size_t kStep = 4 * kBlock;
+    const size_t last = needle.size() - 1;
+    const __m128i first_byte = _mm_set1_epi8(needle.front());
+    const __m128i last_byte = _mm_set1_epi8(needle.back());
+    const auto candidates = [&](size_t position) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + position));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + position + last));
+        return _mm_and_si128(_mm_cmpeq_epi8(head, first_byte), _mm_cmpeq_epi8(tail, last_byte));
+    };
+
+    for (; offset + last + kStep <= haystack.size(); offset += kStep) {
+        const __m128i block0 = candidates(offset);
+        const __m128i block1 = candidates(offset + kBlock);
+        const __m128i block2 = candidates(offset + 2 * kBlock);
+        const __m128i block3 = candidates(offset + 3 * kBlock);
+        const __m128i any = _mm_or_si128(_mm_or_si128(block0, block1), _mm_or_si128(block2, block3));
+        if (_mm_movemask_epi8(any) == 0) {
+            continue;
+        }
+
+        uint64_t mask = static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(block0))) |
+                        static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(block1))) << 16 |
+                        static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(block2))) << 32 |
+                        static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(block3))) << 48;
+        while (mask != 0) {
+            const size_t candidate = offset + static_cast<size_t>(std::countr_zero(mask));
+            if (std::memcmp(haystack.data() + candidate, needle.data(), needle.size()) == 0) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Remainder, and the whole search without SIMD
+    const size_t found = haystack.substr(offset).find(needle);
+    return found == std::string_view::npos ? found : offset + found;
+}
+
+MultipartFileSink::MultipartFileSink(std::wstring directory) : directory_(std::move(directory)) {
+}
+
+bool MultipartFileSink::OnPartBegin(const MultipartPart& part) noexcept {
+    try {
+        if (!part.IsFile()) {
+            field_ = &fields_[std::string(part.name)];
+            field_->clear();
+            return true;
+        }
+
+        if (!IsSafeFileName(part.name) || files_.contains(std::string(part.name))) {
+            return false;
+        }
+
+        File& file = files_[std::string(part.name)];
+        file.filename = part.filename;
+        file.path = (std::filesystem::path(directory_) / TextUtils::Utf8ToWide(part.name)).wstring();
+        if (!FileSystem::CreateWrite(file.path, output_)) {
+            return false;
+        }
+        file_ = &file;
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool MultipartFileSink::OnPartData(std::string_view data) noexcept {
+    try {
+        if (file_) {
+            file_->size += data.size();
+            return FileSystem::Write(output_, data.data(), data.size());
+        }
+        if (field_) {
+            field_->append(data.substr(0, kMaxFieldSize - std::min(kMaxFieldSize, field_->size())));
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool MultipartFileSink::OnPartEnd() noexcept {
+    output_.Close();
+    file_ = nullptr;
+    field_ = nullptr;
+    return true;
+}
+
+} // namespace CrashSender
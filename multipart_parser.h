@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "file_system.h"
+
+namespace CrashSender {
+
+/**
+ * @brief Headers of one part of a multipart body
+ */
+struct MultipartPart {
+    std::string_view name;           ///< Form field name
+    std::string_view filename;       ///< File name, empty for plain fields
+    std::string_view content_type;   ///< Content-Type of the part, may be empty
+
+    [[nodiscard]]
+    bool IsFile() const noexcept { return !filename.empty(); }
+};
+
+/**
+ * @brief Receives the parts of a multipart body as they are parsed
+ *
+ * Returning false from any callback stops the parser with an error.
+ */
+class MultipartHandler {
+public:
+    virtual ~MultipartHandler() = default;
+
+    [[nodiscard]]
+    virtual bool OnPartBegin(const MultipartPart& part) noexcept = 0;
+
+    /**
+     * @brief Next bytes of the current part, a part usually arrives in many calls
+     */
+    [[nodiscard]]
+    virtual bool OnPartData(std::string_view data) noexcept = 0;
+
+    [[nodiscard]]
+    virtual bool OnPartEnd() noexcept = 0;
+};
+
+/**
+ * @brief Push parser of multipart/form-data bodies, the receiving side of CreateMultipartFormData
+ *
+ * The body is fed in chunks of any size as it comes off the wire. Part data
+ * is handed to the handler straight from the fed chunks, only a tail shorter
+ * than two delimiters is held back between calls, so memory does not grow
+ * with the body.
+ *
+ * A part ends at the next `--boundary`. A CRLF in front of it belongs to the
+ * delimiter, as in RFC 2046, but may be missing: the sender starts the part
+ * after a file right after the file bytes.
+ */
+class MultipartParser {
+public:
+    static constexpr size_t kMaxHeaderSize = 16 * 1024;
+
+    /**
+     * @param boundary Boundary as given in the Content-Type header, without the leading dashes
+     * @param handler Receives the parts, must outlive the parser
+     */
+    MultipartParser(std::string_view boundary, MultipartHandler& handler);
+
+    /**
+     * @brief Parse the next chunk of the body
+     * @return false on a malformed body or when the handler stopped, the parser stays failed
+     */
+    [[nodiscard]]
+    bool Feed(const char* data, size_t size, std::string& error_message) noexcept;
+
+    /**
+     * @brief Whether the closing delimiter was seen, bytes after it are ignored
+     */
+    [[nodiscard]]
+    bool IsComplete() const noexcept { return state_ == State::Done; }
+
+    /**
+     * @brief Extract the boundary parameter of a multipart Content-Type header value
+     */
+    [[nodiscard]]
+    static bool BoundaryFromContentType(std::string_view content_type, std::string& boundary);
+
+    /**
+     * @brief Position of the first occurrence of needle in haystack, SIMD-accelerated where available
+     * @return Offset of the match or std::string_view::npos
+     */
+    [[nodiscard]]
+    static size_t Find(std::string_view haystack, std::string_view needle) noexcept;
+
+private:
+    enum class State : int {
+        Preamble = 0,   ///< Bytes before the first delimiter, discarded
+        Data = 1,       ///< Bytes of a part
+        Delimiter = 2,  ///< Right after a delimiter, "\r\n" or "--" follows
+        Headers = 3,    ///< Part headers up to the empty line
+        Done = 4,       ///< Closing delimiter seen
+        Failed = 5
+    };
+
+    bool ScanData(std::string_view& input, std::string& error_message);
+    bool ScanDelimiter(std::string_view& input, std::string& error_message);
+    bool ScanHeaders(std::string_view& input, std::string& error_message);
+
+    /**
+     * @brief Pass part bytes to the handler, dropped before the first part
+     */
+    bool Emit(std::string_view data, std::string& error_message);
+
+    /**
+     * @brief Bytes before a delimiter found at the given offset, without the CRLF that belongs to it
+     */
+    static std::string_view BeforeDelimiter(std::string_view data, size_t offset) noexcept;
+
+    const std::string delimiter_;   ///< "--" and the boundary
+    MultipartHandler& handler_;
+    State state_ = State::Preamble;
+    bool in_part_ = false;  ///< Headers of a part were seen and its end was not
+    std::string carry_;     ///< Tail of the last chunk that may start a delimiter
+    std::string window_;    ///< Carry joined with the start of the next chunk
+    std::string headers_;   ///< Headers of the next part while they arrive
+
+    // Parsed headers of the current part, MultipartPart points into them
+    std::string name_;
+    std::string filename_;
+    std::string content_type_;
+};
+
+/**
+ * @brief Handler that keeps plain fields in memory and writes files to a directory
+ *
+ * Files are stored under their form field name, so a file name sent by a
+ * client never becomes a path. Field values are capped at kMaxFieldSize.
+ */
+class MultipartFileSink : public MultipartHandler {
+public:
+    static constexpr size_t kMaxFieldSize = 64 * 1024;
+
+    struct File {
+        std::string filename;   ///< File name sent by the client
+        std::wstring path;      ///< Where the bytes were written
+        uint64_t size = 0;
+    };
+
+    /**
+     * @param directory Existing directory receiving the files
+     */
+    explicit MultipartFileSink(std::wstring directory);
+
+    bool OnPartBegin(const MultipartPart& part) noexcept override;
+    bool OnPartData(std::string_view data) noexcept override;
+    bool OnPartEnd() noexcept override;
+
+    [[nodiscard]]
+    const std::map<std::string, std::string>& Fields() const noexcept { return fields_; }
+
+    [[nodiscard]]
+    const std::map<std::string, File>& Files() const noexcept { return files_; }
+
+private:
+    const std::wstring directory_;
+    std::map<std::string, std::string> fields_;
+    std::map<std::string, File> files_;
+    std::string* field_ = nullptr;
+    File* file_ = nullptr;
+    FileHandle output_;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <thread>
+
+#include "logger.h"
+#include "rate_limiter.h"
+
+namespace CrashSender {
+
+RateLimiter::RateLimiter(uint64_t bytes_per_second, bool adaptive) noexcept
+    : max_rate_(bytes_per_second > 0 ? std::max(bytes_per_second, kMinRate) : kUnlimitedRate),
+      adaptive_(adaptive),
+      rate_(max_rate_),
+      tokens_(static_cast<double>(kChunkSize)),
+      last_refill_(Clock::now()),
+      last_adjust_(last_refill_) {
+}
+
+void RateLimiter::Acquire(size_t bytes) noexcept {
+    std::chrono::duration<double> wait{ 0.0 };
+    {
+        std::lock_guard lock(mutex_);
+
+        const auto now = Clock::now();
+        const std::chrono::duration<double> elapsed = now - last_refill_;
+        last_refill_ = now;
+
+        // Bucket depth of one chunk keeps bursts small
+        tokens_ = std::min(tokens_ + elapsed.count() * static_cast<double>(rate_), static_cast<double>(kChunkSize));
+        tokens_ -= static_cast<double>(bytes);
+
+        // A negative balance is paid off by sleeping, other threads queue up behind it
+        if (tokens_ < 0.0) {
+            wait = std::chrono::duration<double>(-tokens_ / static_cast<double>(rate_));
+        }
+    }
+
+    if (wait.count() > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration_cast<std::chrono::microseconds>(wait));
+    }
+}
+
+void RateLimiter::ReportLatency(std::chrono::microseconds latency) noexcept {
+    if (!adaptive_) {
+        return;
+    }
+
+    uint64_t new_rate = 0;
+    {
+        std::lock_guard lock(mutex_);
+
+        base_latency_ = std::min(base_latency_, latency);
+
+        const auto now = Clock::now();
+        if (now - last_adjust_ < kAdjustInterval) {
+            return;
+        }
+        last_adjust_ = now;
+
+        const auto queue_delay = latency - base_latency_;
+        if (queue_delay > kTargetQueueDelay) {
+            // Multiplicative decrease while the uplink queue grows
+            rate_ = std::max(kMinRate, rate_ / 4 * 3);
+        }
+        else if (rate_ < max_rate_) {
+            // Gentle increase once the queue drained
+            rate_ = std::min(max_rate_, rate_ + std::max<uint64_t>(rate_ / 16, kMinRate / 4));
+        }
+        else {
+            return;
+        }
+        new_rate = rate_;
+    }
+
+    Logger::LogDebug("Upload rate adjusted to " + std::to_string(new_rate / 1024) + " KB/s");
+}
+
+uint64_t RateLimiter::CurrentRate() const noexcept {
+    std::lock_guard lock(mutex_);
+    return rate_;
+}
+
+} // namespace CrashSender
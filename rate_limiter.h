@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace CrashSender {
+
+/**
+ * @brief Token bucket limiting the upload rate of all connections of a report
+ *
+ * In adaptive mode the rate backs off when the measured latency of writes
+ * rises above the lowest latency seen so far, i.e. when a queue builds up on
+ * the uplink, and slowly grows back to the configured cap once it drains.
+ */
+class RateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kChunkSize = 64 * 1024;             ///< Largest write granted at once
+    static constexpr uint64_t kMinRate = 32 * 1024;             ///< Adaptive mode never goes below this
+    static constexpr uint64_t kUnlimitedRate = 1024ull << 20;   ///< Adaptive ceiling without an explicit cap
+
+    /**
+     * @param bytes_per_second Rate cap, 0 for no cap
+     * @param adaptive Back off on rising latency
+     */
+    RateLimiter(uint64_t bytes_per_second, bool adaptive) noexcept;
+
+    // Non-copyable, non-movable
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+    RateLimiter(RateLimiter&&) = delete;
+    RateLimiter& operator=(RateLimiter&&) = delete;
+
+    /**
+     * @brief Block until `bytes` may be sent
+     * @param bytes Number of bytes, at most kChunkSize
+     */
+    void Acquire(size_t bytes) noexcept;
+
+    /**
+     * @brief Feed a latency sample of a completed write, used in adaptive mode
+     * @param latency Time the write of one chunk took
+     */
+    void ReportLatency(std::chrono::microseconds latency) noexcept;
+
+    [[nodiscard]]
+    bool IsAdaptive() const noexcept { return adaptive_; }
+
+    [[nodiscard]]
+    uint64_t CurrentRate() const noexcept;
+
+private:
+    static constexpr std::chrono::microseconds kTargetQueueDelay{ 50'000 };
+    static constexpr std::chrono::milliseconds kAdjustInterval{ 200 };
+
+    mutable std::mutex mutex_;
+    const uint64_t max_rate_;
+    const bool adaptive_;
+    uint64_t rate_;
+    double tokens_;
+    Clock::time_point last_refill_;
+    Clock::time_point last_adjust_;
+    std::chrono::microseconds base_latency_{ std::chrono::microseconds::max() };
+};
+
+} // namespace CrashSender
@@ -0,0 +1,458 @@
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#endif
+
+#include "utils.h"
+#include "logger.h"
+#include "file_system.h"
+#include "buffer_pool.h"
+#include "cancellation_token.h"
+#include "read_ahead_pipeline.h"
+
+namespace CrashSender {
+
+ReadAheadPipeline::ReadAheadPipeline(size_t buffer_size, size_t buffer_count) noexcept
+    : buffer_size_(BufferPool::RoundUp(buffer_size)),
+      buffer_count_(std::max<size_t>(buffer_count, 2)) {
+}
+
+ReadAheadPipeline::~ReadAheadPipeline() {
+    FreeBuffers();
+}
+
+bool ReadAheadPipeline::IsCancelled() const noexcept {
+    return token_ && token_->IsCancelled();
+}
+
+bool ReadAheadPipeline::AllocateBuffers(size_t count) noexcept {
+    try {
+        buffers_.reserve(count);
+        while (buffers_.size() < count) {
+            char* buffer = BufferPool::GetInstance().Acquire(buffer_size_);
+            if (!buffer) {
+                FreeBuffers();
+                return false;
+            }
+            buffers_.push_back(buffer);
+        }
+        return true;
+    }
+    catch (...) {
+        FreeBuffers();
+        return false;
+    }
+}
+
+void ReadAheadPipeline::FreeBuffers() noexcept {
+    for (char* buffer : buffers_) {
+        BufferPool::GetInstance().Release(buffer, buffer_size_);
+    }
+    buffers_.clear();
+}
+
+bool ReadAheadPipeline::BypassesCache(std::wstring_view filepath) const noexcept {
+    if (unbuffered_threshold_ == 0) {
+        return false;
+    }
+    const int64_t file_size = FileUtils::GetFileSize(filepath);
+    return file_size >= 0 && static_cast<uint64_t>(file_size) >= unbuffered_threshold_;
+}
+
+bool ReadAheadPipeline::OpenFile(std::wstring_view filepath, FileHandle& file, bool& unbuffered, bool& drop_cache, std::string& error_message) {
+    unbuffered = false;
+    drop_cache = false;
+
+    if (FileSystem::OpenRead(filepath, FileSystem::Access::Overlapped, file) != FileSystem::OpenResult::Ok) {
+        error_message = "Failed to open file: " + TextUtils::WideToUtf8(filepath);
+        return false;
+    }
+
+    const int64_t file_size = FileSystem::Size(file);
+    if (unbuffered_threshold_ == 0 || file_size < 0 || static_cast<uint64_t>(file_size) < unbuffered_threshold_) {
+        return true;
+    }
+
+    // Pages written by the crashing process are still cached, they are dropped behind the reads as well
+    drop_cache = true;
+
+    // Not every file system does direct I/O, the cached handle is kept then
+    FileHandle direct;
+    if (FileSystem::OpenRead(filepath, FileSystem::Access::Unbuffered, direct) == FileSystem::OpenResult::Ok) {
+        file = std::move(direct);
+        unbuffered = true;
+    }
+
+    Logger::LogDebug("Streaming " + TextUtils::WideToUtf8(filepath) +
+                     (unbuffered ? " unbuffered" : " dropping cached pages behind the reads"));
+    return true;
+}
+
+#ifdef _WIN32
+
+namespace {
+
+    /**
+     * @brief One in-flight overlapped read
+     */
+    struct ReadSlot {
+        OVERLAPPED overlapped{};
+        HANDLE event = nullptr;
+        char* data = nullptr;
+        DWORD needed = 0; ///< Bytes the read must return, an aligned request may run past the end of the file
+        bool pending = false;
+    };
+
+    /**
+     * @brief Owns the slots of a stream and drains them on every exit path
+     */
+    class OverlappedReader {
+    public:
+        OverlappedReader(HANDLE file, const std::vector<char*>& buffers) : file_(file) {
+            slots_.resize(buffers.size());
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                slots_[i].data = buffers[i];
+                slots_[i].event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            }
+        }
+
+        ~OverlappedReader() {
+            bool any_pending = false;
+            for (const auto& slot : slots_) {
+                any_pending = any_pending || slot.pending;
+            }
+
+            // Buffers must not be released while the kernel still writes into them
+            if (any_pending) {
+                CancelIoEx(file_, nullptr);
+                for (auto& slot : slots_) {
+                    if (slot.pending) {
+                        DWORD ignored = 0;
+                        GetOverlappedResult(file_, &slot.overlapped, &ignored, TRUE);
+                        slot.pending = false;
+                    }
+                }
+            }
+
+            for (const auto& slot : slots_) {
+                if (slot.event) {
+                    CloseHandle(slot.event);
+                }
+            }
+        }
+
+        OverlappedReader(const OverlappedReader&) = delete;
+        OverlappedReader& operator=(const OverlappedReader&) = delete;
+
+        [[nodiscard]]
+        bool IsValid() const noexcept {
+            return std::all_of(slots_.begin(), slots_.end(), [](const ReadSlot& slot) { return slot.event != nullptr; });
+        }
+
+        [[nodiscard]]
+        bool Issue(size_t index, uint64_t offset, DWORD length, DWORD needed) noexcept {
+            ReadSlot& slot = slots_[index];
+            ResetEvent(slot.event);
+            slot.overlapped = OVERLAPPED{};
+            slot.overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFull);
+            slot.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            slot.overlapped.hEvent = slot.event;
+            slot.needed = needed;
+
+            if (!ReadFile(file_, slot.data, length, nullptr, &slot.overlapped) && GetLastError() != ERROR_IO_PENDING) {
+                return false;
+            }
+            slot.pending = true;
+            return true;
+        }
+
+        [[nodiscard]]
+        bool Complete(size_t index, DWORD& length) noexcept {
+            ReadSlot& slot = slots_[index];
+            DWORD bytes_read = 0;
+            const BOOL result = GetOverlappedResult(file_, &slot.overlapped, &bytes_read, TRUE);
+            slot.pending = false;
+            length = slot.needed;
+            return result && bytes_read >= slot.needed;
+        }
+
+        [[nodiscard]]
+        const char* Data(size_t index) const noexcept {
+            return slots_[index].data;
+        }
+
+    private:
+        HANDLE file_;
+        std::vector<ReadSlot> slots_;
+    };
+
+} // anonymous namespace
+
+bool ReadAheadPipeline::Stream(std::wstring_view filepath, uint64_t offset, uint64_t size, const Sink& sink, std::string& error_message) noexcept {
+    try {
+        if (size == 0) {
+            return true;
+        }
+
+        FileHandle file;
+        bool unbuffered = false;
+        bool drop_cache = false;
+        if (!OpenFile(filepath, file, unbuffered, drop_cache, error_message)) {
+            return false;
+        }
+
+        // Direct reads get no read-ahead from the system, more of them are kept in flight instead
+        const size_t depth = unbuffered ? std::max(buffer_count_, kUnbufferedBufferCount) : buffer_count_;
+        if (!AllocateBuffers(depth)) {
+            error_message = "Failed to allocate read-ahead buffers";
+            return false;
+        }
+
+        // Unbuffered reads start on an aligned offset, the bytes in front of the range are skipped
+        const uint64_t head = unbuffered ? offset % FileSystem::kUnbufferedAlignment : 0;
+        const uint64_t start = offset - head;
+        const uint64_t span = head + size;
+
+        OverlappedReader reader(file.get(), buffers_);
+        if (!reader.IsValid()) {
+            error_message = "Failed to create read events";
+            return false;
+        }
+
+        uint64_t issued = 0;
+        const auto issue_next = [&](size_t index) {
+            if (IsCancelled()) {
+                return false;
+            }
+            const auto length = static_cast<DWORD>(std::min<uint64_t>(span - issued, buffer_size_));
+            const auto request = unbuffered ? static_cast<DWORD>(BufferPool::RoundUp(length)) : length;
+            if (!reader.Issue(index, start + issued, request, length)) {
+                return false;
+            }
+            issued += length;
+            return true;
+        };
+
+        // Prime the pipeline
+        for (size_t i = 0; i < depth && issued < span; ++i) {
+            if (!issue_next(i)) {
+                error_message = IsCancelled() ? "File read cancelled"
+                                              : "Failed to start reading file: " + TextUtils::WideToUtf8(filepath);
+                return false;
+            }
+        }
+
+        uint64_t consumed = 0;
+        for (size_t index = 0; consumed < span; index = (index + 1) % depth) {
+            DWORD length = 0;
+            if (!reader.Complete(index, length)) {
+                error_message = "Failed to read file contents: " + TextUtils::WideToUtf8(filepath);
+                return false;
+            }
+
+            // The other buffers keep reading while this one is being sent
+            const size_t skip = consumed == 0 ? static_cast<size_t>(head) : 0;
+            if (!sink(reader.Data(index) + skip, length - skip, error_message)) {
+                return false;
+            }
+            if (drop_cache) {
+                FileSystem::DropCache(file, start + consumed, length);
+            }
+            consumed += length;
+
+            if (issued < span && !issue_next(index)) {
+                error_message = IsCancelled() ? "File read cancelled"
+                                              : "Failed to continue reading file: " + TextUtils::WideToUtf8(filepath);
+                return false;
+            }
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while streaming file: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while streaming file";
+        return false;
+    }
+}
+
+#else
+
+namespace {
+
+    /**
+     * @brief Buffer ring shared between the pread worker and the consumer
+     */
+    struct ReadRing {
+        enum class State : int {
+            Empty = 0,
+            Full = 1,
+            Failed = 2
+        };
+
+        explicit ReadRing(size_t count) : states(count, State::Empty), lengths(count, 0) {}
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<State> states;
+        std::vector<size_t> lengths;
+        bool stop = false;
+    };
+
+} // anonymous namespace
+
+bool ReadAheadPipeline::Stream(std::wstring_view filepath, uint64_t offset, uint64_t size, const Sink& sink, std::string& error_message) noexcept {
+    try {
+        if (size == 0) {
+            return true;
+        }
+
+        FileHandle file;
+        bool unbuffered = false;
+        bool drop_cache = false;
+        if (!OpenFile(filepath, file, unbuffered, drop_cache, error_message)) {
+            return false;
+        }
+
+        // Direct reads get no read-ahead from the system, more of them are kept in flight instead
+        const size_t depth = unbuffered ? std::max(buffer_count_, kUnbufferedBufferCount) : buffer_count_;
+        if (!AllocateBuffers(depth)) {
+            error_message = "Failed to allocate read-ahead buffers";
+            return false;
+        }
+
+        // Unbuffered reads start on an aligned offset, the bytes in front of the range are skipped
+        const uint64_t head = unbuffered ? offset % FileSystem::kUnbufferedAlignment : 0;
+        const uint64_t start = offset - head;
+        const uint64_t span = head + size;
+
+        if (!unbuffered) {
+            posix_fadvise(file.get(), static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_SEQUENTIAL);
+        }
+
+        ReadRing ring(depth);
+
+        std::thread reader([&] {
+            uint64_t position = 0;
+            for (size_t index = 0; position < span; index = (index + 1) % depth) {
+                {
+                    std::unique_lock lock(ring.mutex);
+                    ring.changed.wait(lock, [&] { return ring.stop || ring.states[index] == ReadRing::State::Empty; });
+                    if (ring.stop) {
+                        return;
+                    }
+                }
+
+                if (IsCancelled()) {
+                    {
+                        std::lock_guard lock(ring.mutex);
+                        ring.states[index] = ReadRing::State::Failed;
+                    }
+                    ring.changed.notify_all();
+                    return;
+                }
+
+                // An aligned request may run past the end of the file, the read then comes back short
+                const auto length = static_cast<size_t>(std::min<uint64_t>(span - position, buffer_size_));
+                const size_t request = unbuffered ? BufferPool::RoundUp(length) : length;
+                size_t filled = 0;
+                while (filled < length) {
+                    const int64_t result = FileSystem::ReadAt(file, start + position + filled,
+                                                              buffers_[index] + filled, request - filled);
+                    if (result <= 0) {
+                        break;
+                    }
+                    filled += static_cast<size_t>(result);
+                }
+
+                {
+                    std::lock_guard lock(ring.mutex);
+                    ring.lengths[index] = length;
+                    ring.states[index] = filled >= length ? ReadRing::State::Full : ReadRing::State::Failed;
+                }
+                ring.changed.notify_all();
+
+                if (filled < length) {
+                    return;
+                }
+                position += length;
+            }
+        });
+
+        const auto stop_reader = [&]() noexcept {
+            if (!reader.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard lock(ring.mutex);
+                ring.stop = true;
+            }
+            ring.changed.notify_all();
+            reader.join();
+        };
+
+        // The worker must be joined on every exit path, including exceptions
+        struct ReaderJoiner {
+            const decltype(stop_reader)& stop;
+            ~ReaderJoiner() { stop(); }
+        } joiner{ stop_reader };
+
+        uint64_t consumed = 0;
+        for (size_t index = 0; consumed < span; index = (index + 1) % depth) {
+            ReadRing::State state;
+            size_t length = 0;
+            {
+                std::unique_lock lock(ring.mutex);
+                ring.changed.wait(lock, [&] { return ring.states[index] != ReadRing::State::Empty; });
+                state = ring.states[index];
+                length = ring.lengths[index];
+            }
+
+            if (state == ReadRing::State::Failed) {
+                error_message = IsCancelled() ? "File read cancelled"
+                                              : "Failed to read file contents: " + TextUtils::WideToUtf8(filepath);
+                return false;
+            }
+
+            // The worker keeps filling the other buffers while this one is being sent
+            const size_t skip = consumed == 0 ? static_cast<size_t>(head) : 0;
+            if (!sink(buffers_[index] + skip, length - skip, error_message)) {
+                return false;
+            }
+            if (drop_cache) {
+                FileSystem::DropCache(file, start + consumed, length);
+            }
+            consumed += length;
+
+            {
+                std::lock_guard lock(ring.mutex);
+                ring.states[index] = ReadRing::State::Empty;
+            }
+            ring.changed.notify_all();
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while streaming file: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while streaming file";
+        return false;
+    }
+}
+
+#endif
+
+} // namespace CrashSender
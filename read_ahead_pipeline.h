@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CrashSender {
+
+class CancellationToken;
+class FileHandle;
+
+/**
+ * @brief Read-ahead pipeline streaming a file into a sink
+ *
+ * Keeps several pinned buffers in flight: while the sink consumes one buffer,
+ * the following ones are filled by asynchronous reads (OVERLAPPED ReadFile on
+ * Windows, a pread worker thread on POSIX). Disk and network stay busy at the
+ * same time instead of taking turns.
+ *
+ * Files of at least the unbuffered threshold are read around the system
+ * cache with aligned reads, and their pages are dropped behind the reads
+ * where the system allows it. A multi-GB dump would otherwise push the
+ * game's assets out of memory while it is being uploaded.
+ */
+class ReadAheadPipeline {
+public:
+    /**
+     * @brief Consumer of file data, called in file order
+     * @return false to abort streaming, error_message is set by the sink
+     */
+    using Sink = std::function<bool(const char* data, size_t size, std::string& error_message)>;
+
+    static constexpr size_t kDefaultBufferSize = 1024 * 1024;
+    static constexpr size_t kDefaultBufferCount = 2;
+    static constexpr size_t kUnbufferedBufferCount = 4; ///< Reads in flight when there is no system read-ahead
+    static constexpr uint64_t kDefaultUnbufferedThreshold = 64ull * 1024 * 1024;
+
+    explicit ReadAheadPipeline(size_t buffer_size = kDefaultBufferSize,
+                               size_t buffer_count = kDefaultBufferCount) noexcept;
+    ~ReadAheadPipeline();
+
+    // Non-copyable, non-movable
+    ReadAheadPipeline(const ReadAheadPipeline&) = delete;
+    ReadAheadPipeline& operator=(const ReadAheadPipeline&) = delete;
+    ReadAheadPipeline(ReadAheadPipeline&&) = delete;
+    ReadAheadPipeline& operator=(ReadAheadPipeline&&) = delete;
+
+    /**
+     * @brief Abort streaming once the token fires
+     * @param token Token checked before every read, nullptr to disable
+     */
+    void SetCancellation(const CancellationToken* token) noexcept { token_ = token; }
+
+    /**
+     * @brief Read files of at least this many bytes around the system cache, 0 to disable
+     */
+    void SetUnbufferedThreshold(uint64_t threshold) noexcept { unbuffered_threshold_ = threshold; }
+
+    /**
+     * @brief Whether Stream() reads this file around the system cache
+     */
+    [[nodiscard]]
+    bool BypassesCache(std::wstring_view filepath) const noexcept;
+
+    /**
+     * @brief Stream a byte range of a file into the sink
+     * @param filepath Path to file
+     * @param offset First byte to stream
+     * @param size Number of bytes to stream
+     * @param sink Consumer of the data
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if all bytes were read and accepted by the sink
+     */
+    [[nodiscard]]
+    bool Stream(std::wstring_view filepath, uint64_t offset, uint64_t size, const Sink& sink, std::string& error_message) noexcept;
+
+private:
+    /**
+     * @brief Make sure at least `count` buffers exist
+     */
+    bool AllocateBuffers(size_t count) noexcept;
+    void FreeBuffers() noexcept;
+
+    /**
+     * @brief Open a file for Stream()
+     * @param unbuffered Set if reads must be aligned to FileSystem::kUnbufferedAlignment
+     * @param drop_cache Set if pages are to be evicted behind the reads
+     */
+    [[nodiscard]]
+    bool OpenFile(std::wstring_view filepath, FileHandle& file, bool& unbuffered, bool& drop_cache, std::string& error_message);
+
+    [[nodiscard]]
+    bool IsCancelled() const noexcept;
+
+    std::vector<char*> buffers_;
+    size_t buffer_size_;
+    size_t buffer_count_;
+    uint64_t unbuffered_threshold_{kDefaultUnbufferedThreshold};
+    const CancellationToken* token_{nullptr};
+};
+
+} // namespace CrashSender
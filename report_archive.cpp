@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "utils.h"
+#include "logger.h"
+#include "crc32c.h"
+#include "crash_report_data_builder.h"
+#include "report_archive.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr char MAGIC[8] = { 'L', '2', 'C', 'R', 'A', 'R', 'C', 'H' };
+    constexpr size_t NAME_SIZE = 32;
+    constexpr size_t FILENAME_SIZE = 160;
+    constexpr size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+    // Header fields
+    constexpr size_t HEADER_VERSION = 8;
+    constexpr size_t HEADER_SIZE_FIELD = 12;
+    constexpr size_t HEADER_ALIGNMENT = 16;
+    constexpr size_t HEADER_ENTRY_COUNT = 20;
+    constexpr size_t HEADER_TOC_CHECKSUM = 24;
+    constexpr size_t HEADER_ARCHIVE_SIZE = 32;
+
+    // Table of contents slot fields
+    constexpr size_t ENTRY_FILENAME = NAME_SIZE;
+    constexpr size_t ENTRY_OFFSET = ENTRY_FILENAME + FILENAME_SIZE;
+    constexpr size_t ENTRY_SIZE = ENTRY_OFFSET + 8;
+    constexpr size_t ENTRY_RAW_SIZE = ENTRY_SIZE + 8;
+    constexpr size_t ENTRY_CODEC = ENTRY_RAW_SIZE + 8;
+    constexpr size_t ENTRY_CHECKSUM = ENTRY_CODEC + 4;
+
+    static_assert(ReportArchive::kHeaderSize + ReportArchive::kMaxEntries * ReportArchive::kEntrySize <= ReportArchive::kAlignment);
+    static_assert(ENTRY_CHECKSUM + 4 <= ReportArchive::kEntrySize);
+
+    void PutU32(char* at, uint32_t value) noexcept {
+        for (size_t i = 0; i < 4; ++i) {
+            at[i] = static_cast<char>(value >> (8 * i));
+        }
+    }
+
+    void PutU64(char* at, uint64_t value) noexcept {
+        for (size_t i = 0; i < 8; ++i) {
+            at[i] = static_cast<char>(value >> (8 * i));
+        }
+    }
+
+    uint32_t GetU32(const char* at) noexcept {
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(at[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t GetU64(const char* at) noexcept {
+        uint64_t value = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(at[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Copy UTF-8 text into a NUL-padded slot, cut at a character boundary if too long
+     */
+    void PutText(char* at, size_t slot_size, std::string_view text) noexcept {
+        size_t length = std::min(text.size(), slot_size - 1);
+        while (length > 0 && length < text.size() && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+            --length;
+        }
+        std::memcpy(at, text.data(), length);
+    }
+
+    std::string_view GetText(const char* at, size_t slot_size) noexcept {
+        return std::string_view(at, strnlen(at, slot_size));
+    }
+
+    uint64_t AlignUp(uint64_t value) noexcept {
+        return (value + ReportArchive::kAlignment - 1) / ReportArchive::kAlignment * ReportArchive::kAlignment;
+    }
+
+    /**
+     * @brief Entry being packed, fields come from memory and files from disk
+     */
+    struct PackSource {
+        ArchiveEntry entry{};
+        std::string bytes{};
+        FileHandle file{};
+    };
+
+} // anonymous namespace
+
+bool ReportArchive::Pack(const CrashReportData& data, const std::wstring& archive_path, std::string& error_message) noexcept {
+    const std::filesystem::path temp_path = std::filesystem::path(archive_path + L".tmp");
+    try {
+        // Reports handed over without their error text still have the game's error file
+        CrashReportData report = data;
+        if (report.error.empty() && !report.temp_path.empty() && !CrashReportDataBuilder::ProcessErrorContent(report)) {
+            error_message = "Failed to read error file: " + TextUtils::WideToUtf8(report.temp_path);
+            return false;
+        }
+
+        std::vector<PackSource> sources;
+        const auto add_field = [&](std::string_view name, std::string_view value) {
+            PackSource source;
+            source.entry.name = name;
+            source.bytes = value;
+            sources.push_back(std::move(source));
+        };
+        const auto add_file = [&](std::string_view name, const std::wstring& path, bool required) {
+            if (path.empty()) {
+                return true;
+            }
+
+            PackSource source;
+            source.entry.name = name;
+            source.entry.filename = std::filesystem::path(path).filename().wstring();
+            const int64_t size = FileSystem::OpenRead(path, FileSystem::Access::Sequential, source.file) == FileSystem::OpenResult::Ok
+                ? FileSystem::Size(source.file) : -1;
+            if (size < 0) {
+                if (required) {
+                    error_message = "Failed to open file for archive: " + TextUtils::WideToUtf8(path);
+                    return false;
+                }
+                Logger::LogError("Failed to open file for archive: " + TextUtils::WideToUtf8(path));
+                return true;
+            }
+            source.entry.size = static_cast<uint64_t>(size);
+            sources.push_back(std::move(source));
+            return true;
+        };
+
+        std::string urls;
+        for (const auto& url : report.urls.empty() ? std::vector<std::wstring>{ report.url } : report.urls) {
+            urls += TextUtils::WideToUtf8(url) + "\n";
+        }
+
+        add_field("CRVersion", report.version);
+        add_field("error", report.error);
+        add_field("urls", urls);
+        if (!report.signature.empty()) {
+            add_field("signature", report.signature);
+        }
+        if (!add_file("dumpfile", report.dump_path, true) ||
+            !add_file("gamelog", report.game_log_path, false) ||
+            !add_file("networklog", report.network_log_path, false)) {
+            return false;
+        }
+
+        // Payloads follow the first alignment block in order
+        uint64_t end = kAlignment;
+        for (auto& source : sources) {
+            if (!source.file) {
+                source.entry.size = source.bytes.size();
+            }
+            source.entry.raw_size = source.entry.size;
+            source.entry.offset = AlignUp(end);
+            end = source.entry.offset + source.entry.size;
+        }
+
+        std::ofstream output(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            error_message = "Failed to create archive: " + TextUtils::WideToUtf8(temp_path.wstring());
+            return false;
+        }
+
+        std::vector<char> buffer(std::max<size_t>(COPY_BUFFER_SIZE, kAlignment), 0);
+        uint64_t position = 0;
+        const auto pad_to = [&](uint64_t offset) {
+            std::fill_n(buffer.begin(), kAlignment, '\0');
+            while (position < offset) {
+                const size_t chunk = static_cast<size_t>(std::min<uint64_t>(offset - position, kAlignment));
+                output.write(buffer.data(), static_cast<std::streamsize>(chunk));
+                position += chunk;
+            }
+        };
+
+        for (auto& source : sources) {
+            pad_to(source.entry.offset);
+            if (!source.file) {
+                source.entry.checksum = Crc32c::Update(0, source.bytes.data(), source.bytes.size());
+                output.write(source.bytes.data(), static_cast<std::streamsize>(source.bytes.size()));
+                position += source.bytes.size();
+                continue;
+            }
+
+            // Files are checksummed in the same pass that copies them
+            for (uint64_t copied = 0; copied < source.entry.size;) {
+                const size_t chunk = static_cast<size_t>(std::min<uint64_t>(source.entry.size - copied, buffer.size()));
+                if (FileSystem::ReadAt(source.file, copied, buffer.data(), chunk) != static_cast<int64_t>(chunk)) {
+                    error_message = "Failed to read " + source.entry.name + " while packing archive";
+                    output.close();
+                    std::filesystem::remove(temp_path);
+                    return false;
+                }
+                source.entry.checksum = Crc32c::Update(source.entry.checksum, buffer.data(), chunk);
+                output.write(buffer.data(), static_cast<std::streamsize>(chunk));
+                copied += chunk;
+            }
+            position += source.entry.size;
+        }
+
+        // Table of contents is written last, over the zeroed first block
+        if (sources.size() > kMaxEntries) {
+            error_message = "Too many entries for archive";
+            output.close();
+            std::filesystem::remove(temp_path);
+            return false;
+        }
+
+        std::vector<char> head(kAlignment, '\0');
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const ArchiveEntry& entry = sources[i].entry;
+            char* slot = head.data() + kHeaderSize + i * kEntrySize;
+            PutText(slot, NAME_SIZE, entry.name);
+            PutText(slot + ENTRY_FILENAME, FILENAME_SIZE, TextUtils::WideToUtf8(entry.filename));
+            PutU64(slot + ENTRY_OFFSET, entry.offset);
+            PutU64(slot + ENTRY_SIZE, entry.size);
+            PutU64(slot + ENTRY_RAW_SIZE, entry.raw_size);
+            PutU32(slot + ENTRY_CODEC, static_cast<uint32_t>(entry.codec));
+            PutU32(slot + ENTRY_CHECKSUM, entry.checksum);
+        }
+
+        std::memcpy(head.data(), MAGIC, sizeof(MAGIC));
+        PutU32(head.data() + HEADER_VERSION, kVersion);
+        PutU32(head.data() + HEADER_SIZE_FIELD, static_cast<uint32_t>(kAlignment));
+        PutU32(head.data() + HEADER_ALIGNMENT, static_cast<uint32_t>(kAlignment));
+        PutU32(head.data() + HEADER_ENTRY_COUNT, static_cast<uint32_t>(sources.size()));
+        PutU32(head.data() + HEADER_TOC_CHECKSUM, Crc32c::Update(0, head.data() + kHeaderSize, kMaxEntries * kEntrySize));
+        PutU64(head.data() + HEADER_ARCHIVE_SIZE, std::max<uint64_t>(position, kAlignment));
+
+        pad_to(kAlignment);
+        output.seekp(0);
+        output.write(head.data(), static_cast<std::streamsize>(head.size()));
+        output.close();
+        if (!output) {
+            error_message = "Failed to write archive: " + TextUtils::WideToUtf8(temp_path.wstring());
+            std::filesystem::remove(temp_path);
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, archive_path, ec);
+        if (ec) {
+            error_message = "Failed to finish archive: " + ec.message();
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while packing archive: " + std::string(e.what());
+    }
+    catch (...) {
+        error_message = "Unknown exception while packing archive";
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(temp_path, ec);
+    return false;
+}
+
+bool ReportArchive::Open(std::wstring_view archive_path, std::string& error_message) noexcept {
+    try {
+        entries_.clear();
+        if (!mapping_.Open(archive_path, error_message)) {
+            return false;
+        }
+
+        const char* head = mapping_.data();
+        if (mapping_.size() < kAlignment || std::memcmp(head, MAGIC, sizeof(MAGIC)) != 0) {
+            error_message = "Not a report archive: " + TextUtils::WideToUtf8(archive_path);
+            return false;
+        }
+        if (GetU32(head + HEADER_VERSION) != kVersion || GetU32(head + HEADER_SIZE_FIELD) != kAlignment) {
+            error_message = "Unsupported report archive version: " + std::to_string(GetU32(head + HEADER_VERSION));
+            return false;
+        }
+
+        const uint32_t count = GetU32(head + HEADER_ENTRY_COUNT);
+        if (count > kMaxEntries ||
+            GetU32(head + HEADER_TOC_CHECKSUM) != Crc32c::Update(0, head + kHeaderSize, kMaxEntries * kEntrySize) ||
+            GetU64(head + HEADER_ARCHIVE_SIZE) != mapping_.size()) {
+            error_message = "Corrupt report archive: " + TextUtils::WideToUtf8(archive_path);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const char* slot = head + kHeaderSize + i * kEntrySize;
+            ArchiveEntry entry;
+            entry.name = GetText(slot, NAME_SIZE);
+            entry.filename = TextUtils::Utf8ToWide(GetText(slot + ENTRY_FILENAME, FILENAME_SIZE));
+            entry.offset = GetU64(slot + ENTRY_OFFSET);
+            entry.size = GetU64(slot + ENTRY_SIZE);
+            entry.raw_size = GetU64(slot + ENTRY_RAW_SIZE);
+            entry.codec = static_cast<ArchiveEntry::Codec>(GetU32(slot + ENTRY_CODEC));
+            entry.checksum = GetU32(slot + ENTRY_CHECKSUM);
+
+            if (entry.offset < kAlignment || entry.offset > mapping_.size() || entry.size > mapping_.size() - entry.offset ||
+                (entry.codec != ArchiveEntry::Codec::Identity && entry.codec != ArchiveEntry::Codec::Deflate)) {
+                error_message = "Corrupt entry " + entry.name + " in report archive";
+                entries_.clear();
+                return false;
+            }
+            entries_.push_back(std::move(entry));
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while opening archive: " + std::string(e.what());
+        entries_.clear();
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while opening archive";
+        entries_.clear();
+        return false;
+    }
+}
+
+const ArchiveEntry* ReportArchive::Find(std::string_view name) const noexcept {
+    const auto entry = std::find_if(entries_.begin(), entries_.end(), [&](const ArchiveEntry& candidate) {
+        return candidate.name == name;
+    });
+    return entry == entries_.end() ? nullptr : &*entry;
+}
+
+std::string_view ReportArchive::Payload(const ArchiveEntry& entry) const noexcept {
+    return std::string_view(mapping_.data() + entry.offset, static_cast<size_t>(entry.size));
+}
+
+std::string ReportArchive::Field(std::string_view name) const {
+    const ArchiveEntry* entry = Find(name);
+    if (!entry || entry->IsFile() || entry->codec != ArchiveEntry::Codec::Identity) {
+        return {};
+    }
+    return std::string(Payload(*entry));
+}
+
+bool ReportArchive::Verify(const ArchiveEntry& entry) const noexcept {
+    const std::string_view payload = Payload(entry);
+    return entry.codec == ArchiveEntry::Codec::Identity &&
+           Crc32c::Update(0, payload.data(), payload.size()) == entry.checksum;
+}
+
+} // namespace CrashSender
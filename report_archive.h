@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crash_report_data.h"
+#include "file_system.h"
+
+namespace CrashSender {
+
+/**
+ * @brief One field or file stored in a report archive
+ */
+struct ArchiveEntry {
+    enum class Codec : uint32_t {
+        Identity = 0, ///< Stored as is
+        Deflate = 1   ///< zlib stream
+    };
+
+    std::string name{};      ///< Form field name, e.g. "error" or "dumpfile"
+    std::wstring filename{}; ///< File name reported to the server, empty for plain fields
+    uint64_t offset{0};      ///< First payload byte in the archive, a multiple of kAlignment
+    uint64_t size{0};        ///< Stored payload size
+    uint64_t raw_size{0};    ///< Size once decoded
+    Codec codec{Codec::Identity};
+    uint32_t checksum{0};    ///< CRC32C of the decoded bytes
+
+    [[nodiscard]]
+    bool IsFile() const noexcept { return !filename.empty(); }
+};
+
+/**
+ * @brief Single-file container of a crash report
+ *
+ * Layout, all integers little-endian:
+ *
+ *   0     header (256 bytes): magic "L2CRARCH", format version, header size,
+ *         alignment, entry count, CRC32C of the table of contents, archive size
+ *   256   table of contents, kMaxEntries fixed 256-byte slots
+ *   4096  payloads, each starting on a kAlignment boundary
+ *
+ * A slot holds the NUL-padded UTF-8 name and filename, offset, stored and
+ * decoded size, codec and CRC32C of its entry. Payloads of files are the
+ * plain file bytes, so a reader maps the archive, or reads the first 4 KB,
+ * and then uploads or extracts any single entry by its byte range.
+ */
+class ReportArchive {
+public:
+    static constexpr std::wstring_view kExtension = L".l2cr";
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kAlignment = 4096;  ///< Page and sector size
+    static constexpr size_t kHeaderSize = 256;
+    static constexpr size_t kEntrySize = 256;
+    static constexpr size_t kMaxEntries = 15;     ///< Header and table of contents fill the first kAlignment bytes
+
+    ReportArchive() noexcept = default;
+
+    // Non-copyable, non-movable
+    ReportArchive(const ReportArchive&) = delete;
+    ReportArchive& operator=(const ReportArchive&) = delete;
+    ReportArchive(ReportArchive&&) = delete;
+    ReportArchive& operator=(ReportArchive&&) = delete;
+
+    /**
+     * @brief Pack a report into a new archive
+     *
+     * Stores the version, error text, URLs and signature as fields and the
+     * dump and logs as files. Missing logs are skipped, the archive appears
+     * under its name only once it is complete.
+     *
+     * @param data Report with its error file or error text
+     * @param archive_path Archive to create, replaced if it exists
+     * @param error_message Placeholder for error if it will occurs
+     */
+    [[nodiscard]]
+    static bool Pack(const CrashReportData& data, const std::wstring& archive_path, std::string& error_message) noexcept;
+
+    /**
+     * @brief Map an archive and read its table of contents, payloads are not touched
+     */
+    [[nodiscard]]
+    bool Open(std::wstring_view archive_path, std::string& error_message) noexcept;
+
+    [[nodiscard]]
+    const std::vector<ArchiveEntry>& Entries() const noexcept { return entries_; }
+
+    /**
+     * @brief Entry by name, nullptr if the archive has none
+     */
+    [[nodiscard]]
+    const ArchiveEntry* Find(std::string_view name) const noexcept;
+
+    /**
+     * @brief Stored bytes of an entry, valid while the archive is open
+     */
+    [[nodiscard]]
+    std::string_view Payload(const ArchiveEntry& entry) const noexcept;
+
+    /**
+     * @brief Text of a plain identity field, empty if missing
+     */
+    [[nodiscard]]
+    std::string Field(std::string_view name) const;
+
+    /**
+     * @brief Check the CRC32C of an identity entry against its payload
+     */
+    [[nodiscard]]
+    bool Verify(const ArchiveEntry& entry) const noexcept;
+
+private:
+    MappedFile mapping_;
+    std::vector<ArchiveEntry> entries_;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "utils.h"
+#include "report_arena.h"
+
+namespace CrashSender {
+
+ReportArena::ReportArena(ReportArena&& other) noexcept
+    : blocks_(std::move(other.blocks_))
+    , cursor_(std::exchange(other.cursor_, nullptr))
+    , end_(std::exchange(other.end_, nullptr)) {
+    other.blocks_.clear();
+}
+
+ReportArena& ReportArena::operator=(ReportArena&& other) noexcept {
+    if (this != &other) {
+        blocks_ = std::move(other.blocks_);
+        other.blocks_.clear();
+        cursor_ = std::exchange(other.cursor_, nullptr);
+        end_ = std::exchange(other.end_, nullptr);
+    }
+    return *this;
+}
+
+void* ReportArena::Allocate(size_t size, size_t alignment) {
+    const auto aligned = [&](char* pointer) {
+        const auto address = reinterpret_cast<uintptr_t>(pointer);
+        return pointer + ((alignment - address % alignment) % alignment);
+    };
+
+    if (cursor_ && aligned(cursor_) <= end_ && size <= static_cast<size_t>(end_ - aligned(cursor_))) {
+        char* allocation = aligned(cursor_);
+        cursor_ = allocation + size;
+        return allocation;
+    }
+
+    // Blocks come from operator new[] and are aligned for any fundamental type
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        throw std::bad_alloc();
+    }
+
+    size_t block_size = blocks_.empty() ? kBlockSize : std::min(blocks_.back().size * 2, kMaxBlockSize);
+    block_size = std::max(block_size, size);
+
+    blocks_.reserve(blocks_.size() + 1);
+    Block block{ std::make_unique_for_overwrite<char[]>(block_size), block_size };
+    cursor_ = block.data.get() + size;
+    end_ = block.data.get() + block_size;
+    blocks_.push_back(std::move(block));
+    return blocks_.back().data.get();
+}
+
+std::string_view ReportArena::Store(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+
+    auto* copy = static_cast<char*>(Allocate(text.size()));
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
+
+std::string_view ReportArena::StoreUtf8(std::wstring_view text) {
+    if (text.empty()) {
+        return {};
+    }
+
+    // Reserve the worst case and return what the conversion did not use
+    auto* utf8 = static_cast<char*>(Allocate(text.size() * TextUtils::kMaxUtf8PerWide));
+    const size_t size = TextUtils::WideToUtf8(text, utf8);
+    Shrink(utf8, size);
+    return std::string_view(utf8, size);
+}
+
+std::wstring_view ReportArena::StoreWide(std::wstring_view text) {
+    if (text.empty()) {
+        return {};
+    }
+
+    auto* copy = static_cast<wchar_t*>(Allocate(text.size() * sizeof(wchar_t), alignof(wchar_t)));
+    std::memcpy(copy, text.data(), text.size() * sizeof(wchar_t));
+    return std::wstring_view(copy, text.size());
+}
+
+void ReportArena::Shrink(const void* allocation, size_t used) noexcept {
+    const auto* begin = static_cast<const char*>(allocation);
+    if (blocks_.empty() || begin < blocks_.back().data.get() || begin > cursor_) {
+        return;
+    }
+    cursor_ = const_cast<char*>(begin) + std::min(used, static_cast<size_t>(cursor_ - begin));
+}
+
+void ReportArena::Reset() noexcept {
+    if (blocks_.empty()) {
+        return;
+    }
+
+    // The last block is the largest one
+    if (blocks_.size() > 1) {
+        std::swap(blocks_.front(), blocks_.back());
+        blocks_.resize(1);
+    }
+    cursor_ = blocks_.front().data.get();
+    end_ = cursor_ + blocks_.front().size;
+}
+
+size_t ReportArena::Capacity() const noexcept {
+    size_t capacity = 0;
+    for (const auto& block : blocks_) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+} // namespace CrashSender
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace CrashSender {
+
+/**
+ * @brief Bump allocator for the text of one report request
+ *
+ * Memory is handed out from large blocks and only released all at once, so
+ * a request body made of dozens of small pieces costs one or two heap
+ * allocations. Views returned by it stay valid until Reset() or destruction,
+ * also when the arena is moved.
+ */
+class ReportArena {
+public:
+    static constexpr size_t kBlockSize = 4096; ///< First block, later ones double up to kMaxBlockSize
+    static constexpr size_t kMaxBlockSize = 256 * 1024;
+
+    ReportArena() noexcept = default;
+
+    // Non-copyable, movable
+    ReportArena(const ReportArena&) = delete;
+    ReportArena& operator=(const ReportArena&) = delete;
+    ReportArena(ReportArena&& other) noexcept;
+    ReportArena& operator=(ReportArena&& other) noexcept;
+
+    /**
+     * @brief Uninitialized room for `size` bytes, throws std::bad_alloc
+     * @param alignment Power of two the address is a multiple of
+     */
+    [[nodiscard]]
+    void* Allocate(size_t size, size_t alignment = 1);
+
+    /**
+     * @brief Copy of UTF-8 or binary text
+     */
+    [[nodiscard]]
+    std::string_view Store(std::string_view text);
+
+    /**
+     * @brief UTF-8 form of wide text, converted straight into the arena
+     */
+    [[nodiscard]]
+    std::string_view StoreUtf8(std::wstring_view text);
+
+    /**
+     * @brief Copy of wide text, e.g. a native path
+     */
+    [[nodiscard]]
+    std::wstring_view StoreWide(std::wstring_view text);
+
+    /**
+     * @brief Give back the unused tail of the latest allocation
+     * @param used Bytes of it that stay in use
+     */
+    void Shrink(const void* allocation, size_t used) noexcept;
+
+    /**
+     * @brief Forget everything stored, the largest block is kept for reuse
+     */
+    void Reset() noexcept;
+
+    /**
+     * @brief Bytes reserved from the heap so far
+     */
+    [[nodiscard]]
+    size_t Capacity() const noexcept;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks_;
+    char* cursor_ = nullptr; ///< Next free byte of the last block
+    char* end_ = nullptr;    ///< End of the last block
+};
+
+} // namespace CrashSender
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#include "utils.h"
+#include "logger.h"
+#include "file_system.h"
+#include "report_archive.h"
+#include "report_spool.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr std::wstring_view TEMPORARY_EXTENSION = L".tmp";
+
+    /// Temporary spool entries untouched for this long were left by a killed process
+    constexpr std::chrono::minutes STALE_TEMPORARY_AGE{ 10 };
+
+    /**
+     * @brief Move a file, falling back to copy and delete across volumes
+     */
+    bool MoveOrCopy(const std::filesystem::path& from, const std::filesystem::path& to, bool keep_source) {
+        std::error_code ec;
+        if (!keep_source) {
+            std::filesystem::rename(from, to, ec);
+            if (!ec) {
+                return true;
+            }
+        }
+
+        std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            return false;
+        }
+        if (!keep_source) {
+            std::filesystem::remove(from, ec);
+        }
+        return true;
+    }
+
+    /**
+     * @brief True for an entry spooled longer than `max_age` ago, names are creation timestamps in milliseconds
+     */
+    bool IsExpired(const std::filesystem::path& path, std::chrono::milliseconds max_age) noexcept {
+        const std::string name = path.stem().string();
+        int64_t stamp = 0;
+        const auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), stamp);
+        if (error != std::errc{} || end != name.data() + name.size()) {
+            return false;
+        }
+
+        const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        return now - stamp > max_age.count();
+    }
+
+    /**
+     * @brief Delete a half-written spool entry once no writer can still be working on it
+     */
+    void RemoveIfStale(const std::filesystem::directory_entry& entry) {
+        std::error_code ec;
+        const auto written = entry.last_write_time(ec);
+        if (ec || std::filesystem::file_time_type::clock::now() - written < STALE_TEMPORARY_AGE) {
+            return;
+        }
+
+        Logger::LogInfo(L"Removing incomplete spool entry " + entry.path().wstring());
+        std::filesystem::remove_all(entry.path(), ec);
+    }
+
+    /**
+     * @brief Read a report spooled as a directory of moved files
+     */
+    bool LoadDirectory(const std::filesystem::path& directory, std::wstring_view manifest_name, SpooledReport& report) {
+        std::ifstream file(directory / manifest_name, std::ios::in | std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        report.path = directory.wstring();
+
+        std::string line;
+        while (std::getline(file, line)) {
+            const auto separator = line.find('=');
+            if (separator == std::string::npos) {
+                continue;
+            }
+
+            const std::string key = line.substr(0, separator);
+            const std::wstring value = TextUtils::Utf8ToWide(std::string_view(line).substr(separator + 1));
+            const auto in_directory = [&] { return (directory / value).wstring(); };
+
+            if (key == "url") {
+                report.data.urls.push_back(value);
+            } else if (key == "version") {
+                report.data.version = line.substr(separator + 1);
+            } else if (key == "error") {
+                report.data.temp_path = in_directory();
+            } else if (key == "dump") {
+                report.data.dump_path = in_directory();
+            } else if (key == "gamelog") {
+                report.data.game_log_path = in_directory();
+            } else if (key == "networklog") {
+                report.data.network_log_path = in_directory();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Read the fields of a report archive, its files stay in place
+     */
+    bool LoadArchive(const std::filesystem::path& path, SpooledReport& report) {
+        ReportArchive archive;
+        std::string error_message;
+        if (!archive.Open(path.wstring(), error_message)) {
+            Logger::LogError(error_message);
+            return false;
+        }
+
+        report.path = path.wstring();
+        report.data.archive_path = report.path;
+        report.data.version = archive.Field("CRVersion");
+        report.data.error = archive.Field("error");
+        report.data.signature = archive.Field("signature");
+
+        const std::string urls = archive.Field("urls");
+        for (size_t start = 0; start < urls.size();) {
+            const size_t end = std::min(urls.find('\n', start), urls.size());
+            if (end > start) {
+                report.data.urls.push_back(TextUtils::Utf8ToWide(std::string_view(urls).substr(start, end - start)));
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+} // anonymous namespace
+
+bool ReportSpool::Store(const CrashReportData& data, std::string& error_message) noexcept {
+    try {
+        const auto stamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const std::filesystem::path spool(kSpoolDirectory);
+
+        std::error_code ec;
+        std::filesystem::create_directories(spool, ec);
+        if (ec) {
+            error_message = "Failed to create spool directory: " + ec.message();
+            return false;
+        }
+
+        // The archive belongs to the caller, the spool keeps its own copy
+        if (!data.archive_path.empty()) {
+            const std::filesystem::path archive = spool / (std::to_wstring(stamp) + std::wstring(ReportArchive::kExtension));
+            const std::filesystem::path temporary = archive.wstring() + std::wstring(TEMPORARY_EXTENSION);
+            if (!MoveOrCopy(data.archive_path, temporary, true)) {
+                error_message = "Failed to spool archive: " + TextUtils::WideToUtf8(data.archive_path);
+                return false;
+            }
+            std::filesystem::rename(temporary, archive, ec);
+            if (ec) {
+                error_message = "Failed to publish spooled archive: " + ec.message();
+                return false;
+            }
+            Logger::LogInfo(L"Crash report spooled to " + archive.wstring());
+            return true;
+        }
+
+        // Files are moved, not packed: this runs on the cancellation path with little time left.
+        // The directory gets its name only once complete, the daemon packs it into an archive later
+        const std::filesystem::path directory = spool / std::to_wstring(stamp);
+        const std::filesystem::path temporary = directory.wstring() + std::wstring(TEMPORARY_EXTENSION);
+        std::filesystem::create_directories(temporary, ec);
+        if (ec) {
+            error_message = "Failed to create spool directory: " + ec.message();
+            return false;
+        }
+
+        std::string manifest = "version=" + data.version + "\n";
+        for (const auto& url : data.urls.empty() ? std::vector<std::wstring>{ data.url } : data.urls) {
+            manifest += "url=" + TextUtils::WideToUtf8(url) + "\n";
+        }
+
+        // Dump and error file are our temporary files, the logs belong to the game
+        const auto add_file = [&](std::string_view key, const std::wstring& source, bool keep_source, bool required) {
+            if (source.empty()) {
+                return true;
+            }
+
+            const std::filesystem::path source_path(source);
+            const std::filesystem::path name = key == "error" ? std::filesystem::path(L"error.txt") : source_path.filename();
+            if (!MoveOrCopy(source_path, temporary / name, keep_source)) {
+                if (required) {
+                    error_message = "Failed to spool file: " + TextUtils::WideToUtf8(source);
+                    return false;
+                }
+                Logger::LogError("Failed to spool file: " + TextUtils::WideToUtf8(source));
+                return true;
+            }
+
+            manifest += std::string(key) + "=" + TextUtils::WideToUtf8(name.wstring()) + "\n";
+            return true;
+        };
+
+        if (!add_file("dump", data.dump_path, false, true) ||
+            !add_file("error", data.temp_path, false, true) ||
+            !add_file("gamelog", data.game_log_path, true, false) ||
+            !add_file("networklog", data.network_log_path, true, false)) {
+            return false;
+        }
+
+        std::ofstream file(temporary / kManifestName, std::ios::out | std::ios::binary);
+        file << manifest;
+        file.close();
+        if (!file) {
+            error_message = "Failed to write spool manifest";
+            return false;
+        }
+
+        std::filesystem::rename(temporary, directory, ec);
+        if (ec) {
+            error_message = "Failed to publish spooled report: " + ec.message();
+            return false;
+        }
+
+        Logger::LogInfo(L"Crash report spooled to " + directory.wstring());
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while spooling report: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while spooling report";
+        return false;
+    }
+}
+
+bool ReportSpool::Pack(SpooledReport& report, FileHandle& claim, std::string& error_message) noexcept {
+    try {
+        if (!report.data.archive_path.empty()) {
+            return true;
+        }
+
+        // The archive is claimed before it appears, no other sender picks it up meanwhile
+        const std::wstring archive = report.path + std::wstring(ReportArchive::kExtension);
+        FileHandle archive_claim;
+        if (!FileSystem::TryLock(archive + std::wstring(kClaimExtension), archive_claim)) {
+            error_message = "Archive of the report is claimed elsewhere";
+            return false;
+        }
+
+        if (!ReportArchive::Pack(report.data, archive, error_message)) {
+            return false;
+        }
+        SpooledReport packed;
+        if (!LoadArchive(archive, packed)) {
+            std::error_code ec;
+            std::filesystem::remove(archive, ec);
+            error_message = "Failed to read back packed report";
+            return false;
+        }
+        if (!packed.data.urls.empty()) {
+            packed.data.url = packed.data.urls.front();
+        }
+
+        Remove(report);
+        claim = std::move(archive_claim);
+        report = std::move(packed);
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while packing spooled report: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while packing spooled report";
+        return false;
+    }
+}
+
+std::vector<SpooledReport> ReportSpool::LoadPending() noexcept {
+    std::vector<SpooledReport> reports;
+
+    try {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(kSpoolDirectory, ec)) {
+            return reports;
+        }
+
+        for (const auto& entry : std::filesystem::directory_iterator(kSpoolDirectory, ec)) {
+            if (entry.path().extension() == TEMPORARY_EXTENSION) {
+                RemoveIfStale(entry);
+                continue;
+            }
+
+            // Claim files of reports removed by a sender that died before deleting the claim
+            if (entry.path().extension() == kClaimExtension) {
+                std::error_code exists_error;
+                FileHandle orphan;
+                if (!std::filesystem::exists(std::filesystem::path(entry.path()).replace_extension(), exists_error) &&
+                    FileSystem::TryLock(entry.path().wstring(), orphan)) {
+                    orphan.Close();
+                    std::filesystem::remove(entry.path(), exists_error);
+                }
+                continue;
+            }
+
+            // A report the server never took within kMaxAge is given up, it would block the spool forever
+            if (IsExpired(entry.path(), kMaxAge)) {
+                SpooledReport expired;
+                expired.path = entry.path().wstring();
+                FileHandle claim;
+                if (Claim(expired, claim)) {
+                    Logger::LogError(L"Dropping crash report spooled too long ago: " + expired.path);
+                    Remove(expired);
+                }
+                continue;
+            }
+
+            SpooledReport report;
+            const bool loaded = entry.path().extension() == ReportArchive::kExtension
+                ? LoadArchive(entry.path(), report)
+                : entry.is_directory(ec) && LoadDirectory(entry.path(), kManifestName, report);
+            if (!loaded) {
+                continue;
+            }
+
+            if (!report.data.urls.empty()) {
+                report.data.url = report.data.urls.front();
+            }
+
+            if (report.data.IsValid()) {
+                reports.push_back(std::move(report));
+            }
+        }
+
+        // Names are creation timestamps
+        std::sort(reports.begin(), reports.end(), [](const SpooledReport& a, const SpooledReport& b) {
+            return a.path < b.path;
+        });
+    }
+    catch (...) {
+        Logger::LogError("Exception occurred while loading spooled reports");
+    }
+
+    return reports;
+}
+
+bool ReportSpool::Claim(const SpooledReport& report, FileHandle& claim) noexcept {
+    try {
+        const std::wstring claim_path = report.path + std::wstring(kClaimExtension);
+        if (!FileSystem::TryLock(claim_path, claim)) {
+            return false;
+        }
+
+        // The previous holder may have delivered and removed the report before we got the lock
+        std::error_code ec;
+        if (!std::filesystem::exists(report.path, ec)) {
+            claim.Close();
+            std::filesystem::remove(claim_path, ec);
+            return false;
+        }
+        return true;
+    }
+    catch (...) {
+        claim.Close();
+        return false;
+    }
+}
+
+void ReportSpool::Remove(const SpooledReport& report) noexcept {
+    std::error_code ec;
+    std::filesystem::remove_all(report.path, ec);
+    if (ec) {
+        Logger::LogError("Failed to remove spooled report: " + ec.message());
+        return;
+    }
+    std::filesystem::remove(report.path + std::wstring(kClaimExtension), ec);
+}
+
+} // namespace CrashSender
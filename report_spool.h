@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crash_report_data.h"
+
+namespace CrashSender {
+
+class FileHandle;
+
+/**
+ * @brief Report left in the spool by an earlier run
+ */
+struct SpooledReport {
+    std::wstring path{};    ///< Report archive, or directory of a report spooled by an older version
+    CrashReportData data{}; ///< Report data pointing into the archive or directory
+};
+
+/**
+ * @brief On-disk spool for reports whose upload failed
+ *
+ * Storing runs with the deadline nearly spent, so the dump and error file
+ * are moved into a directory beside copies of the game logs and a UTF-8
+ * `report.txt` manifest of `key=value` lines. Pack() later turns such a
+ * directory into one archive (see report_archive.h), which is uploaded in
+ * place. Entries are written under a `.tmp` name and renamed once complete,
+ * LoadPending() deletes temporary entries a killed process left behind.
+ *
+ * Senders and the daemon may drain the spool at the same time, each report
+ * is sent only under its claim, a lock on `<report>.lock` beside it.
+ */
+class ReportSpool {
+public:
+    static constexpr std::wstring_view kSpoolDirectory = L"CrashSpool";
+    static constexpr std::chrono::hours kMaxAge{ 7 * 24 }; ///< Reports spooled longer ago are dropped unsent
+
+    /**
+     * @brief Move the report into the spool, the dump and error file are moved, the logs copied
+     * @param data Crash report data, an archive of the caller is copied
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if the report was stored
+     */
+    [[nodiscard]]
+    static bool Store(const CrashReportData& data, std::string& error_message) noexcept;
+
+    /**
+     * @brief Load all reports stored by earlier runs, oldest first
+     */
+    [[nodiscard]]
+    static std::vector<SpooledReport> LoadPending() noexcept;
+
+    /**
+     * @brief Claim a report before sending it
+     * @param claim Holds the claim until closed, the system releases it when the process dies
+     * @return false if another process sends the report or it is gone already
+     */
+    [[nodiscard]]
+    static bool Claim(const SpooledReport& report, FileHandle& claim) noexcept;
+
+    /**
+     * @brief Replace a spooled directory by an archive, for callers without a deadline
+     * @param report Claimed report, points to the archive afterwards
+     * @param claim Claim of the report, moves to the archive
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if the report is an archive now, on false it is left as it was
+     */
+    [[nodiscard]]
+    static bool Pack(SpooledReport& report, FileHandle& claim, std::string& error_message) noexcept;
+
+    /**
+     * @brief Delete a spooled report after it was delivered, together with its claim file
+     */
+    static void Remove(const SpooledReport& report) noexcept;
+
+private:
+    static constexpr std::wstring_view kManifestName = L"report.txt";
+    static constexpr std::wstring_view kClaimExtension = L".lock";
+};
+
+} // namespace CrashSender
@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "crash_report_data_builder.h"
+#include "file_system.h"
+#include "http_client.h"
+#include "ipc_channel.h"
+#include "upload_coordinator.h"
+#include "sender_daemon.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr std::string_view REQUEST_TERMINATOR = "\n\n";
+    constexpr std::chrono::milliseconds ACCEPT_INTERVAL{ 500 };
+
+    /// Request keys with string values, every other key carries a decimal number
+    constexpr std::array<std::string_view, 8> TEXT_KEYS = {
+        "url", "version", "error", "dump", "gamelog", "networklog", "signature", "archive"
+    };
+
+    /**
+     * @brief Append one request line, false if the value would break the framing
+     */
+    bool AppendField(std::string& message, std::string_view key, std::string_view value) {
+        if (value.find_first_of("\r\n") != std::string_view::npos) {
+            return false;
+        }
+        message.append(key).append("=").append(value).append("\n");
+        return true;
+    }
+
+    bool AppendField(std::string& message, std::string_view key, const std::wstring& value) {
+        return AppendField(message, key, std::string_view(TextUtils::WideToUtf8(value)));
+    }
+
+    bool ParseNumber(std::string_view value, uint64_t& number) noexcept {
+        const char* end = value.data() + value.size();
+        const auto [parsed_end, error] = std::from_chars(value.data(), end, number);
+        return error == std::errc{} && parsed_end == end;
+    }
+
+    /**
+     * @brief Paths are resolved against the daemon directory otherwise
+     */
+    std::wstring AbsolutePath(const std::wstring& path) {
+        if (path.empty()) {
+            return path;
+        }
+        std::error_code ec;
+        const auto absolute = std::filesystem::absolute(std::filesystem::path(path), ec);
+        return ec ? path : absolute.wstring();
+    }
+
+    /**
+     * @brief Report fields of a queued report on top of the daemon transport settings
+     */
+    CrashReportData MergeReport(const CrashReportData& options, const CrashReportData& report) {
+        CrashReportData data = options;
+        data.url = report.url;
+        data.urls = report.urls;
+        data.version = report.version;
+        data.error = report.error;
+        data.signature = report.signature;
+        data.archive_path = report.archive_path;
+        data.temp_path = report.temp_path;
+        data.dump_path = report.dump_path;
+        data.game_log_path = report.game_log_path;
+        data.network_log_path = report.network_log_path;
+        return data;
+    }
+
+} // anonymous namespace
+
+SenderDaemon::SenderDaemon(const CrashReportData& options) : options_(options) {
+}
+
+SenderDaemon::~SenderDaemon() = default;
+
+bool SenderDaemon::Run(const CancellationToken& token, std::string& error_message) noexcept {
+    std::vector<std::thread> workers;
+    const auto stop_workers = [&]() noexcept {
+        // Requests being read still reach the queue and get spooled
+        JoinClients(false);
+        Shutdown();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    };
+
+    try {
+        IpcServer server(kChannelName);
+        if (!server.Listen(error_message)) {
+            return false;
+        }
+
+        Logger::LogInfo("Sender daemon started with " + std::to_string(options_.daemon_concurrency) + " workers");
+
+        // Reports left by earlier runs go first
+        for (auto& report : ReportSpool::LoadPending()) {
+            Enqueue(std::move(report));
+        }
+
+        workers.reserve(options_.daemon_concurrency);
+        for (size_t i = 0; i < options_.daemon_concurrency; ++i) {
+            workers.emplace_back([this]() { Worker(); });
+        }
+
+        while (!token.IsCancelled()) {
+            FileHandle client;
+            switch (server.Accept(ACCEPT_INTERVAL, client)) {
+            case IpcServer::AcceptResult::Accepted:
+                StartClient(std::move(client));
+                break;
+            case IpcServer::AcceptResult::Timeout:
+                break;
+            case IpcServer::AcceptResult::Failed:
+                Logger::LogError("Failed to accept IPC client");
+                std::this_thread::sleep_for(ACCEPT_INTERVAL);
+                break;
+            }
+        }
+
+        Logger::LogInfo("Sender daemon stopping");
+        stop_workers();
+
+        // Nothing queued is lost, the next run picks it up from the spool
+        for (const auto& job : queue_) {
+            std::string spool_error;
+            if (job.path.empty() && !ReportSpool::Store(job.data, spool_error)) {
+                Logger::LogError("Failed to spool crash report: " + spool_error);
+            }
+        }
+        queue_.clear();
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception in sender daemon: " + std::string(e.what());
+        stop_workers();
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception in sender daemon";
+        stop_workers();
+        return false;
+    }
+}
+
+bool SenderDaemon::Submit(const CrashReportData& data, std::string& error_message) noexcept {
+    try {
+        FileHandle stream;
+        if (!IpcChannel::Connect(kChannelName, stream)) {
+            error_message = "No sender daemon is running";
+            return false;
+        }
+
+        std::string message;
+        bool framed = true;
+        for (const auto& url : data.urls.empty() ? std::vector<std::wstring>{ data.url } : data.urls) {
+            framed = framed && AppendField(message, "url", url);
+        }
+        framed = framed && AppendField(message, "version", data.version);
+        framed = framed && AppendField(message, "error", AbsolutePath(data.temp_path));
+        framed = framed && AppendField(message, "dump", AbsolutePath(data.dump_path));
+        framed = framed && AppendField(message, "gamelog", AbsolutePath(data.game_log_path));
+        framed = framed && AppendField(message, "networklog", AbsolutePath(data.network_log_path));
+        framed = framed && AppendField(message, "signature", data.signature);
+        framed = framed && AppendField(message, "archive", AbsolutePath(data.archive_path));
+
+        // Upload options of the report, the daemon only keeps its own for spooled reports
+        const auto append_number = [&](std::string_view key, uint64_t value) {
+            framed = framed && AppendField(message, key, std::string_view(std::to_string(value)));
+        };
+        append_number("parallel", data.parallel_uploads);
+        append_number("partsize", data.part_size);
+        append_number("ratelimit", data.rate_limit);
+        append_number("adaptive", data.adaptive_rate);
+        append_number("zerocopy", data.zero_copy);
+        append_number("directio", data.unbuffered_threshold);
+        append_number("compress", data.compress);
+        append_number("maxuploads", data.max_uploads);
+        append_number("collapse", data.collapse_window_ms);
+        append_number("timeout", data.timeout_ms);
+        append_number("connecttimeout", data.connect_timeout_ms);
+        append_number("sendtimeout", data.send_timeout_ms);
+        append_number("receivetimeout", data.receive_timeout_ms);
+        if (!framed) {
+            error_message = "Report contains a line break";
+            return false;
+        }
+        message.append("\n");
+
+        std::string reply;
+        if (!IpcChannel::Send(stream, message, kClientTimeout) ||
+            !IpcChannel::Receive(stream, "\n", reply, kClientTimeout)) {
+            error_message = "Sender daemon did not answer";
+            return false;
+        }
+
+        if (reply != "OK\n") {
+            error_message = reply.starts_with("ERROR ") ? reply.substr(6, reply.size() - 7) : "Malformed daemon reply";
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while submitting to daemon: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while submitting to daemon";
+        return false;
+    }
+}
+
+void SenderDaemon::StartClient(FileHandle client) noexcept {
+    JoinClients(true);
+    if (clients_.size() >= kMaxClients) {
+        // The client falls back to uploading the report itself
+        Logger::LogError("Too many daemon clients, dropping connection");
+        return;
+    }
+
+    try {
+        ClientThread& handler = clients_.emplace_back();
+        handler.thread = std::thread([this, &handler, stream = std::move(client)]() {
+            HandleClient(stream);
+            handler.finished = true;
+        });
+    }
+    catch (...) {
+        // Only the entry of this client has no thread, the client falls back to uploading the report itself
+        if (!clients_.empty() && !clients_.back().thread.joinable()) {
+            clients_.pop_back();
+        }
+        Logger::LogError("Failed to start daemon client thread, dropping connection");
+    }
+}
+
+void SenderDaemon::JoinClients(bool finished_only) noexcept {
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        if (finished_only && !it->finished) {
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        it = clients_.erase(it);
+    }
+}
+
+void SenderDaemon::HandleClient(const FileHandle& client) noexcept {
+    try {
+        std::string message;
+        if (!IpcChannel::Receive(client, REQUEST_TERMINATOR, message, kClientTimeout)) {
+            Logger::LogError("Dropped incomplete daemon request");
+            return;
+        }
+
+        SpooledReport job;
+        std::string parse_error;
+        if (!ParseRequest(message, job.data, parse_error)) {
+            Logger::LogError("Rejected daemon request: " + parse_error);
+            (void)IpcChannel::Send(client, "ERROR " + parse_error + "\n", kClientTimeout);
+            return;
+        }
+
+        // A client that missed the answer sends the report itself, so only an acknowledged report is queued
+        if (!IpcChannel::Send(client, "OK\n", kClientTimeout)) {
+            Logger::LogError("Daemon client disconnected before the report was queued");
+            return;
+        }
+        Logger::LogInfo(L"Queued crash report " + (job.data.archive_path.empty() ? job.data.dump_path : job.data.archive_path));
+        Enqueue(std::move(job));
+    }
+    catch (...) {
+        Logger::LogError("Exception occurred while handling daemon request");
+    }
+}
+
+bool SenderDaemon::ParseRequest(std::string_view message, CrashReportData& data, std::string& error_message) const {
+    // Options a client did not send keep the values the daemon was started with
+    data = MergeReport(options_, CrashReportData{});
+
+    size_t start = 0;
+    while (start < message.size()) {
+        const size_t end = std::min(message.find('\n', start), message.size());
+        const std::string_view line = message.substr(start, end - start);
+        start = end + 1;
+
+        const size_t separator = line.find('=');
+        if (separator == std::string_view::npos) {
+            continue;
+        }
+
+        const std::string_view key = line.substr(0, separator);
+        const std::string_view value = line.substr(separator + 1);
+        uint64_t number = 0;
+        const bool text = std::find(TEXT_KEYS.begin(), TEXT_KEYS.end(), key) != TEXT_KEYS.end();
+        if (!text && !ParseNumber(value, number)) {
+            error_message = "Malformed value of " + std::string(key);
+            return false;
+        }
+        const auto milliseconds = static_cast<uint32_t>(std::min<uint64_t>(number, UINT32_MAX));
+
+        if (key == "url") {
+            data.urls.push_back(TextUtils::Utf8ToWide(value));
+        } else if (key == "version") {
+            data.version = value;
+        } else if (key == "error") {
+            data.temp_path = TextUtils::Utf8ToWide(value);
+        } else if (key == "dump") {
+            data.dump_path = TextUtils::Utf8ToWide(value);
+        } else if (key == "gamelog") {
+            data.game_log_path = TextUtils::Utf8ToWide(value);
+        } else if (key == "networklog") {
+            data.network_log_path = TextUtils::Utf8ToWide(value);
+        } else if (key == "signature") {
+            data.signature = value;
+        } else if (key == "archive") {
+            data.archive_path = TextUtils::Utf8ToWide(value);
+        } else if (key == "parallel") {
+            data.parallel_uploads = static_cast<size_t>(std::max<uint64_t>(number, 1));
+        } else if (key == "partsize") {
+            data.part_size = std::max<uint64_t>(number, 1);
+        } else if (key == "ratelimit") {
+            data.rate_limit = number;
+        } else if (key == "adaptive") {
+            data.adaptive_rate = number != 0;
+        } else if (key == "zerocopy") {
+            data.zero_copy = number != 0;
+        } else if (key == "directio") {
+            data.unbuffered_threshold = number;
+        } else if (key == "compress") {
+            data.compress = number != 0;
+        } else if (key == "maxuploads") {
+            data.max_uploads = static_cast<size_t>(number);
+        } else if (key == "collapse") {
+            data.collapse_window_ms = milliseconds;
+        } else if (key == "timeout") {
+            data.timeout_ms = milliseconds;
+        } else if (key == "connecttimeout") {
+            data.connect_timeout_ms = milliseconds;
+        } else if (key == "sendtimeout") {
+            data.send_timeout_ms = milliseconds;
+        } else if (key == "receivetimeout") {
+            data.receive_timeout_ms = milliseconds;
+        }
+    }
+
+    if (!data.urls.empty()) {
+        data.url = data.urls.front();
+    }
+    if (!data.IsValid()) {
+        error_message = "Missing url, version, or error and dump or archive";
+        return false;
+    }
+
+    CrashReportDataBuilder::ProcessServerUrl(data);
+    if (data.endpoints.empty()) {
+        error_message = "No valid server endpoint";
+        return false;
+    }
+    if (data.archive_path.empty() ? !FileSystem::IsFile(data.dump_path) : !FileSystem::IsFile(data.archive_path)) {
+        error_message = data.archive_path.empty() ? "Dump file does not exist" : "Report archive does not exist";
+        return false;
+    }
+    return true;
+}
+
+void SenderDaemon::Enqueue(SpooledReport job) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(job));
+    }
+    ready_.notify_one();
+}
+
+void SenderDaemon::Worker() noexcept {
+    for (;;) {
+        SpooledReport job;
+        {
+            std::unique_lock lock(mutex_);
+            ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        Process(job);
+    }
+}
+
+void SenderDaemon::Process(const SpooledReport& job) noexcept {
+    try {
+        // Senders started beside the daemon drain the same spool
+        SpooledReport spooled = job;
+        FileHandle claim;
+        if (!job.path.empty()) {
+            if (!ReportSpool::Claim(spooled, claim)) {
+                Logger::LogDebug(L"Skipping spooled crash report claimed elsewhere: " + job.path);
+                return;
+            }
+
+            // Senders spool loose files on their way out, the daemon has no deadline to pack them
+            bool stopping = false;
+            {
+                std::lock_guard lock(mutex_);
+                stopping = stopping_;
+            }
+            std::string pack_error;
+            if (!stopping && !ReportSpool::Pack(spooled, claim, pack_error)) {
+                Logger::LogError("Failed to pack spooled crash report: " + pack_error);
+            }
+        }
+
+        // Reports from clients carry their own options, spooled ones get the daemon's
+        CrashReportData data = job.path.empty() ? job.data : MergeReport(options_, spooled.data);
+        CrashReportDataBuilder::ProcessServerUrl(data);
+        if (!CrashReportDataBuilder::ProcessErrorContent(data)) {
+            Logger::LogError(L"Skipping crash report without error file: " + data.temp_path);
+            return;
+        }
+
+        // Every report gets the full deadline, shutdown cancels it early
+        CancellationToken token;
+        token.SetTimeout(std::chrono::milliseconds(data.timeout_ms));
+        {
+            std::lock_guard lock(mutex_);
+            if (stopping_) {
+                token.Cancel();
+            }
+            active_.push_back(&token);
+        }
+
+        // The cap and signature collapsing also cover senders running beside the daemon
+        bool retryable = true;
+        std::string send_error;
+        const bool sent = UploadCoordinator::Submit(data, token, [&](std::string& upload_error) {
+            return HttpClient::SendCrashReport(data, token, pool_, retryable, upload_error);
+        }, send_error);
+        {
+            std::lock_guard lock(mutex_);
+            std::erase(active_, &token);
+        }
+
+        if (sent) {
+            if (job.path.empty()) {
+                FileUtils::CleanupTempFiles(data);
+            } else {
+                ReportSpool::Remove(spooled);
+            }
+            Logger::LogInfo(L"Crash report sent: " + (data.archive_path.empty() ? data.dump_path : data.archive_path));
+            return;
+        }
+
+        Logger::LogError("Failed to send crash report: " + send_error);
+
+        // A report the server rejected or that cannot be read would fail again on every start
+        if (!retryable) {
+            Logger::LogError(L"Dropping crash report that cannot be sent: " + (job.path.empty() ? data.dump_path : job.path));
+            if (job.path.empty()) {
+                FileUtils::CleanupTempFiles(data);
+            } else {
+                ReportSpool::Remove(spooled);
+            }
+            return;
+        }
+
+        // No client waits for the result, the spool keeps the report for the next start
+        if (job.path.empty()) {
+            std::string spool_error;
+            if (!ReportSpool::Store(data, spool_error)) {
+                Logger::LogError("Failed to spool crash report: " + spool_error);
+            }
+        }
+    }
+    catch (...) {
+        Logger::LogError("Exception occurred while sending queued crash report");
+    }
+}
+
+void SenderDaemon::Shutdown() noexcept {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        for (auto* token : active_) {
+            token->Cancel();
+        }
+    }
+    ready_.notify_all();
+}
+
+} // namespace CrashSender
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "crash_report_data.h"
+#include "connection_pool.h"
+#include "report_spool.h"
+
+namespace CrashSender {
+
+class CancellationToken;
+class FileHandle;
+
+/**
+ * @brief Resident sender taking reports from short-lived clients
+ *
+ * Clients connect over a local IPC channel and send one request of UTF-8
+ * `key=value` lines ended by an empty line. The daemon answers `OK` once the
+ * report is queued, or `ERROR <message>`, and owns the report files from then
+ * on. Each request is read on its own short-lived thread, so a slow client
+ * never holds up the accept loop. A fixed set of workers uploads the queue
+ * over keep-alive connections shared through one pool, so a crash storm costs
+ * neither a process start nor a TCP handshake per report.
+ */
+class SenderDaemon {
+public:
+    static constexpr std::wstring_view kChannelName = L"L2CrashSender";
+    static constexpr std::chrono::milliseconds kClientTimeout{ 5000 };
+    static constexpr size_t kMaxClients = 32; ///< Requests read at the same time, further clients are turned away
+
+    /**
+     * @param options Transport settings applied to every report
+     */
+    explicit SenderDaemon(const CrashReportData& options);
+    ~SenderDaemon();
+
+    // Non-copyable, non-movable
+    SenderDaemon(const SenderDaemon&) = delete;
+    SenderDaemon& operator=(const SenderDaemon&) = delete;
+    SenderDaemon(SenderDaemon&&) = delete;
+    SenderDaemon& operator=(SenderDaemon&&) = delete;
+
+    /**
+     * @brief Serve clients until the token fires, unsent reports are spooled on the way out
+     * @param token Stops the daemon, its deadline is ignored
+     * @param error_message Placeholder for error if it will occurs
+     * @return false if the daemon could not start
+     */
+    [[nodiscard]]
+    bool Run(const CancellationToken& token, std::string& error_message) noexcept;
+
+    /**
+     * @brief Hand a report to a running daemon
+     * @param data Parsed command line, paths are sent as absolute paths
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if the daemon queued the report and took over its files
+     */
+    [[nodiscard]]
+    static bool Submit(const CrashReportData& data, std::string& error_message) noexcept;
+
+private:
+    /**
+     * @brief Thread reading one client request off the accept loop
+     */
+    struct ClientThread {
+        std::thread thread;
+        std::atomic<bool> finished = false;
+    };
+
+    void StartClient(FileHandle client) noexcept;
+    void JoinClients(bool finished_only) noexcept;
+    void HandleClient(const FileHandle& client) noexcept;
+    bool ParseRequest(std::string_view message, CrashReportData& data, std::string& error_message) const;
+    void Enqueue(SpooledReport job);
+    void Worker() noexcept;
+    void Process(const SpooledReport& job) noexcept;
+    void Shutdown() noexcept;
+
+    CrashReportData options_;
+    ConnectionPool pool_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<SpooledReport> queue_; ///< Reports waiting for a worker, path is set for spooled ones
+    std::vector<CancellationToken*> active_; ///< Tokens of reports being uploaded, cancelled on shutdown
+    bool stopping_ = false;
+
+    std::list<ClientThread> clients_; ///< Only touched by the accept loop
+};
+
+} // namespace CrashSender
@@ -0,0 +1,63 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "startup_profile.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr size_t STAGE_COUNT = static_cast<size_t>(StartupProfile::Stage::Count);
+
+    /// Steady clock time of every stage in nanoseconds, 0 until marked
+    std::atomic<int64_t> marks[STAGE_COUNT]{};
+
+} // anonymous namespace
+
+void StartupProfile::Mark(Stage stage) noexcept {
+    const auto index = static_cast<size_t>(stage);
+    if (index >= STAGE_COUNT || marks[index].load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t unmarked = 0;
+    marks[index].compare_exchange_strong(unmarked, now, std::memory_order_relaxed);
+}
+
+std::string StartupProfile::Describe() {
+    const int64_t origin = marks[0].load(std::memory_order_relaxed);
+
+    std::string description = "{";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const int64_t mark = marks[i].load(std::memory_order_relaxed);
+        if (mark == 0 || origin == 0) {
+            continue;
+        }
+        if (description.size() > 1) {
+            description += ",";
+        }
+        description += "\"";
+        description += Name(static_cast<Stage>(i));
+        description += "\":" + std::to_string((mark - origin) / 1000);
+    }
+    return description + "}";
+}
+
+std::string_view StartupProfile::Name(Stage stage) noexcept {
+    switch (stage) {
+    case Stage::Entry:        return "entry";
+    case Stage::Arguments:    return "arguments";
+    case Stage::Logger:       return "logger";
+    case Stage::Report:       return "report";
+    case Stage::Coordination: return "coordination";
+    case Stage::Connect:      return "connect";
+    case Stage::Body:         return "body";
+    case Stage::FirstByte:    return "first_byte";
+    default:                  return "unknown";
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace CrashSender {
+
+/**
+ * @brief Timestamps of the steps between process entry and the first byte of a report on the wire
+ *
+ * The sender marks every stage as it passes it, only the first mark of a
+ * stage counts. A mark is one relaxed atomic store, so the marks are always
+ * taken and -profile-startup only decides whether they are printed.
+ */
+struct StartupProfile {
+    enum class Stage : int {
+        Entry = 0,    ///< main() entered, the origin of all other marks
+        Arguments,    ///< Command line parsed
+        Logger,       ///< Log file opened
+        Report,       ///< Server URLs, log files and error file processed
+        Coordination, ///< Upload slot and crash signature claimed
+        Connect,      ///< Connection to the server set up
+        Body,         ///< Attachments probed and request body built
+        FirstByte,    ///< Request line and headers sent
+        Count
+    };
+
+    /**
+     * @brief Record that a stage was reached, later marks of the same stage are ignored
+     */
+    static void Mark(Stage stage) noexcept;
+
+    /**
+     * @brief All marks as one JSON object, microseconds since Entry, stages not reached are left out
+     */
+    [[nodiscard]]
+    static std::string Describe();
+
+    [[nodiscard]]
+    static std::string_view Name(Stage stage) noexcept;
+};
+
+} // namespace CrashSender
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "endpoint.h"
+
+namespace CrashSender {
+
+class CancellationToken;
+class FileHandle;
+
+/**
+ * @brief Per-phase socket timeouts of a request
+ */
+struct TransportTimeouts {
+    uint32_t connect_ms{ 15000 };
+    uint32_t send_ms{ 60000 };
+    uint32_t receive_ms{ 60000 };
+};
+
+/**
+ * @brief Status and body of a completed HTTP request
+ */
+struct HttpResponse {
+    uint32_t status_code = 0;
+    std::string body{};
+
+    [[nodiscard]]
+    bool IsSuccess() const noexcept {
+        return status_code >= 200 && status_code < 300;
+    }
+
+    [[nodiscard]]
+    std::string Describe() const {
+        std::string description = "HTTP " + std::to_string(status_code);
+        if (!body.empty()) {
+            description += ": " + body;
+        }
+        return description;
+    }
+};
+
+/**
+ * @brief One connection to a report server, requests on it are sequential
+ */
+class HttpConnection {
+public:
+    /// Anything beyond this is an error page or a misbehaving server
+    static constexpr size_t kMaxResponseSize = 64 * 1024;
+
+    virtual ~HttpConnection() = default;
+
+    /**
+     * @brief Send the request line and headers
+     * @param method HTTP method
+     * @param path Server path including the query string
+     * @param headers Extra "Name: value\r\n" lines
+     * @param content_length Exact number of body bytes that will be written
+     * @param timeouts Send and receive timeouts for this request
+     * @param error_message Placeholder for error if it will occurs
+     */
+    [[nodiscard]]
+    virtual bool BeginRequest(std::string_view method, const std::wstring& path, std::string_view headers,
+                              uint64_t content_length, const TransportTimeouts& timeouts,
+                              std::string& error_message) noexcept = 0;
+
+    /**
+     * @brief Write the whole buffer as part of the request body
+     */
+    [[nodiscard]]
+    virtual bool Write(const char* data, size_t size, std::string& error_message) noexcept = 0;
+
+    /**
+     * @brief Whether SendFileRange moves file bytes to the socket without a user space copy
+     */
+    [[nodiscard]]
+    virtual bool CanSendFile() const noexcept {
+        return false;
+    }
+
+    /**
+     * @brief Send a file range as part of the request body straight from the page cache
+     * @param file File opened with Normal or Sequential access
+     */
+    [[nodiscard]]
+    virtual bool SendFileRange(const FileHandle& /*file*/, uint64_t /*offset*/, uint64_t /*size*/,
+                               std::string& error_message) noexcept {
+        error_message = "Zero-copy file transfer is not supported by this transport";
+        return false;
+    }
+
+    /**
+     * @brief Finish the request and read the response, the body is capped at kMaxResponseSize
+     * @return true if a response was received, regardless of the HTTP status
+     */
+    [[nodiscard]]
+    virtual bool EndRequest(HttpResponse& response, const CancellationToken& token, std::string& error_message) noexcept = 0;
+};
+
+/**
+ * @brief Platform HTTP stack, WinINet on Windows and plain sockets elsewhere
+ */
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+
+    /**
+     * @brief Open a connection to an endpoint, safe to call from several threads
+     */
+    [[nodiscard]]
+    virtual std::unique_ptr<HttpConnection> Connect(const Endpoint& endpoint, const TransportTimeouts& timeouts,
+                                                    std::string& error_message) noexcept = 0;
+
+    /**
+     * @brief Create the transport of the current platform
+     * @return Transport, nullptr on failure
+     */
+    [[nodiscard]]
+    static std::unique_ptr<HttpTransport> Create(std::string& error_message) noexcept;
+};
+
+} // namespace CrashSender
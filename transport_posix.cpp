@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "utils.h"
+#include "logger.h"
+#include "file_system.h"
+#include "cancellation_token.h"
+#include "transport.h"
+
+namespace CrashSender {
+
+namespace {
+
+    constexpr std::string_view CRLF = "\r\n";
+
+    // A status line and headers beyond this are not from a report server
+    constexpr size_t MAX_HEADER_SIZE = 64 * 1024;
+
+    // Bodies larger than this are not drained, the connection is dropped instead
+    constexpr uint64_t MAX_DRAIN_SIZE = 1024 * 1024;
+
+    /**
+     * @brief RAII for a socket descriptor
+     */
+    class Socket {
+    public:
+        Socket() = default;
+
+        explicit Socket(int fd) noexcept : fd_(fd) {}
+
+        ~Socket() noexcept {
+            Close();
+        }
+
+        // Non-copyable, movable
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        Socket(Socket&& other) noexcept : fd_(other.fd_) {
+            other.fd_ = -1;
+        }
+
+        Socket& operator=(Socket&& other) noexcept {
+            if (this != &other) {
+                Close();
+                fd_ = other.fd_;
+                other.fd_ = -1;
+            }
+            return *this;
+        }
+
+        [[nodiscard]]
+        int get() const noexcept {
+            return fd_;
+        }
+
+        [[nodiscard]]
+        explicit operator bool() const noexcept {
+            return fd_ >= 0;
+        }
+
+        void Close() noexcept {
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+            fd_ = -1;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    void SetSocketTimeout(int fd, int option, uint32_t timeout_ms) noexcept {
+        // Zero would mean "no timeout" to the kernel
+        timeout_ms = std::max<uint32_t>(timeout_ms, 1);
+        timeval timeout{};
+        timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000);
+        timeout.tv_usec = static_cast<suseconds_t>((timeout_ms % 1000) * 1000);
+        setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+    }
+
+    /**
+     * @brief Connect with a timeout, trying every resolved address in turn
+     */
+    Socket OpenSocket(const Endpoint& endpoint, uint32_t timeout_ms, std::string& error_message) noexcept {
+        try {
+            const std::string host = TextUtils::WideToUtf8(endpoint.host);
+            const std::string port = std::to_string(endpoint.port);
+
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo* addresses = nullptr;
+            const int resolved = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+            if (resolved != 0) {
+                error_message = "Failed to resolve server: " + host + " (" + gai_strerror(resolved) + ")";
+                return Socket{};
+            }
+
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max<uint32_t>(timeout_ms, 1));
+            Socket socket;
+            for (const addrinfo* address = addresses; address && !socket; address = address->ai_next) {
+                Socket candidate(::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol));
+                if (!candidate) {
+                    continue;
+                }
+
+                // Non-blocking connect so the timeout is ours, not the kernel's SYN retry schedule
+                const int flags = fcntl(candidate.get(), F_GETFL, 0);
+                fcntl(candidate.get(), F_SETFL, flags | O_NONBLOCK);
+
+                if (connect(candidate.get(), address->ai_addr, address->ai_addrlen) != 0) {
+                    if (errno != EINPROGRESS) {
+                        continue;
+                    }
+
+                    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                    pollfd descriptor{ candidate.get(), POLLOUT, 0 };
+                    if (remaining <= 0 || poll(&descriptor, 1, static_cast<int>(remaining)) != 1) {
+                        continue;
+                    }
+
+                    int socket_error = 0;
+                    socklen_t length = sizeof(socket_error);
+                    if (getsockopt(candidate.get(), SOL_SOCKET, SO_ERROR, &socket_error, &length) != 0 || socket_error != 0) {
+                        continue;
+                    }
+                }
+
+                fcntl(candidate.get(), F_SETFL, flags);
+                const int enable = 1;
+                setsockopt(candidate.get(), IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+                socket = std::move(candidate);
+            }
+            freeaddrinfo(addresses);
+
+            if (!socket) {
+                error_message = "Failed to connect to server: " + host;
+            }
+            return socket;
+        }
+        catch (...) {
+            error_message = "Unknown exception while connecting to server";
+            return Socket{};
+        }
+    }
+
+    bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    std::string_view Trim(std::string_view value) noexcept {
+        const auto begin = value.find_first_not_of(" \t");
+        if (begin == std::string_view::npos) {
+            return {};
+        }
+        const auto end = value.find_last_not_of(" \t");
+        return value.substr(begin, end - begin + 1);
+    }
+
+    /**
+     * @brief HTTP/1.1 over a plain TCP socket with keep-alive
+     */
+    class SocketConnection final : public HttpConnection {
+    public:
+        SocketConnection(Socket socket, const Endpoint& endpoint, const TransportTimeouts& timeouts)
+            : socket_(std::move(socket)), endpoint_(endpoint), connect_timeout_ms_(timeouts.connect_ms) {}
+
+        bool BeginRequest(std::string_view method, const std::wstring& path, std::string_view headers,
+                          uint64_t content_length, const TransportTimeouts& timeouts,
+                          std::string& error_message) noexcept override {
+            try {
+                // The server may have dropped an idle keep-alive connection, and a request
+                // abandoned halfway leaves the stream in an unknown state
+                if (socket_ && (request_open_ || !IsAlive())) {
+                    socket_.Close();
+                }
+                if (!socket_) {
+                    socket_ = OpenSocket(endpoint_, connect_timeout_ms_, error_message);
+                    if (!socket_) {
+                        return false;
+                    }
+                    buffer_.clear();
+                }
+
+                SetSocketTimeout(socket_.get(), SO_SNDTIMEO, timeouts.send_ms);
+                SetSocketTimeout(socket_.get(), SO_RCVTIMEO, timeouts.receive_ms);
+
+                head_request_ = method == "HEAD";
+
+                std::string host = TextUtils::WideToUtf8(endpoint_.host);
+                if (host.find(':') != std::string::npos) {
+                    host = "[" + host + "]";
+                }
+                if (endpoint_.port != 80) {
+                    host.append(":");
+                    host.append(std::to_string(endpoint_.port));
+                }
+
+                std::string request;
+                request.reserve(256 + headers.size());
+                request.append(method).append(" ").append(TextUtils::WideToUtf8(path)).append(" HTTP/1.1").append(CRLF);
+                request.append("Host: ").append(host).append(CRLF);
+                request.append("User-Agent: L2CrashSender/1.0").append(CRLF);
+                if (!head_request_) {
+                    request.append("Content-Length: ").append(std::to_string(content_length)).append(CRLF);
+                }
+                request.append(headers);
+                request.append(CRLF);
+
+                if (!SendAll(request.data(), request.size())) {
+                    error_message = "Failed to prepare HTTP request";
+                    socket_.Close();
+                    return false;
+                }
+                request_open_ = true;
+                return true;
+            }
+            catch (...) {
+                error_message = "Unknown exception while preparing HTTP request";
+                return false;
+            }
+        }
+
+        bool Write(const char* data, size_t size, std::string& error_message) noexcept override {
+            if (!SendAll(data, size)) {
+                error_message = "Failed to upload form data";
+                socket_.Close();
+                return false;
+            }
+            return true;
+        }
+
+#ifdef __linux__
+        bool CanSendFile() const noexcept override {
+            return true;
+        }
+
+        bool SendFileRange(const FileHandle& file, uint64_t offset, uint64_t size, std::string& error_message) noexcept override {
+            // The kernel moves page cache pages to the socket, file bytes never enter user space
+            auto position = static_cast<off_t>(offset);
+            while (size > 0) {
+                constexpr uint64_t max_transfer = 0x7FFFF000; // Linux caps a single call at this
+                const ssize_t sent = sendfile(socket_.get(), file.get(), &position,
+                                              static_cast<size_t>(std::min(size, max_transfer)));
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent <= 0) {
+                    error_message = sent == 0 ? "File ended before the expected size"
+                                              : "Failed to upload form data";
+                    socket_.Close();
+                    return false;
+                }
+                size -= static_cast<uint64_t>(sent);
+            }
+            return true;
+        }
+#endif
+
+        bool EndRequest(HttpResponse& response, const CancellationToken& token, std::string& error_message) noexcept override {
+            try {
+                response.body.clear();
+                request_open_ = false;
+                const bool received = ReadResponse(response, token, error_message);
+                if (!received || !keep_alive_) {
+                    socket_.Close();
+                }
+                return received;
+            }
+            catch (const std::exception& e) {
+                error_message = "Exception while reading HTTP response: " + std::string(e.what());
+                socket_.Close();
+                return false;
+            }
+            catch (...) {
+                error_message = "Unknown exception while reading HTTP response";
+                socket_.Close();
+                return false;
+            }
+        }
+
+    private:
+        [[nodiscard]]
+        bool IsAlive() const noexcept {
+            pollfd descriptor{ socket_.get(), POLLIN, 0 };
+            if (poll(&descriptor, 1, 0) == 0) {
+                return true;
+            }
+            // Readable while idle means either EOF or garbage, neither is usable
+            return false;
+        }
+
+        [[nodiscard]]
+        bool SendAll(const char* data, size_t size) noexcept {
+            while (size > 0) {
+                const ssize_t sent = send(socket_.get(), data, size, MSG_NOSIGNAL);
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent <= 0) {
+                    return false;
+                }
+                data += sent;
+                size -= static_cast<size_t>(sent);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Receive more bytes into the read buffer
+         * @return false on error, timeout or end of stream
+         */
+        [[nodiscard]]
+        bool Fill(const CancellationToken& token, std::string& error_message) {
+            if (token.IsCancelled()) {
+                error_message = "Response read cancelled";
+                return false;
+            }
+
+            char chunk[16 * 1024];
+            for (;;) {
+                const ssize_t received = recv(socket_.get(), chunk, sizeof(chunk), 0);
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (received < 0) {
+                    error_message = errno == EAGAIN || errno == EWOULDBLOCK ? "Timed out waiting for server response"
+                                                                           : "Failed to read server response";
+                    return false;
+                }
+                if (received == 0) {
+                    return false;
+                }
+                buffer_.append(chunk, static_cast<size_t>(received));
+                return true;
+            }
+        }
+
+        [[nodiscard]]
+        bool ReadLine(std::string& line, const CancellationToken& token, std::string& error_message) {
+            for (;;) {
+                const auto end = buffer_.find(CRLF);
+                if (end != std::string::npos) {
+                    line = buffer_.substr(0, end);
+                    buffer_.erase(0, end + CRLF.size());
+                    return true;
+                }
+                if (buffer_.size() > MAX_HEADER_SIZE) {
+                    error_message = "Server response header is too large";
+                    return false;
+                }
+                if (!Fill(token, error_message)) {
+                    if (error_message.empty()) {
+                        error_message = "Connection closed by server";
+                    }
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * @brief Consume body bytes, keeping what fits under the response cap
+         */
+        void Consume(HttpResponse& response, size_t size) {
+            const size_t keep = std::min(size, kMaxResponseSize - std::min(kMaxResponseSize, response.body.size()));
+            response.body.append(buffer_, 0, keep);
+            buffer_.erase(0, size);
+        }
+
+        [[nodiscard]]
+        bool ReadFixedBody(HttpResponse& response, uint64_t length, const CancellationToken& token, std::string& error_message) {
+            if (length > kMaxResponseSize) {
+                Logger::LogError("Server response truncated at " + std::to_string(kMaxResponseSize) + " bytes");
+            }
+            if (length > kMaxResponseSize + MAX_DRAIN_SIZE) {
+                keep_alive_ = false;
+                length = kMaxResponseSize;
+            }
+
+            while (length > 0) {
+                if (buffer_.empty() && !Fill(token, error_message)) {
+                    if (error_message.empty()) {
+                        error_message = "Connection closed by server";
+                    }
+                    return false;
+                }
+                const auto size = static_cast<size_t>(std::min<uint64_t>(length, buffer_.size()));
+                Consume(response, size);
+                length -= size;
+            }
+            return true;
+        }
+
+        [[nodiscard]]
+        bool ReadChunkedBody(HttpResponse& response, const CancellationToken& token, std::string& error_message) {
+            std::string line;
+            uint64_t total = 0;
+            for (;;) {
+                if (!ReadLine(line, token, error_message)) {
+                    return false;
+                }
+
+                size_t chunk_size = 0;
+                try {
+                    chunk_size = std::stoull(line, nullptr, 16);
+                }
+                catch (...) {
+                    error_message = "Invalid chunked response from server";
+                    return false;
+                }
+
+                if (chunk_size == 0) {
+                    // Skip trailers up to the final empty line
+                    do {
+                        if (!ReadLine(line, token, error_message)) {
+                            return false;
+                        }
+                    } while (!line.empty());
+                    return true;
+                }
+
+                total += chunk_size;
+                if (total > kMaxResponseSize + MAX_DRAIN_SIZE) {
+                    error_message = "Server response is too large";
+                    return false;
+                }
+
+                if (!ReadFixedBody(response, chunk_size, token, error_message) || !ReadLine(line, token, error_message)) {
+                    return false;
+                }
+            }
+        }
+
+        [[nodiscard]]
+        bool ReadResponse(HttpResponse& response, const CancellationToken& token, std::string& error_message) {
+            std::string line;
+            bool chunked = false;
+            bool has_content_length = false;
+            uint64_t content_length = 0;
+
+            // Interim 1xx responses are followed by the real one
+            do {
+                if (!ReadLine(line, token, error_message)) {
+                    return false;
+                }
+
+                // "HTTP/1.1 200 OK"
+                const auto space = line.find(' ');
+                if (line.compare(0, 5, "HTTP/") != 0 || space == std::string::npos) {
+                    error_message = "Invalid response from server";
+                    return false;
+                }
+
+                try {
+                    response.status_code = static_cast<uint32_t>(std::stoul(line.substr(space + 1, 3)));
+                }
+                catch (...) {
+                    error_message = "Failed to query HTTP status";
+                    return false;
+                }
+
+                keep_alive_ = line.compare(0, 8, "HTTP/1.0") != 0;
+                chunked = false;
+                has_content_length = false;
+                content_length = 0;
+
+                for (;;) {
+                    if (!ReadLine(line, token, error_message)) {
+                        return false;
+                    }
+                    if (line.empty()) {
+                        break;
+                    }
+
+                    const auto colon = line.find(':');
+                    if (colon == std::string::npos) {
+                        continue;
+                    }
+
+                    const std::string_view name = Trim(std::string_view(line).substr(0, colon));
+                    const std::string_view value = Trim(std::string_view(line).substr(colon + 1));
+                    if (EqualsIgnoreCase(name, "Content-Length")) {
+                        try {
+                            content_length = std::stoull(std::string(value));
+                            has_content_length = true;
+                        }
+                        catch (...) {
+                            error_message = "Invalid Content-Length from server";
+                            return false;
+                        }
+                    } else if (EqualsIgnoreCase(name, "Transfer-Encoding")) {
+                        chunked = EqualsIgnoreCase(value, "chunked");
+                    } else if (EqualsIgnoreCase(name, "Connection")) {
+                        if (EqualsIgnoreCase(value, "close")) {
+                            keep_alive_ = false;
+                        } else if (EqualsIgnoreCase(value, "keep-alive")) {
+                            keep_alive_ = true;
+                        }
+                    }
+                }
+            } while (response.status_code >= 100 && response.status_code < 200);
+
+            // HEAD, 204 and 304 never carry a body whatever the headers say
+            if (head_request_ || response.status_code == 204 || response.status_code == 304) {
+                return true;
+            }
+
+            if (chunked) {
+                return ReadChunkedBody(response, token, error_message);
+            }
+
+            if (has_content_length) {
+                return ReadFixedBody(response, content_length, token, error_message);
+            }
+
+            // No framing, the body ends when the server closes the connection
+            keep_alive_ = false;
+            for (;;) {
+                Consume(response, buffer_.size());
+                if (response.body.size() >= kMaxResponseSize) {
+                    Logger::LogError("Server response truncated at " + std::to_string(kMaxResponseSize) + " bytes");
+                    return true;
+                }
+                if (!Fill(token, error_message)) {
+                    return error_message.empty();
+                }
+            }
+        }
+
+        Socket socket_;
+        Endpoint endpoint_;
+        uint32_t connect_timeout_ms_;
+        std::string buffer_;
+        bool head_request_ = false;
+        bool request_open_ = false;
+        bool keep_alive_ = true;
+    };
+
+    /**
+     * @brief Plain sockets, only http:// endpoints are supported
+     */
+    class SocketTransport final : public HttpTransport {
+    public:
+        std::unique_ptr<HttpConnection> Connect(const Endpoint& endpoint, const TransportTimeouts& timeouts,
+                                                std::string& error_message) noexcept override {
+            try {
+                if (endpoint.secure) {
+                    error_message = "HTTPS is not supported by the POSIX transport";
+                    return nullptr;
+                }
+
+                Socket socket = OpenSocket(endpoint, timeouts.connect_ms, error_message);
+                if (!socket) {
+                    return nullptr;
+                }
+                return std::make_unique<SocketConnection>(std::move(socket), endpoint, timeouts);
+            }
+            catch (...) {
+                error_message = "Unknown exception while connecting to server";
+                return nullptr;
+            }
+        }
+    };
+
+} // anonymous namespace
+
+std::unique_ptr<HttpTransport> HttpTransport::Create(std::string& error_message) noexcept {
+    try {
+        return std::make_unique<SocketTransport>();
+    }
+    catch (...) {
+        error_message = "Failed to create HTTP transport";
+        return nullptr;
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,250 @@
+#include <algorithm>
+
+#include <windows.h>
+#include <wininet.h>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "transport.h"
+
+#pragma comment(lib, "wininet.lib")
+
+namespace CrashSender {
+
+namespace {
+
+    /**
+     * @brief RAII wrapper for WinINet handles
+     */
+    class InternetHandle {
+    public:
+        InternetHandle() = default;
+
+        explicit InternetHandle(HINTERNET handle) noexcept : handle_(handle) {}
+
+        ~InternetHandle() noexcept {
+            if (handle_) {
+                InternetCloseHandle(handle_);
+            }
+        }
+
+        // Non-copyable, movable
+        InternetHandle(const InternetHandle&) = delete;
+        InternetHandle& operator=(const InternetHandle&) = delete;
+
+        InternetHandle(InternetHandle&& other) noexcept : handle_(other.handle_) {
+            other.handle_ = nullptr;
+        }
+
+        InternetHandle& operator=(InternetHandle&& other) noexcept {
+            if (this != &other) {
+                if (handle_) {
+                    InternetCloseHandle(handle_);
+                }
+                handle_ = other.handle_;
+                other.handle_ = nullptr;
+            }
+            return *this;
+        }
+
+        [[nodiscard]]
+        HINTERNET get() const noexcept {
+            return handle_;
+        }
+
+        [[nodiscard]]
+        explicit operator bool() const noexcept {
+            return handle_ != nullptr;
+        }
+
+    private:
+        HINTERNET handle_ = nullptr;
+    };
+
+    /**
+     * @brief Set per-phase timeouts on a WinINet handle
+     */
+    void ApplyTimeouts(HINTERNET handle, const TransportTimeouts& timeouts) noexcept {
+        const auto set_timeout = [&](DWORD option, uint32_t timeout_ms) {
+            // Zero would mean "no timeout" to WinINet
+            auto timeout = static_cast<DWORD>(std::max<uint32_t>(timeout_ms, 1));
+            InternetSetOptionW(handle, option, &timeout, sizeof(timeout));
+        };
+
+        set_timeout(INTERNET_OPTION_CONNECT_TIMEOUT, timeouts.connect_ms);
+        set_timeout(INTERNET_OPTION_SEND_TIMEOUT, timeouts.send_ms);
+        set_timeout(INTERNET_OPTION_RECEIVE_TIMEOUT, timeouts.receive_ms);
+    }
+
+    /**
+     * @brief Connection handle of a WinINet session, WinINet itself pools the sockets
+     */
+    class WinInetConnection final : public HttpConnection {
+    public:
+        WinInetConnection(InternetHandle connect, const Endpoint& endpoint, const TransportTimeouts& timeouts)
+            : connect_(std::move(connect)), secure_(endpoint.secure), connect_timeout_ms_(timeouts.connect_ms) {}
+
+        bool BeginRequest(std::string_view method, const std::wstring& path, std::string_view headers,
+                          uint64_t content_length, const TransportTimeouts& timeouts,
+                          std::string& error_message) noexcept override {
+            try {
+                const DWORD flags = INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD | (secure_ ? INTERNET_FLAG_SECURE : 0);
+                const std::wstring verb = TextUtils::Utf8ToWide(method);
+                request_ = InternetHandle(HttpOpenRequestW(connect_.get(), verb.c_str(), path.c_str(),
+                                                           L"HTTP/1.1", nullptr, nullptr, flags, 0));
+                if (!request_) {
+                    error_message = "Failed to create HTTP request";
+                    return false;
+                }
+
+                ApplyTimeouts(request_.get(), TransportTimeouts{ connect_timeout_ms_, timeouts.send_ms, timeouts.receive_ms });
+
+                // Set HTTP headers
+                const std::wstring wide_headers = TextUtils::Utf8ToWide(headers);
+                if (!wide_headers.empty() &&
+                    !HttpAddRequestHeadersW(request_.get(), wide_headers.data(), static_cast<DWORD>(wide_headers.size()),
+                                            HTTP_ADDREQ_FLAG_ADD | HTTP_ADDREQ_FLAG_REPLACE)) {
+                    error_message = "Failed to add HTTP headers";
+                    return false;
+                }
+
+                if (content_length > MAXDWORD) {
+                    error_message = "Request body is too large: " + std::to_string(content_length) + " bytes";
+                    return false;
+                }
+
+                // Prepare request
+                INTERNET_BUFFERSW buffers{};
+                buffers.dwStructSize = sizeof(INTERNET_BUFFERSW);
+                buffers.dwBufferTotal = static_cast<DWORD>(content_length);
+
+                if (!HttpSendRequestExW(request_.get(), &buffers, nullptr, 0, 0)) {
+                    error_message = "Failed to prepare HTTP request";
+                    return false;
+                }
+                return true;
+            }
+            catch (...) {
+                error_message = "Unknown exception while preparing HTTP request";
+                return false;
+            }
+        }
+
+        bool Write(const char* data, size_t size, std::string& error_message) noexcept override {
+            while (size > 0) {
+                DWORD bytes_written = 0;
+                const auto chunk = static_cast<DWORD>(std::min<size_t>(size, MAXDWORD));
+                if (!InternetWriteFile(request_.get(), data, chunk, &bytes_written) || bytes_written == 0) {
+                    error_message = "Failed to upload form data";
+                    return false;
+                }
+                data += bytes_written;
+                size -= bytes_written;
+            }
+            return true;
+        }
+
+        bool EndRequest(HttpResponse& response, const CancellationToken& token, std::string& error_message) noexcept override {
+            try {
+                if (!HttpEndRequestW(request_.get(), nullptr, 0, 0)) {
+                    error_message = "Failed to finalize HTTP request";
+                    return false;
+                }
+
+                // Check HTTP status code
+                DWORD status_code = 0;
+                DWORD status_size = sizeof(status_code);
+                if (!HttpQueryInfoW(request_.get(), HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
+                                    &status_code, &status_size, nullptr)) {
+                    error_message = "Failed to query HTTP status";
+                    return false;
+                }
+                response.status_code = status_code;
+
+                // Read response body, the size cap and the deadline bound this loop
+                response.body.clear();
+                char buffer[4096] = {};
+                DWORD bytes_read = 0;
+                while (InternetReadFile(request_.get(), buffer, sizeof(buffer), &bytes_read) && bytes_read > 0) {
+                    if (token.IsCancelled()) {
+                        error_message = "Response read cancelled";
+                        return false;
+                    }
+                    if (response.body.size() + bytes_read > kMaxResponseSize) {
+                        response.body.append(buffer, kMaxResponseSize - response.body.size());
+                        Logger::LogError("Server response truncated at " + std::to_string(kMaxResponseSize) + " bytes");
+                        break;
+                    }
+                    response.body.append(buffer, bytes_read);
+                }
+
+                request_ = InternetHandle{};
+                return true;
+            }
+            catch (const std::exception& e) {
+                error_message = "Exception while reading HTTP response: " + std::string(e.what());
+                return false;
+            }
+            catch (...) {
+                error_message = "Unknown exception while reading HTTP response";
+                return false;
+            }
+        }
+
+    private:
+        InternetHandle connect_;
+        InternetHandle request_;
+        bool secure_;
+        uint32_t connect_timeout_ms_;
+    };
+
+    /**
+     * @brief WinINet session, the handle is shared by all connections
+     */
+    class WinInetTransport final : public HttpTransport {
+    public:
+        explicit WinInetTransport(InternetHandle internet) : internet_(std::move(internet)) {}
+
+        std::unique_ptr<HttpConnection> Connect(const Endpoint& endpoint, const TransportTimeouts& timeouts,
+                                                std::string& error_message) noexcept override {
+            try {
+                InternetHandle connect(InternetConnectW(internet_.get(), endpoint.host.c_str(),
+                                                        endpoint.port, nullptr, nullptr,
+                                                        INTERNET_SERVICE_HTTP, 0, 0));
+                if (!connect) {
+                    error_message = "Failed to connect to server: " + TextUtils::WideToUtf8(endpoint.host);
+                    return nullptr;
+                }
+
+                ApplyTimeouts(connect.get(), timeouts);
+                return std::make_unique<WinInetConnection>(std::move(connect), endpoint, timeouts);
+            }
+            catch (...) {
+                error_message = "Unknown exception while connecting to server";
+                return nullptr;
+            }
+        }
+
+    private:
+        InternetHandle internet_;
+    };
+
+} // anonymous namespace
+
+std::unique_ptr<HttpTransport> HttpTransport::Create(std::string& error_message) noexcept {
+    try {
+        InternetHandle internet(InternetOpenW(L"L2CrashSender/1.0", INTERNET_OPEN_TYPE_DIRECT, nullptr, nullptr, 0));
+        if (!internet) {
+            error_message = "Failed to initialize WinINet";
+            return nullptr;
+        }
+        return std::make_unique<WinInetTransport>(std::move(internet));
+    }
+    catch (...) {
+        error_message = "Unknown exception while initializing WinINet";
+        return nullptr;
+    }
+}
+
+} // namespace CrashSender
@@ -0,0 +1,314 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "utils.h"
+#include "logger.h"
+#include "cancellation_token.h"
+#include "file_system.h"
+#include "http_client.h"
+#include "startup_profile.h"
+#include "upload_coordinator.h"
+
+namespace CrashSender {
+
+namespace {
+
+    int64_t NowMs() noexcept {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+} // anonymous namespace
+
+bool UploadCoordinator::Submit(CrashReportData& data, const CancellationToken& token, const Upload& upload,
+                               std::string& error_message) noexcept {
+    try {
+        data.signature = Signature(data);
+        const bool collapse = data.collapse_window_ms > 0;
+
+        uint32_t occurrences = 0;
+        Claim claim = collapse ? ClaimSignature(data, occurrences) : Claim::Upload;
+        if (claim == Claim::InFlight) {
+            // The files are only dropped once the other upload is known to have carried the count
+            Logger::LogInfo("Crash " + data.signature + " is being uploaded by another sender, waiting for it");
+            claim = AwaitSignature(data, token);
+            if (claim == Claim::Delivered) {
+                Logger::LogInfo("Crash " + data.signature + " was delivered by another sender, counted there");
+                return true;
+            }
+            if (claim == Claim::InFlight) {
+                error_message = "Upload cancelled while another sender uploads the same crash";
+                return false;
+            }
+            Logger::LogInfo("Other upload of crash " + data.signature + " failed, sending this report");
+        }
+
+        if (claim == Claim::Delivered) {
+            std::string count_error;
+            if (HttpClient::SendOccurrences(data, occurrences, token, count_error)) {
+                return true;
+            }
+
+            // This report is uploaded in full below, earlier occurrences go with its count
+            Logger::LogError("Failed to report crash occurrences: " + count_error);
+            ReturnOccurrences(data, occurrences - 1);
+        }
+
+        FileHandle slot;
+        if (data.max_uploads > 0 && !AcquireSlot(data.max_uploads, token, slot)) {
+            error_message = "Upload cancelled while waiting for an upload slot";
+            if (collapse) {
+                (void)FinishSignature(data, false);
+            }
+            return false;
+        }
+
+        StartupProfile::Mark(StartupProfile::Stage::Coordination);
+        const bool sent = upload(error_message);
+        slot.Close();
+
+        if (collapse) {
+            const uint32_t counted = FinishSignature(data, sent);
+            std::string count_error;
+            if (counted > 0 && !HttpClient::SendOccurrences(data, counted, token, count_error)) {
+                Logger::LogError("Failed to report crash occurrences: " + count_error);
+                ReturnOccurrences(data, counted);
+            }
+        }
+        return sent;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while coordinating upload: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while coordinating upload";
+        return false;
+    }
+}
+
+std::string UploadCoordinator::Signature(const CrashReportData& data) {
+    // FNV-1a is plenty to tell crashes of one machine apart
+    uint64_t hash = 14695981039346656037ull;
+    const auto mix = [&](std::string_view bytes) {
+        for (const unsigned char c : bytes) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+    };
+    mix(data.version);
+    mix("\n");
+    mix(data.error);
+
+    std::ostringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return stream.str();
+}
+
+bool UploadCoordinator::AcquireSlot(size_t max_uploads, const CancellationToken& token, FileHandle& slot) noexcept {
+    try {
+        bool waiting = false;
+        for (;;) {
+            for (size_t i = 0; i < max_uploads; ++i) {
+                if (FileSystem::TryLock(std::wstring(kSlotFile) + std::to_wstring(i), slot)) {
+                    if (waiting) {
+                        Logger::LogInfo("Upload slot acquired");
+                    }
+                    return true;
+                }
+            }
+
+            if (!waiting) {
+                Logger::LogInfo("All " + std::to_string(max_uploads) + " upload slots are busy, waiting");
+                waiting = true;
+            }
+            if (token.IsCancelled()) {
+                return false;
+            }
+            std::this_thread::sleep_for(token.Clamp(kPollInterval));
+        }
+    }
+    catch (...) {
+        // Uncoordinated upload beats none
+        return true;
+    }
+}
+
+bool UploadCoordinator::LockRegistry(FileHandle& lock) noexcept {
+    const auto deadline = std::chrono::steady_clock::now() + kLockTimeout;
+    while (!FileSystem::TryLock(kLockFile, lock)) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            Logger::LogError("Failed to lock crash signature registry");
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+UploadCoordinator::Registry UploadCoordinator::LoadRegistry() {
+    Registry registry;
+    std::ifstream file(std::filesystem::path(kRegistryFile), std::ios::in | std::ios::binary);
+
+    // One "signature<TAB>state<TAB>stamp<TAB>pending" line per crash
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string signature;
+        Entry entry;
+        if (std::getline(fields, signature, '\t') && fields >> entry.state >> entry.stamp_ms >> entry.pending) {
+            registry[signature] = entry;
+        }
+    }
+    return registry;
+}
+
+void UploadCoordinator::SaveRegistry(const Registry& registry) {
+    std::ofstream file(std::filesystem::path(kRegistryFile), std::ios::out | std::ios::binary | std::ios::trunc);
+    for (const auto& [signature, entry] : registry) {
+        file << signature << '\t' << entry.state << '\t' << entry.stamp_ms << '\t'
+             << entry.pending << '\n';
+    }
+}
+
+UploadCoordinator::Claim UploadCoordinator::ClaimSignature(const CrashReportData& data, uint32_t& occurrences) noexcept {
+    try {
+        FileHandle lock;
+        if (!LockRegistry(lock)) {
+            return Claim::Upload;
+        }
+
+        const int64_t now = NowMs();
+        Registry registry = LoadRegistry();
+
+        // Forget delivered crashes past the window, and uploads whose sender died before finishing
+        std::erase_if(registry, [&](const auto& item) {
+            const Entry& entry = item.second;
+            return entry.pending == 0 && now - entry.stamp_ms > data.collapse_window_ms;
+        });
+        for (auto& [signature, entry] : registry) {
+            if (entry.state == 'U' && now - entry.stamp_ms > data.timeout_ms) {
+                entry.state = '-';
+            }
+        }
+
+        Claim claim = Claim::Upload;
+        Entry& entry = registry[data.signature];
+        if (entry.state == 'U') {
+            ++entry.pending;
+            claim = Claim::InFlight;
+        } else if (entry.state == 'D' && now - entry.stamp_ms <= data.collapse_window_ms) {
+            occurrences = entry.pending + 1;
+            entry.pending = 0;
+            claim = Claim::Delivered;
+        } else {
+            entry.state = 'U';
+            entry.stamp_ms = now;
+        }
+
+        SaveRegistry(registry);
+        return claim;
+    }
+    catch (...) {
+        return Claim::Upload;
+    }
+}
+
+uint32_t UploadCoordinator::FinishSignature(const CrashReportData& data, bool delivered) noexcept {
+    try {
+        FileHandle lock;
+        if (!LockRegistry(lock)) {
+            return 0;
+        }
+
+        Registry registry = LoadRegistry();
+        Entry& entry = registry[data.signature];
+        entry.state = delivered ? 'D' : '-';
+        entry.stamp_ms = NowMs();
+
+        // Occurrences counted during a failed upload wait for the next report of the crash
+        uint32_t counted = 0;
+        if (delivered) {
+            counted = entry.pending;
+            entry.pending = 0;
+        }
+
+        SaveRegistry(registry);
+        return counted;
+    }
+    catch (...) {
+        return 0;
+    }
+}
+
+UploadCoordinator::Claim UploadCoordinator::AwaitSignature(const CrashReportData& data, const CancellationToken& token) noexcept {
+    try {
+        for (;;) {
+            const bool give_up = token.IsCancelled();
+            FileHandle lock;
+            if (!LockRegistry(lock)) {
+                if (give_up) {
+                    return Claim::InFlight;
+                }
+                std::this_thread::sleep_for(token.Clamp(kPollInterval));
+                continue;
+            }
+
+            Registry registry = LoadRegistry();
+            Entry& entry = registry[data.signature];
+            if (entry.state == 'U' && NowMs() - entry.stamp_ms > data.timeout_ms) {
+                entry.state = '-';
+            }
+            if (entry.state == 'D') {
+                return Claim::Delivered;
+            }
+
+            if (entry.state == 'U' && !give_up) {
+                lock.Close();
+                std::this_thread::sleep_for(token.Clamp(kPollInterval));
+                continue;
+            }
+
+            // Take back the occurrence counted at the owner, this report now stands on its own
+            if (entry.pending > 0) {
+                --entry.pending;
+            }
+            Claim claim = Claim::InFlight;
+            if (entry.state != 'U') {
+                entry.state = 'U';
+                entry.stamp_ms = NowMs();
+                claim = Claim::Upload;
+            }
+            SaveRegistry(registry);
+            return claim;
+        }
+    }
+    catch (...) {
+        // The occurrence may stay counted at the owner, sending the report again is the safe side
+        return Claim::Upload;
+    }
+}
+
+void UploadCoordinator::ReturnOccurrences(const CrashReportData& data, uint32_t occurrences) noexcept {
+    try {
+        FileHandle lock;
+        if (occurrences == 0 || !LockRegistry(lock)) {
+            return;
+        }
+
+        Registry registry = LoadRegistry();
+        Entry& entry = registry[data.signature];
+        entry.pending += occurrences;
+        if (entry.stamp_ms == 0) {
+            entry.stamp_ms = NowMs();
+        }
+        SaveRegistry(registry);
+    }
+    catch (...) {
+        Logger::LogError("Failed to keep crash occurrences for a later report");
+    }
+}
+
+} // namespace CrashSender
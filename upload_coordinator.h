@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "crash_report_data.h"
+
+namespace CrashSender {
+
+class CancellationToken;
+class FileHandle;
+
+/**
+ * @brief Coordinates sender processes of one machine during a crash storm
+ *
+ * Several game clients crashing together start one sender each. The senders
+ * meet through lock files in the working directory, which the system releases
+ * when a process dies:
+ * - `L2CrashSender.slot<N>` caps the number of uploads running at once;
+ * - `L2CrashSender.signatures`, guarded by `L2CrashSender.lock`, records the
+ *   signature of every recent crash. A report whose crash is already being
+ *   uploaded is only counted, and the count is sent once that upload is done.
+ *   The counted report waits for that upload and takes its occurrence back
+ *   and sends itself if the upload fails.
+ */
+class UploadCoordinator {
+public:
+    static constexpr std::wstring_view kSlotFile = L"L2CrashSender.slot";
+    static constexpr std::wstring_view kLockFile = L"L2CrashSender.lock";
+    static constexpr std::wstring_view kRegistryFile = L"L2CrashSender.signatures";
+    static constexpr std::chrono::milliseconds kPollInterval{ 200 };
+    static constexpr std::chrono::milliseconds kLockTimeout{ 2000 };
+
+    /**
+     * @brief Sends the report, error_message is set on failure
+     */
+    using Upload = std::function<bool(std::string& error_message)>;
+
+    /**
+     * @brief Upload a report under the machine-wide cap, or only count it when the same crash is being sent
+     * @param data Report, its signature is set here
+     * @param token Cancellation and overall deadline, also bounds the wait for an upload slot
+     * @param upload Sends the report while an upload slot is held
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if the report or its occurrence was delivered, the report files are no longer needed.
+     *         A report collapsed into another upload returns once that upload finished, or false if the
+     *         token fired first; the caller keeps the files on false in either case
+     */
+    [[nodiscard]]
+    static bool Submit(CrashReportData& data, const CancellationToken& token, const Upload& upload,
+                       std::string& error_message) noexcept;
+
+    /**
+     * @brief Signature of a crash, equal for reports with the same version and error description
+     */
+    [[nodiscard]]
+    static std::string Signature(const CrashReportData& data);
+
+private:
+    enum class Claim : int {
+        Upload = 0,    ///< First report of the crash, upload it
+        InFlight = 1,  ///< Another sender uploads the same crash and will report the count if it succeeds
+        Delivered = 2  ///< The crash was delivered recently, send only the count
+    };
+
+    struct Entry {
+        char state = '-';       ///< 'U' uploading, 'D' delivered, '-' upload failed
+        int64_t stamp_ms = 0;   ///< Time of the last state change, milliseconds since epoch
+        uint32_t pending = 0;   ///< Occurrences not reported to the server yet
+    };
+
+    using Registry = std::map<std::string, Entry>;
+
+    static bool AcquireSlot(size_t max_uploads, const CancellationToken& token, FileHandle& slot) noexcept;
+    static bool LockRegistry(FileHandle& lock) noexcept;
+    static Registry LoadRegistry();
+    static void SaveRegistry(const Registry& registry);
+
+    static Claim ClaimSignature(const CrashReportData& data, uint32_t& occurrences) noexcept;
+    static Claim AwaitSignature(const CrashReportData& data, const CancellationToken& token) noexcept;
+    static uint32_t FinishSignature(const CrashReportData& data, bool delivered) noexcept;
+    static void ReturnOccurrences(const CrashReportData& data, uint32_t occurrences) noexcept;
+};
+
+} // namespace CrashSender
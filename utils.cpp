@@ -1,32 +1,33 @@
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "utils.h"
 #include "logger.h"
+#include "file_system.h"
 
 namespace CrashSender {
 
-FileGuard::FileGuard(HANDLE h) : handle(h) {
-}
-
-FileGuard::~FileGuard() {
-    if (handle != INVALID_HANDLE_VALUE) {
-        CloseHandle(handle);
-    }
-}
-
 bool FileUtils::RemoveFile(std::wstring_view filename) noexcept {
     try {
         if (filename.empty()) {
             return true;
         }
 
-        const BOOL result = DeleteFile(filename.data());
-        if (!result) {
-            const DWORD error = GetLastError();
-            if (error == ERROR_FILE_NOT_FOUND) {
-                return true; // File doesn't exist, consider it success
-            }
-            Logger::LogError("Failed to delete file: " + TextUtils::WideToUtf8(filename) + " (Error: " + std::to_string(error) + ")");
+        std::string error;
+        if (!FileSystem::Remove(filename, error)) {
+            Logger::LogError("Failed to delete file: " + TextUtils::WideToUtf8(filename) + " (" + error + ")");
             return false;
         }
         
@@ -40,94 +41,96 @@ bool FileUtils::RemoveFile(std::wstring_view filename) noexcept {
 }
 
 bool FileUtils::FileExists(std::wstring_view filename) noexcept {
-    try {
-        if (filename.empty()) {
-            return false;
-        }
-
-        const DWORD attributes = GetFileAttributesW(filename.data());
-        return (attributes != INVALID_FILE_ATTRIBUTES) && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
-    }
-    catch (...) {
+    if (filename.empty()) {
         return false;
     }
+
+    return FileSystem::IsFile(filename);
 }
 
 int64_t FileUtils::GetFileSize(std::wstring_view filename) noexcept {
-    try {
-        if (filename.empty()) {
-            return -1;
-        }
+    if (filename.empty()) {
+        return -1;
+    }
+
+    FileHandle file;
+    if (FileSystem::OpenRead(filename, FileSystem::Access::Normal, file) != FileSystem::OpenResult::Ok) {
+        return -1;
+    }
+
+    return FileSystem::Size(file);
+}
+
+namespace {
+
+    constexpr std::wstring_view SHARED_COPY_PATH = L"L2Second.log";
+
+    /**
+     * @brief Open a file, copying it aside first if another process holds it without read sharing
+     */
+    bool OpenShared(std::wstring_view filepath, FileHandle& file, std::wstring& resolved_path, std::string& error_message) {
+        resolved_path = filepath;
 
-        const HANDLE file_handle = CreateFileW(filename.data(), GENERIC_READ,
-                                             FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-                                             FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (file_handle == INVALID_HANDLE_VALUE) {
-            return -1;
+        const auto result = FileSystem::OpenRead(filepath, FileSystem::Access::Sequential, file);
+        if (result == FileSystem::OpenResult::Ok) {
+            return true;
         }
 
-        FileGuard guard(file_handle);
+        if (result == FileSystem::OpenResult::Busy) {
+            std::string ignored;
+            (void)FileSystem::Remove(SHARED_COPY_PATH, ignored);
+            if (FileSystem::Copy(filepath, SHARED_COPY_PATH) &&
+                FileSystem::OpenRead(SHARED_COPY_PATH, FileSystem::Access::Sequential, file) == FileSystem::OpenResult::Ok) {
+                resolved_path = SHARED_COPY_PATH;
+                return true;
+            }
 
-        LARGE_INTEGER file_size;
-        if (!GetFileSizeEx(file_handle, &file_size)) {
-            return -1;
+            error_message = "Failed to open file(" + TextUtils::WideToUtf8(filepath) + "): File is busy with other process, need to patch process";
+            return false;
         }
 
-        return file_size.QuadPart;
-    }
-    catch (...) {
-        return -1;
+        error_message = "Failed to open file: " + TextUtils::WideToUtf8(filepath);
+        return false;
     }
-}
 
-bool BypassSharingViolation(std::wstring_view filepath, HANDLE & file_handle)
-{
-    CopyFileW(filepath.data(), L"L2Second.log", TRUE);
-    file_handle = CreateFileW(L"L2Second.log", GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    return file_handle != INVALID_HANDLE_VALUE;
-}
+} // anonymous namespace
 
 bool FileUtils::AppendToBuffer(std::wstring_view filepath, std::vector<char>& buffer, std::string& error_message) noexcept {
     const auto initinalSize = buffer.size();
 
     try {
-        HANDLE file_handle = CreateFileW(filepath.data(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (file_handle == INVALID_HANDLE_VALUE) {
-            DWORD error = GetLastError();
-            if (error == ERROR_SHARING_VIOLATION) {
-                if (!BypassSharingViolation(filepath, file_handle)) {
-                    error_message = "Failed to open file(" + TextUtils::WideToUtf8(filepath) + "): File is busy with other process, need to patch process";
-                    return false;
-                }
-            } else {
-                error_message = "Failed to open file: " + TextUtils::WideToUtf8(filepath);
-                return false;
-            }
+        FileHandle file;
+        std::wstring resolved_path;
+        if (!OpenShared(filepath, file, resolved_path, error_message)) {
+            return false;
         }
 
-        FileGuard guard{ file_handle };
-
-        LARGE_INTEGER file_size;
-        if (!GetFileSizeEx(file_handle, &file_size)) {
+        const int64_t file_size = FileSystem::Size(file);
+        if (file_size < 0) {
             error_message = "Failed to get file size";
             return false;
         }
 
-        if (file_size.QuadPart > SIZE_MAX) {
+        if (static_cast<uint64_t>(file_size) > SIZE_MAX - initinalSize) {
             error_message = "File too large to read into memory";
             return false;
         }
 
-        const auto size = static_cast<size_t>(file_size.QuadPart);
+        const auto size = static_cast<size_t>(file_size);
         Logger::LogDebug("File size: " + std::to_string(size) + " bytes");
 
         buffer.resize(initinalSize + size);
 
-        DWORD bytes_read = 0;
-        if (!ReadFile(file_handle, buffer.data() + initinalSize, static_cast<DWORD>(size), &bytes_read, nullptr) || bytes_read != size) {
-            error_message = "Failed to read file contents";
-            buffer.resize(initinalSize);
-            return false;
+        // A single read is capped at 4 GB on Windows, keep reading until the whole file is in
+        size_t total_read = 0;
+        while (total_read < size) {
+            const int64_t bytes_read = FileSystem::ReadAt(file, total_read, buffer.data() + initinalSize + total_read, size - total_read);
+            if (bytes_read <= 0) {
+                error_message = "Failed to read file contents";
+                buffer.resize(initinalSize);
+                return false;
+            }
+            total_read += static_cast<size_t>(bytes_read);
         }
 
         Logger::LogDebug("File read successfully");
@@ -145,6 +148,33 @@ bool FileUtils::AppendToBuffer(std::wstring_view filepath, std::vector<char>& bu
     }
 }
 
+bool FileUtils::ProbeReadableFile(std::wstring_view filepath, std::wstring& resolved_path, uint64_t& size, std::string& error_message) noexcept {
+    try {
+        FileHandle file;
+        if (!OpenShared(filepath, file, resolved_path, error_message)) {
+            return false;
+        }
+
+        const int64_t file_size = FileSystem::Size(file);
+        if (file_size < 0) {
+            error_message = "Failed to get file size";
+            return false;
+        }
+
+        size = static_cast<uint64_t>(file_size);
+        Logger::LogDebug("File size: " + std::to_string(size) + " bytes");
+        return true;
+    }
+    catch (const std::exception& e) {
+        error_message = "Exception while probing file: " + std::string(e.what());
+        return false;
+    }
+    catch (...) {
+        error_message = "Unknown exception while probing file";
+        return false;
+    }
+}
+
 void FileUtils::CleanupTempFiles(const CrashReportData& data) noexcept {
     try {
         bool any_deleted = false;
@@ -170,6 +200,43 @@ void FileUtils::CleanupTempFiles(const CrashReportData& data) noexcept {
     }
 }
 
+namespace {
+
+    /**
+     * @brief Write one code point as UTF-8, invalid ones as U+FFFD
+     * @return Bytes written, at most 4
+     */
+    size_t EncodeUtf8(uint32_t cp, char* output) noexcept {
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            cp = 0xFFFD;
+        }
+
+        if (cp < 0x80) {
+            output[0] = static_cast<char>(cp);
+            return 1;
+        }
+        if (cp < 0x800) {
+            output[0] = static_cast<char>(0xC0 | (cp >> 6));
+            output[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000) {
+            output[0] = static_cast<char>(0xE0 | (cp >> 12));
+            output[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            output[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        output[0] = static_cast<char>(0xF0 | (cp >> 18));
+        output[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        output[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        output[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 4;
+    }
+
+} // anonymous namespace
+
+#ifdef _WIN32
+
 std::string TextUtils::WideToUtf8(std::wstring_view wstr) noexcept {
     if (wstr.empty()) {
         return {};
@@ -185,34 +252,204 @@ std::string TextUtils::WideToUtf8(std::wstring_view wstr) noexcept {
     return (result > 0) ? str : std::string{};
 }
 
+size_t TextUtils::WideToUtf8(std::wstring_view wstr, char* output) noexcept {
+    if (wstr.empty()) {
+        return 0;
+    }
+
+    const int result = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), static_cast<int>(wstr.length()), output,
+                                           static_cast<int>(wstr.length() * kMaxUtf8PerWide), nullptr, nullptr);
+    return (result > 0) ? static_cast<size_t>(result) : 0;
+}
+
+std::wstring TextUtils::Utf8ToWide(std::string_view str) noexcept {
+    if (str.empty()) {
+        return {};
+    }
+
+    const int len = MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.length()), nullptr, 0);
+    if (len <= 0) {
+        return {};
+    }
+
+    std::wstring wstr(static_cast<size_t>(len), L'\0');
+    const int result = MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.length()), wstr.data(), len);
+    return (result > 0) ? wstr : std::wstring{};
+}
+
+#else
+
+// wchar_t holds UTF-32 code points on POSIX
+
+std::string TextUtils::WideToUtf8(std::wstring_view wstr) noexcept {
+    try {
+        std::string str;
+        str.reserve(wstr.size());
+
+        char encoded[4];
+        for (const wchar_t ch : wstr) {
+            str.append(encoded, EncodeUtf8(static_cast<uint32_t>(ch), encoded));
+        }
+        return str;
+    }
+    catch (...) {
+        return {};
+    }
+}
+
+size_t TextUtils::WideToUtf8(std::wstring_view wstr, char* output) noexcept {
+    char* cursor = output;
+    for (const wchar_t ch : wstr) {
+        cursor += EncodeUtf8(static_cast<uint32_t>(ch), cursor);
+    }
+    return static_cast<size_t>(cursor - output);
+}
+
+std::wstring TextUtils::Utf8ToWide(std::string_view str) noexcept {
+    try {
+        std::wstring wstr;
+        wstr.reserve(str.size());
+
+        size_t i = 0;
+        while (i < str.size()) {
+            const auto lead = static_cast<unsigned char>(str[i]);
+            size_t length = 0;
+            uint32_t cp = 0;
+            if (lead < 0x80) {
+                length = 1;
+                cp = lead;
+            } else if ((lead & 0xE0) == 0xC0) {
+                length = 2;
+                cp = lead & 0x1F;
+            } else if ((lead & 0xF0) == 0xE0) {
+                length = 3;
+                cp = lead & 0x0F;
+            } else if ((lead & 0xF8) == 0xF0) {
+                length = 4;
+                cp = lead & 0x07;
+            }
+
+            bool valid = length != 0 && i + length <= str.size();
+            for (size_t k = 1; valid && k < length; ++k) {
+                const auto next = static_cast<unsigned char>(str[i + k]);
+                valid = (next & 0xC0) == 0x80;
+                cp = (cp << 6) | (next & 0x3F);
+            }
+
+            if (!valid) {
+                wstr += static_cast<wchar_t>(0xFFFD);
+                ++i;
+                continue;
+            }
+
+            wstr += static_cast<wchar_t>(cp);
+            i += length;
+        }
+        return wstr;
+    }
+    catch (...) {
+        return {};
+    }
+}
+
+#endif
+
+std::string TextUtils::Utf16LeToUtf8(std::string_view bytes) noexcept {
+    try {
+        const auto unit = [&](size_t index) {
+            return static_cast<uint32_t>(static_cast<unsigned char>(bytes[index * 2])) |
+                   static_cast<uint32_t>(static_cast<unsigned char>(bytes[index * 2 + 1])) << 8;
+        };
+
+        // Three bytes per unit at most, a surrogate pair of two units takes four
+        const size_t count = bytes.size() / 2;
+        std::string str(count * 3, '\0');
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t cp = unit(i);
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < count) {
+                const uint32_t low = unit(i + 1);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            length += EncodeUtf8(cp, str.data() + length);
+        }
+        str.resize(length);
+        return str;
+    }
+    catch (...) {
+        return {};
+    }
+}
+
 void TextUtils::AppendString(std::vector<char>& output, std::string_view str) noexcept {
     output.insert(output.end(), str.begin(), str.end());
 };
 
 void TextUtils::AppendString(std::vector<char>& output, std::wstring_view wstr) noexcept {
-    const std::string utf8_str = WideToUtf8(wstr);
-    output.insert(output.end(), utf8_str.begin(), utf8_str.end());
+    try {
+        // Converted in place, no intermediate string
+        const size_t initial_size = output.size();
+        output.resize(initial_size + wstr.size() * kMaxUtf8PerWide);
+        output.resize(initial_size + WideToUtf8(wstr, output.data() + initial_size));
+    }
+    catch (...) {
+        // Leaves the output as it was
+    }
 };
 
-std::string TimeUtils::GetCurrentTimestamp() noexcept {
-    try {
-        const auto now = std::chrono::system_clock::now();
-        const auto time_t = std::chrono::system_clock::to_time_t(now);
-        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+bool ProcessUtils::EnterBackgroundMode() noexcept {
+#ifdef _WIN32
+    // Background mode lowers CPU, I/O and memory priority of all threads at once
+    if (!SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN)) {
+        Logger::LogError("Failed to enter background mode (Error: " + std::to_string(GetLastError()) + ")");
+        return false;
+    }
+#else
+    if (setpriority(PRIO_PROCESS, 0, 19) != 0) {
+        Logger::LogError("Failed to enter background mode (Error: " + std::to_string(errno) + ")");
+        return false;
+    }
 
-        tm tm_buf{};
-        if (localtime_s(&tm_buf, &time_t) != 0) {
-            return "TIMESTAMP_ERROR";
-        }
+#ifdef SYS_ioprio_set
+    // Idle I/O class, the kernel only serves us when the disk is otherwise idle
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        Logger::LogDebug("Failed to lower I/O priority (Error: " + std::to_string(errno) + ")");
+    }
+#endif
+#endif
+
+    Logger::LogDebug("Running at background priority");
+    return true;
+}
 
-        std::ostringstream ss;
-        ss << std::put_time(&tm_buf, "%Y-%m-%d %H:%M:%S");
-        ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-        return ss.str();
+size_t TimeUtils::FormatCurrentTimestamp(char* output) noexcept {
+    const auto now = std::chrono::system_clock::now();
+    const auto time_t = std::chrono::system_clock::to_time_t(now);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+
+    tm tm_buf{};
+#ifdef _WIN32
+    if (localtime_s(&tm_buf, &time_t) != 0) {
+        return 0;
     }
-    catch (...) {
-        return "TIMESTAMP_ERROR";
+#else
+    if (localtime_r(&time_t, &tm_buf) == nullptr) {
+        return 0;
+    }
+#endif
+
+    const size_t size = std::strftime(output, kTimestampSize, "%Y-%m-%d %H:%M:%S", &tm_buf);
+    if (size == 0 || size + 4 >= kTimestampSize) {
+        return 0;
     }
+    std::snprintf(output + size, kTimestampSize - size, ".%03d", static_cast<int>(ms.count()));
+    return size + 4;
 }
 
 
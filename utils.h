@@ -1,26 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
 
-#include <windows.h>
-
 #include "crash_report_data.h"
 
 namespace CrashSender {
 
-/**
- * @brief RAII for a file handle
- */
-class FileGuard {
-public:
-    explicit FileGuard(HANDLE h);
-    ~FileGuard();
-private:
-    HANDLE handle;
-};
-
 /**
  * @brief Utility functions for file operations
  */
@@ -59,6 +47,17 @@ struct FileUtils {
     [[nodiscard]]
     static bool AppendToBuffer(std::wstring_view filename, std::vector<char>& buffer, std::string& error_message) noexcept;
 
+    /**
+     * @brief Resolve a file for streaming, bypassing a sharing violation if needed
+     * @param filepath Path to file
+     * @param resolved_path Path that can actually be opened for reading
+     * @param size File size in bytes
+     * @param error_message Placeholder for error if it will occurs
+     * @return true if the file can be streamed
+     */
+    [[nodiscard]]
+    static bool ProbeReadableFile(std::wstring_view filepath, std::wstring& resolved_path, uint64_t& size, std::string& error_message) noexcept;
+
     /**
      * @brief Cleanup temporary files used in crash reporting
      * @param data Crash report data containing file paths
@@ -68,6 +67,9 @@ struct FileUtils {
 
 
 struct TextUtils {
+    /// Longest UTF-8 form of one wchar_t: 3 bytes per UTF-16 unit on Windows, 4 per code point elsewhere
+    static constexpr size_t kMaxUtf8PerWide = sizeof(wchar_t) == 2 ? 3 : 4;
+
     /**
      * @brief Convert wide string to UTF-8 string
      * @param wstr Wide string to convert
@@ -75,14 +77,51 @@ struct TextUtils {
      */
     static std::string WideToUtf8(std::wstring_view wstr) noexcept;
 
+    /**
+     * @brief Convert wide string to UTF-8 into a caller buffer, without allocating
+     * @param wstr Wide string to convert
+     * @param output Room for at least kMaxUtf8PerWide * wstr.size() bytes
+     * @return Number of bytes written, 0 on failure
+     */
+    static size_t WideToUtf8(std::wstring_view wstr, char* output) noexcept;
+
+    /**
+     * @brief Convert UTF-8 string to wide string
+     * @param str UTF-8 string to convert
+     * @return Wide string, empty on failure
+     */
+    static std::wstring Utf8ToWide(std::string_view str) noexcept;
+
+    /**
+     * @brief Convert raw UTF-16LE bytes (as written by the game on Windows) to UTF-8, unpaired surrogates become U+FFFD
+     * @param bytes UTF-16LE data, a trailing odd byte is ignored
+     * @return UTF-8 encoded string, empty on failure
+     */
+    static std::string Utf16LeToUtf8(std::string_view bytes) noexcept;
+
     static void AppendString(std::vector<char>& output, std::string_view str) noexcept;
     static void AppendString(std::vector<char>& output, std::wstring_view wstr) noexcept;
 };
 
 
+struct ProcessUtils {
+    /**
+     * @brief Lower CPU and I/O priority of the process so it does not compete with the game
+     * @return true if the priority was lowered
+     */
+    static bool EnterBackgroundMode() noexcept;
+};
+
+
 struct TimeUtils {
-    [[nodiscard]]
-    static std::string GetCurrentTimestamp() noexcept;
+    static constexpr size_t kTimestampSize = 24; ///< "YYYY-MM-DD HH:MM:SS.mmm" and the terminating NUL
+
+    /**
+     * @brief Current local time as "YYYY-MM-DD HH:MM:SS.mmm", without allocating
+     * @param output Room for kTimestampSize characters
+     * @return Characters written before the terminating NUL, 0 on failure
+     */
+    static size_t FormatCurrentTimestamp(char* output) noexcept;
 };
 
 } // namespace CrashSender